@@ -47,6 +47,15 @@ std::string AuomsConfig::KEY_DISABLE_CGROUPS = "disable_cgroups";
 std::string AuomsConfig::KEY_DISABLE_EVENT_FILTERING = "disable_event_filtering";
 std::string AuomsConfig::KEY_DEFAULT_EVENT_PRIORITY = "default_event_priority";
 std::string AuomsConfig::KEY_PROC_PATH = "proc_path";
+std::string AuomsConfig::KEY_EVENT_PROCESSOR_THREADS = "event_processor_threads";
+std::string AuomsConfig::KEY_INPUT_BUFFER_SLOTS = "input_buffer_slots";
+std::string AuomsConfig::KEY_USER_DB_NSS_CACHE_SIZE = "user_db_nss_cache_size";
+std::string AuomsConfig::KEY_USER_DB_NSS_TTL = "user_db_nss_ttl";
+std::string AuomsConfig::KEY_USER_DB_NSS_NEGATIVE_TTL = "user_db_nss_negative_ttl";
+std::string AuomsConfig::KEY_PROCESS_TREE_RESOLVER_THREADS = "process_tree_resolver_threads";
+std::string AuomsConfig::KEY_PROCESS_TREE_RESOLVE_WAIT = "process_tree_resolve_wait";
+std::string AuomsConfig::KEY_PROCESS_INVENTORY_INTERVAL = "process_inventory_interval";
+std::string AuomsConfig::KEY_PROCESS_INVENTORY_RATE = "process_inventory_rate";
 
 std::unique_ptr<AuomsConfig> AuomsConfig::_instance;
 std::once_flag AuomsConfig::_initFlag;
@@ -161,6 +170,54 @@ AuomsConfig::Load(const std::string& path) {
     if (HasKey(KEY_DISABLE_EVENT_FILTERING)) {
         _disableEventFiltering = GetBool(KEY_DISABLE_EVENT_FILTERING);
     }
+    if (HasKey(KEY_EVENT_PROCESSOR_THREADS)) {
+        _event_processor_threads = GetUint64(KEY_EVENT_PROCESSOR_THREADS);
+        if (_event_processor_threads < 1) {
+            _event_processor_threads = 1;
+        }
+    }
+    if (HasKey(KEY_INPUT_BUFFER_SLOTS)) {
+        _input_buffer_slots = GetUint64(KEY_INPUT_BUFFER_SLOTS);
+        if (_input_buffer_slots < 1) {
+            _input_buffer_slots = 1;
+        }
+    }
+    // A cache size of 0 disables NSS lookups
+    if (HasKey(KEY_USER_DB_NSS_CACHE_SIZE)) {
+        _user_db_nss_cache_size = GetUint64(KEY_USER_DB_NSS_CACHE_SIZE);
+    }
+    if (HasKey(KEY_USER_DB_NSS_TTL)) {
+        _user_db_nss_ttl = GetInt64(KEY_USER_DB_NSS_TTL);
+    }
+    if (HasKey(KEY_USER_DB_NSS_NEGATIVE_TTL)) {
+        _user_db_nss_negative_ttl = GetInt64(KEY_USER_DB_NSS_NEGATIVE_TTL);
+    }
+    // 0 resolver threads makes ProcessTree read /proc on the event processing thread
+    if (HasKey(KEY_PROCESS_TREE_RESOLVER_THREADS)) {
+        _process_tree_resolver_threads = static_cast<int>(GetInt64(KEY_PROCESS_TREE_RESOLVER_THREADS));
+        if (_process_tree_resolver_threads < 0) {
+            _process_tree_resolver_threads = 0;
+        }
+    }
+    if (HasKey(KEY_PROCESS_TREE_RESOLVE_WAIT)) {
+        _process_tree_resolve_wait = GetInt64(KEY_PROCESS_TREE_RESOLVE_WAIT);
+        if (_process_tree_resolve_wait < 0) {
+            _process_tree_resolve_wait = 0;
+        }
+    }
+    // An interval of 0 disables the process inventory, a rate of 0 removes the rate limit
+    if (HasKey(KEY_PROCESS_INVENTORY_INTERVAL)) {
+        _process_inventory_interval = GetInt64(KEY_PROCESS_INVENTORY_INTERVAL);
+        if (_process_inventory_interval < 0) {
+            _process_inventory_interval = 0;
+        }
+    }
+    if (HasKey(KEY_PROCESS_INVENTORY_RATE)) {
+        _process_inventory_rate = GetInt64(KEY_PROCESS_INVENTORY_RATE);
+        if (_process_inventory_rate < 0) {
+            _process_inventory_rate = 0;
+        }
+    }
     // Set EventPrioritizer defaults
     if (!HasKey("event_priority_by_syscall")) {
         SetString(
@@ -368,4 +425,58 @@ bool
 AuomsConfig::DisableEventFiltering() const {
     std::shared_lock<std::shared_mutex> lock(_mutex);
     return _disableEventFiltering;
-}
\ No newline at end of file
+}
+
+size_t
+AuomsConfig::GetEventProcessorThreads() const {
+    std::shared_lock<std::shared_mutex> lock(_mutex);
+    return _event_processor_threads;
+}
+
+size_t
+AuomsConfig::GetInputBufferSlots() const {
+    std::shared_lock<std::shared_mutex> lock(_mutex);
+    return _input_buffer_slots;
+}
+
+size_t
+AuomsConfig::GetUserDbNssCacheSize() const {
+    std::shared_lock<std::shared_mutex> lock(_mutex);
+    return _user_db_nss_cache_size;
+}
+
+long
+AuomsConfig::GetUserDbNssTTL() const {
+    std::shared_lock<std::shared_mutex> lock(_mutex);
+    return _user_db_nss_ttl;
+}
+
+long
+AuomsConfig::GetUserDbNssNegativeTTL() const {
+    std::shared_lock<std::shared_mutex> lock(_mutex);
+    return _user_db_nss_negative_ttl;
+}
+
+int
+AuomsConfig::GetProcessTreeResolverThreads() const {
+    std::shared_lock<std::shared_mutex> lock(_mutex);
+    return _process_tree_resolver_threads;
+}
+
+long
+AuomsConfig::GetProcessTreeResolveWait() const {
+    std::shared_lock<std::shared_mutex> lock(_mutex);
+    return _process_tree_resolve_wait;
+}
+
+long
+AuomsConfig::GetProcessInventoryInterval() const {
+    std::shared_lock<std::shared_mutex> lock(_mutex);
+    return _process_inventory_interval;
+}
+
+long
+AuomsConfig::GetProcessInventoryRate() const {
+    std::shared_lock<std::shared_mutex> lock(_mutex);
+    return _process_inventory_rate;
+}
@@ -79,6 +79,20 @@ public:
 
     bool DisableEventFiltering() const;
 
+    size_t GetEventProcessorThreads() const;
+
+    size_t GetInputBufferSlots() const;
+
+    size_t GetUserDbNssCacheSize() const;
+    long GetUserDbNssTTL() const;
+    long GetUserDbNssNegativeTTL() const;
+
+    int GetProcessTreeResolverThreads() const;
+    long GetProcessTreeResolveWait() const;
+
+    long GetProcessInventoryInterval() const;
+    long GetProcessInventoryRate() const;
+
 private:
     AuomsConfig() = default;
 
@@ -120,6 +134,20 @@ private:
     bool _disableCGroups = false;
     bool _disableEventFiltering = false;
 
+    size_t _event_processor_threads = 1;
+
+    size_t _input_buffer_slots = 8;
+
+    size_t _user_db_nss_cache_size = 4096;
+    long _user_db_nss_ttl = 600;
+    long _user_db_nss_negative_ttl = 60;
+
+    int _process_tree_resolver_threads = 2;
+    long _process_tree_resolve_wait = 10; // milliseconds
+
+    long _process_inventory_interval = 3600; // seconds
+    long _process_inventory_rate = 1000; // events per second
+
     int _defaultEventPriority = 4;
 
     static std::unique_ptr<AuomsConfig> _instance;
@@ -155,4 +183,13 @@ private:
     static std::string KEY_DISABLE_EVENT_FILTERING;
     static std::string KEY_DEFAULT_EVENT_PRIORITY;
     static std::string KEY_PROC_PATH;
+    static std::string KEY_EVENT_PROCESSOR_THREADS;
+    static std::string KEY_INPUT_BUFFER_SLOTS;
+    static std::string KEY_USER_DB_NSS_CACHE_SIZE;
+    static std::string KEY_USER_DB_NSS_TTL;
+    static std::string KEY_USER_DB_NSS_NEGATIVE_TTL;
+    static std::string KEY_PROCESS_TREE_RESOLVER_THREADS;
+    static std::string KEY_PROCESS_TREE_RESOLVE_WAIT;
+    static std::string KEY_PROCESS_INVENTORY_INTERVAL;
+    static std::string KEY_PROCESS_INVENTORY_RATE;
 };
\ No newline at end of file
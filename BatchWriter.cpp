@@ -0,0 +1,68 @@
+/*
+    microsoft-oms-auditd-plugin
+
+    Copyright (c) Microsoft Corporation
+
+    All rights reserved.
+
+    MIT License
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "BatchWriter.h"
+
+#include <algorithm>
+#include <cstring>
+
+ssize_t BatchWriter::WriteAll(const void *buf, size_t size, long timeout, const std::function<bool()>& fn) {
+    if (size == 0) {
+        return OK;
+    }
+
+    if (_num_used == 0 || _buffers[_num_used-1]._capacity - _buffers[_num_used-1]._size < size) {
+        // Find the next free buffer that is large enough. Oversized buffers are not kept once passed over.
+        while (_num_used < _buffers.size() && _buffers[_num_used]._capacity < size) {
+            _buffers.erase(_buffers.begin() + _num_used);
+        }
+        if (_num_used == _buffers.size()) {
+            _buffers.emplace_back(std::max(size, BUFFER_SIZE));
+        }
+        _num_used++;
+    }
+
+    auto& buffer = _buffers[_num_used-1];
+    std::memcpy(buffer._data.get() + buffer._size, buf, size);
+    buffer._size += size;
+    _size += size;
+
+    return OK;
+}
+
+ssize_t BatchWriter::Flush(IOBase* writer, long timeout, const std::function<bool()>& fn) {
+    if (_size == 0) {
+        return OK;
+    }
+
+    _iovs.resize(_num_used);
+    for (size_t i = 0; i < _num_used; ++i) {
+        _iovs[i].iov_base = _buffers[i]._data.get();
+        _iovs[i].iov_len = _buffers[i]._size;
+    }
+
+    auto ret = writer->WriteAllV(_iovs.data(), static_cast<int>(_iovs.size()), timeout, fn);
+    Clear();
+    return ret;
+}
+
+void BatchWriter::Clear() {
+    for (size_t i = 0; i < _num_used; ++i) {
+        _buffers[i]._size = 0;
+    }
+    _num_used = 0;
+    _size = 0;
+}
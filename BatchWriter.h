@@ -0,0 +1,67 @@
+/*
+    microsoft-oms-auditd-plugin
+
+    Copyright (c) Microsoft Corporation
+
+    All rights reserved.
+
+    MIT License
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef AUOMS_BATCHWRITER_H
+#define AUOMS_BATCHWRITER_H
+
+#include "IO.h"
+
+#include <memory>
+#include <vector>
+
+/*
+ * An IWriter that collects the output of many WriteAll() calls (e.g. one per event) into a set
+ * of reusable fixed size buffers, so they can be sent to the real writer with a single writev()
+ * via Flush().
+ * Each WriteAll() is copied whole into one buffer, data larger than BUFFER_SIZE gets a buffer of its own.
+ */
+class BatchWriter: public IWriter {
+public:
+    static constexpr size_t BUFFER_SIZE = 64*1024;
+
+    BatchWriter(): _buffers(), _iovs(), _num_used(0), _size(0) {}
+
+    // Data is only copied into the buffers, so it is always "writable"
+    ssize_t WaitWritable(long timeout) override { return OK; }
+    ssize_t WriteAll(const void *buf, size_t size, long timeout, const std::function<bool()>& fn) override;
+    using IWriter::WriteAll;
+
+    inline size_t Size() const { return _size; }
+    inline bool Empty() const { return _size == 0; }
+
+    // Write all collected data to writer. The collected data is discarded, even if the write fails.
+    ssize_t Flush(IOBase* writer, long timeout, const std::function<bool()>& fn);
+
+    // Discard all collected data. The buffers are kept for reuse.
+    void Clear();
+
+private:
+    class Buffer {
+    public:
+        explicit Buffer(size_t capacity): _data(new uint8_t[capacity]), _capacity(capacity), _size(0) {}
+
+        std::unique_ptr<uint8_t[]> _data;
+        size_t _capacity;
+        size_t _size;
+    };
+
+    std::vector<Buffer> _buffers;
+    std::vector<struct iovec> _iovs;
+    size_t _num_used;
+    size_t _size;
+};
+
+#endif //AUOMS_BATCHWRITER_H
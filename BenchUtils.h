@@ -0,0 +1,135 @@
+/*
+    microsoft-oms-auditd-plugin
+
+    Copyright (c) Microsoft Corporation
+
+    All rights reserved.
+
+    MIT License
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#ifndef AUOMS_BENCHUTILS_H
+#define AUOMS_BENCHUTILS_H
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+extern "C" {
+#include <unistd.h>
+}
+
+/*
+ * Timing and command line helpers shared by the *bench executables.
+ */
+
+inline uint64_t now_ns() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// Fold a result into a volatile sink so the optimizer can't discard the work that produced it
+inline void bench_sink(uint64_t val) {
+    static volatile uint64_t sink = 0;
+    sink = sink + val;
+}
+
+struct BenchOption {
+    char opt;
+    // The name of the option's value, or nullptr if the option is a flag
+    const char* arg;
+    const char* help;
+    // Called with the option's value (nullptr for a flag). Returns false if the value is invalid.
+    std::function<bool(const char*)> set;
+};
+
+// Returns a BenchOption setter that parses an integer no less than min into dst
+template<typename T>
+std::function<bool(const char*)> bench_int_arg(T& dst, T min) {
+    static_assert(std::is_integral<T>::value, "bench_int_arg requires an integral type");
+    return [&dst, min](const char* str) {
+        char* end = nullptr;
+        errno = 0;
+        auto val = strtoll(str, &end, 10);
+        if (errno != 0 || end == str || *end != 0 || val < static_cast<long long>(min) || val > static_cast<long long>(std::numeric_limits<T>::max())) {
+            return false;
+        }
+        dst = static_cast<T>(val);
+        return true;
+    };
+}
+
+inline std::function<bool(const char*)> bench_str_arg(std::string& dst) {
+    return [&dst](const char* str) {
+        dst = str;
+        return true;
+    };
+}
+
+inline std::function<bool(const char*)> bench_flag(bool& dst) {
+    return [&dst](const char*) {
+        dst = true;
+        return true;
+    };
+}
+
+[[noreturn]] inline void bench_usage(const std::string& name, const std::vector<BenchOption>& options) {
+    std::vector<std::string> names;
+    size_t width = 0;
+    for (auto& option : options) {
+        std::string n = std::string("-") + option.opt;
+        if (option.arg != nullptr) {
+            n += std::string(" <") + option.arg + ">";
+        }
+        width = std::max(width, n.size());
+        names.emplace_back(n);
+    }
+
+    std::cerr << "Usage:\n" << name;
+    for (auto& n : names) {
+        std::cerr << " [" << n << "]";
+    }
+    std::cerr << "\n\n";
+    for (size_t i = 0; i < options.size(); ++i) {
+        std::cerr << names[i] << std::string(width - names[i].size(), ' ') << " - " << options[i].help << "\n";
+    }
+    exit(1);
+}
+
+// Parse the command line with getopt. Prints the usage and exits on an unknown option, an invalid value, or a
+// non-option argument.
+inline void bench_parse_args(int argc, char** argv, const std::string& name, const std::vector<BenchOption>& options) {
+    std::string optstring;
+    for (auto& option : options) {
+        optstring.push_back(option.opt);
+        if (option.arg != nullptr) {
+            optstring.push_back(':');
+        }
+    }
+
+    int opt;
+    while ((opt = getopt(argc, argv, optstring.c_str())) != -1) {
+        auto it = std::find_if(options.begin(), options.end(), [opt](const BenchOption& option) { return option.opt == opt; });
+        if (it == options.end() || !it->set(it->arg != nullptr ? optarg : nullptr)) {
+            bench_usage(name, options);
+        }
+    }
+
+    if (optind < argc) {
+        bench_usage(name, options);
+    }
+}
+
+#endif //AUOMS_BENCHUTILS_H
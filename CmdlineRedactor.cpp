@@ -21,6 +21,8 @@
 #include "Logger.h"
 #include "StringUtils.h"
 
+#include <algorithm>
+
 #define CONFIG_SUFFIX ".conf"
 #define REQUIRES_SUFFIX ".requires"
 
@@ -98,11 +100,64 @@ bool CmdlineRedactionRule::Apply(std::string& cmdline) const {
     return res;
 }
 
+CmdlineRedactor::RuleSet::RuleSet(const std::unordered_set<std::string>& missing_rule_files, const std::vector<std::shared_ptr<const CmdlineRedactionRule>>& rules):
+    missing_rule_files(missing_rule_files), rules(rules)
+{
+    if (rules.empty()) {
+        return;
+    }
+
+    // Captures are not needed to know whether a rule matches
+    RE2::Options opts;
+    opts.set_never_capture(true);
+    prefilter = std::make_unique<re2::RE2::Set>(opts, RE2::UNANCHORED);
+    for (auto& rule : rules) {
+        std::string error;
+        if (prefilter->Add(rule->Regex(), &error) < 0) {
+            Logger::Warn("CmdlineRedactor: Failed to add rule (%s) to the prefilter, all rules will be applied to every cmdline: %s", rule->Name().c_str(), error.c_str());
+            prefilter.reset();
+            return;
+        }
+    }
+    if (!prefilter->Compile()) {
+        Logger::Warn("CmdlineRedactor: Failed to compile the prefilter, all rules will be applied to every cmdline");
+        prefilter.reset();
+    }
+}
+
+void CmdlineRedactor::RuleSet::Match(const std::string& cmdline, std::vector<int>& matches) const {
+    matches.clear();
+    if (prefilter) {
+        re2::RE2::Set::ErrorInfo error_info;
+        if (prefilter->Match(cmdline, &matches, &error_info)) {
+            std::sort(matches.begin(), matches.end());
+            return;
+        }
+        if (error_info.kind == re2::RE2::Set::kNoError) {
+            return;
+        }
+        // E.g. the DFA ran out of memory, fall back to trying every rule
+        matches.clear();
+    }
+    for (int i = 0; i < static_cast<int>(rules.size()); ++i) {
+        matches.emplace_back(i);
+    }
+}
+
 void CmdlineRedactor::AddRule(std::shared_ptr<const CmdlineRedactionRule>& rule) {
     std::lock_guard<std::mutex> _lock(_mutex);
 
     _rule_names.emplace(rule->Name());
-    _rules.emplace_back(rule);
+    std::unordered_set<std::string> missing_rule_files;
+    std::vector<std::shared_ptr<const CmdlineRedactionRule>> rules;
+    {
+        // The reference must be released before publishing, Publish() waits for it
+        auto current = _rule_set.Read();
+        missing_rule_files = current->missing_rule_files;
+        rules = current->rules;
+    }
+    rules.emplace_back(rule);
+    _rule_set.Publish(new RuleSet(missing_rule_files, rules));
 }
 
 bool CmdlineRedactor::LoadFromDir(const std::string& dir, bool require_only_root) {
@@ -183,53 +238,69 @@ bool CmdlineRedactor::LoadFromDir(const std::string& dir, bool require_only_root
         }
     }
 
+    // Compile the prefilter before taking the lock
+    auto rule_set = new RuleSet(new_missing_rule_files, new_rules);
+
     std::lock_guard<std::mutex> _lock(_mutex);
     _rule_names = new_rule_names;
     _required_rule_files = new_required_rule_files;
-    _missing_rule_files = new_missing_rule_files;
-    _rules = new_rules;
+    _rule_set.Publish(rule_set);
 
-    return _missing_rule_files.empty();
+    return new_missing_rule_files.empty();
 }
 
 std::vector<std::string> CmdlineRedactor::GetMissingRules() {
-    std::lock_guard<std::mutex> _lock(_mutex);
-
     std::vector<std::string> missing;
-    for (auto& name : _missing_rule_files) {
-        missing.emplace_back(name);
+    {
+        auto rule_set = _rule_set.Read();
+        for (auto& name : rule_set->missing_rule_files) {
+            missing.emplace_back(name);
+        }
     }
     std::sort(missing.begin(), missing.end());
     return missing;
 }
 
 std::vector<std::shared_ptr<const CmdlineRedactionRule>> CmdlineRedactor::GetRules() {
-    std::lock_guard<std::mutex> _lock(_mutex);
-    return _rules;
+    return _rule_set.Read()->rules;
 }
 
 const std::string CmdlineRedactor::REDACT_RULE_MISSING_NAME = "*Missing Required*";
 const std::string CmdlineRedactor::REDACT_RULE_MISSING_TEXT = "**** Entire cmdline redacted due to missing required redaction rules ****";
 
 bool CmdlineRedactor::ApplyRules(std::string& cmdline, std::string& rule_names) {
-    std::lock_guard<std::mutex> _lock(_mutex);
-
     rule_names.resize(0);
 
-    if (!_missing_rule_files.empty()) {
+    auto rule_set = _rule_set.Read();
+
+    if (!rule_set->missing_rule_files.empty()) {
         cmdline = REDACT_RULE_MISSING_TEXT;
         rule_names = REDACT_RULE_MISSING_NAME;
         return true;
     }
 
+    if (rule_set->rules.empty()) {
+        return false;
+    }
+
     auto res = false;
-    for (auto& rule: _rules) {
+    std::vector<int> matches;
+    rule_set->Match(cmdline, matches);
+    size_t i = 0;
+    while (i < matches.size()) {
+        auto idx = matches[i];
+        auto& rule = rule_set->rules[idx];
         if (rule->Apply(cmdline)) {
             if (!rule_names.empty()) {
                 rule_names.push_back(',');
             }
             rule_names.append(rule->Name());
             res = true;
+            // The redaction may change which of the remaining rules match
+            rule_set->Match(cmdline, matches);
+            i = std::upper_bound(matches.begin(), matches.end(), idx) - matches.begin();
+        } else {
+            ++i;
         }
     }
     return res;
@@ -17,11 +17,16 @@
 #ifndef AUOMS_CMDLINEREDACTOR_H
 #define AUOMS_CMDLINEREDACTOR_H
 
+#include <memory>
 #include <mutex>
 #include <string>
 #include <regex>
 #include <unordered_set>
+#include <vector>
 #include <re2/re2.h>
+#include <re2/set.h>
+
+#include "SnapshotPublisher.h"
 
 class CmdlineRedactionRule {
 public:
@@ -58,7 +63,7 @@ public:
     static const std::string REDACT_RULE_MISSING_NAME;
     static const std::string REDACT_RULE_MISSING_TEXT;
 
-    CmdlineRedactor() = default;
+    CmdlineRedactor(): _rule_set(new RuleSet()) {}
 
     // Used only for tests
     void AddRule(std::shared_ptr<const CmdlineRedactionRule>& rule);
@@ -71,14 +76,32 @@ public:
 
     std::vector<std::shared_ptr<const CmdlineRedactionRule>> GetRules();
 
+    // Does not lock, the rules are read from the most recently published RuleSet.
     bool ApplyRules(std::string& cmdline, std::string& rule_names);
 
 private:
+    /*
+     * Immutable set of rules. The prefilter is an RE2::Set of all the rule regexes, it is used to find the (usually
+     * zero) rules that match a cmdline so that only those rules are applied.
+     */
+    struct RuleSet {
+        RuleSet() = default;
+        RuleSet(const std::unordered_set<std::string>& missing_rule_files, const std::vector<std::shared_ptr<const CmdlineRedactionRule>>& rules);
+
+        // Fill matches with the (ascending) indexes of the rules that match cmdline
+        void Match(const std::string& cmdline, std::vector<int>& matches) const;
+
+        std::unordered_set<std::string> missing_rule_files;
+        std::vector<std::shared_ptr<const CmdlineRedactionRule>> rules;
+        // nullptr if there are no rules, or the set could not be compiled
+        std::unique_ptr<re2::RE2::Set> prefilter;
+    };
+
+    // Serializes updates, ApplyRules() does not use it
     std::mutex _mutex;
     std::unordered_set<std::string> _rule_names;
     std::unordered_set<std::string> _required_rule_files;
-    std::unordered_set<std::string> _missing_rule_files;
-    std::vector<std::shared_ptr<const CmdlineRedactionRule>> _rules;
+    SnapshotPublisher<RuleSet> _rule_set;
 };
 
 
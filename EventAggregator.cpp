@@ -21,10 +21,14 @@
 
 #include "rapidjson/error/en.h"
 
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
 #include <sstream>
 
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <fcntl.h>
 #include <unistd.h>
 
 // From https://graphics.stanford.edu/~seander/bithacks.html#RoundUpPowerOf2
@@ -346,6 +350,7 @@ std::shared_ptr<AggregatedEvent> AggregatedEvent::Read(FILE* file, std::vector<s
 
     auto ae = std::shared_ptr<AggregatedEvent>(new AggregatedEvent());
     ae->_rule = rules.at(rule_idx);
+    ae->_id = _next_id.fetch_add(1);
     ae->_expiration_time = unix_to_steady(exp_time);
     ae->_last_event = EventId(lsec, lmsec, lser);
     ae->_count = count;
@@ -371,6 +376,11 @@ std::shared_ptr<AggregatedEvent> AggregatedEvent::Read(FILE* file, std::vector<s
         throw std::runtime_error("AggregatedEvent::Read(): Failed to read origin event data");
     }
 
+    if (Event(ae->_origin_event.data(), ae->_origin_event.size()).Validate() != 0) {
+        throw std::runtime_error("AggregatedEvent::Read(): Invalid origin event");
+    }
+    ae->init_first_event();
+
     if (fscanf(file, "DATA:") != 0) {
         throw std::runtime_error("AggregatedEvent::Read(): Invalid data header");
     }
@@ -395,6 +405,7 @@ std::shared_ptr<AggregatedEvent> AggregatedEvent::Read(FILE* file, std::vector<s
         }
         ae->_agg_key.emplace_back(reinterpret_cast<const char*>(ae->_origin_event.data())+offset, size);
     }
+    ae->_agg_key_hash = AggregationRule::AggregationKeyHash(ae->_agg_key);
 
     int num_agg_fields;
     if (fscanf(file, "AGGFIELDS: %d\n", &num_agg_fields) != 1) {
@@ -473,86 +484,230 @@ std::shared_ptr<AggregatedEvent> AggregatedEvent::Read(FILE* file, std::vector<s
     return ae;
 }
 
-void AggregatedEvent::Write(FILE* file, const std::unordered_map<std::shared_ptr<AggregationRule>, int>& rules_map) const {
+/*
+ * Binary format: AggregatedEventHeader, the origin event, the data, then the (offset, size) pairs (as uint32_t)
+ * of the aggregation key (into the origin event), the event times, the event serials, and each aggregated field
+ * (into the data). The values of each aggregated field are preceded by their number (as uint32_t).
+ */
+struct AggregatedEventHeader {
+    uint32_t rule_idx;
+    uint32_t count;
+    int64_t expiration_time; // unix time
+    uint64_t last_event_sec;
+    uint64_t last_event_serial;
+    uint32_t last_event_msec;
+    uint32_t origin_size;
+    uint32_t data_size;
+    uint32_t num_key_values;
+    uint32_t num_times;
+    uint32_t num_serials;
+    uint32_t num_agg_fields;
+    uint32_t reserved;
+};
+
+class BinaryReader {
+public:
+    BinaryReader(const uint8_t* data, size_t size): _ptr(data), _end(data+size) {}
+
+    // Return nullptr if there are fewer than size bytes left
+    inline const uint8_t* Get(size_t size) {
+        if (size > static_cast<size_t>(_end - _ptr)) {
+            return nullptr;
+        }
+        auto ptr = _ptr;
+        _ptr += size;
+        return ptr;
+    }
+
+    inline bool Read(void* dst, size_t size) {
+        auto ptr = Get(size);
+        if (ptr == nullptr) {
+            return false;
+        }
+        memcpy(dst, ptr, size);
+        return true;
+    }
 
-    auto rule_idx = rules_map.at(_rule);
+    // Read num (offset, size) pairs into values, return false if a pair is incomplete or outside [0, limit)
+    bool ReadValues(std::vector<std::pair<size_t, size_t>>& values, uint32_t num, size_t limit) {
+        // Check num against the remaining data before reserving, so a corrupt num cannot trigger a huge allocation
+        if (num > Remaining() / (sizeof(uint32_t)*2)) {
+            return false;
+        }
+        values.reserve(round_up_pow_2(num));
+        for (uint32_t i = 0; i < num; ++i) {
+            uint32_t v[2];
+            if (!Read(v, sizeof(v)) || static_cast<size_t>(v[0])+v[1] > limit) {
+                return false;
+            }
+            values.emplace_back(v[0], v[1]);
+        }
+        return true;
+    }
 
-    time_t exp_time = steady_to_unix(_expiration_time);
+    inline size_t Remaining() const {
+        return static_cast<size_t>(_end - _ptr);
+    }
 
-    if (fprintf(file, "AggregatedEvent:HEADER: %d:%ld:%ld:%d:%ld:%ld:%d:%ld\n", rule_idx, _origin_event.size(), _data.size(), _count, exp_time,
-            _last_event.Seconds(), _last_event.Milliseconds(), _last_event.Serial()) < 0) {
-        throw std::runtime_error("AggregatedEvent::Write(): Failed to write header");
+    inline bool Done() const {
+        return _ptr == _end;
     }
 
-    if (fprintf(file, "ORIGIN:") < 0) {
-        throw std::runtime_error("AggregatedEvent::Write(): Failed to write origin header");
+private:
+    const uint8_t* _ptr;
+    const uint8_t* _end;
+};
+
+inline void append_u32(std::string& buf, uint32_t v) {
+    buf.append(reinterpret_cast<const char*>(&v), sizeof(v));
+}
+
+inline void append_values(std::string& buf, const std::vector<std::pair<size_t, size_t>>& values) {
+    for (auto& v : values) {
+        append_u32(buf, static_cast<uint32_t>(v.first));
+        append_u32(buf, static_cast<uint32_t>(v.second));
     }
+}
+
+std::shared_ptr<AggregatedEvent> AggregatedEvent::Read(const uint8_t* data, size_t size, const std::vector<std::shared_ptr<AggregationRule>>& rules) {
+    BinaryReader reader(data, size);
 
-    if (fwrite(_origin_event.data(), _origin_event.size(), 1, file) != 1) {
-        throw std::runtime_error("AggregatedEvent::Write(): Failed to write event data");
+    AggregatedEventHeader header;
+    if (!reader.Read(&header, sizeof(header))) {
+        throw std::runtime_error("AggregatedEvent::Read(): Invalid AggregatedEvent header: Too small");
     }
+    if (header.rule_idx >= rules.size()) {
+        throw std::runtime_error("AggregatedEvent::Read(): Invalid AggregatedEvent header: Invalid rule index");
+    }
+
+    auto ae = std::shared_ptr<AggregatedEvent>(new AggregatedEvent());
+    ae->_rule = rules[header.rule_idx];
+    ae->_id = _next_id.fetch_add(1);
+    ae->_expiration_time = unix_to_steady(header.expiration_time);
+    ae->_last_event = EventId(header.last_event_sec, header.last_event_msec, header.last_event_serial);
+    ae->_count = header.count;
 
-    if (fprintf(file, "DATA:") < 0) {
-        throw std::runtime_error("AggregatedEvent::Write(): Failed to write data header");
+    if (header.data_size > ae->_rule->MaxSize()) {
+        throw std::runtime_error("AggregatedEvent::Read(): Invalid AggregatedEvent header: Data size too large");
+    }
+    if (header.num_times > ae->_rule->MaxCount() || header.num_serials > ae->_rule->MaxCount()) {
+        throw std::runtime_error("AggregatedEvent::Read(): Invalid AggregatedEvent header: Num values exceeds rule max count");
+    }
+    if (header.num_agg_fields > ae->_rule->AggregationFields().size()) {
+        throw std::runtime_error("AggregatedEvent::Read(): Invalid AggregatedEvent header: Num fields exeeds rule num fields");
     }
 
-    if (fwrite(_data.data(), _data.size(), 1, file) != 1) {
-        throw std::runtime_error("AggregatedEvent::Write(): Failed to write field data");
+    auto origin = reader.Get(header.origin_size);
+    if (origin == nullptr) {
+        throw std::runtime_error("AggregatedEvent::Read(): Failed to read origin event data");
+    }
+    ae->_origin_event.assign(origin, origin + header.origin_size);
+    if (Event(ae->_origin_event.data(), ae->_origin_event.size()).Validate() != 0) {
+        throw std::runtime_error("AggregatedEvent::Read(): Invalid origin event");
     }
+    ae->init_first_event();
 
-    if (fprintf(file, "AGGKEY: %ld\n", _agg_key.size()) < 0) {
-        throw std::runtime_error("AggregatedEvent::Write(): Failed to write agg key header");
+    auto values = reader.Get(header.data_size);
+    if (values == nullptr) {
+        throw std::runtime_error("AggregatedEvent::Read(): Failed to read values data");
     }
-    for (auto& k : _agg_key) {
-        if (fprintf(file, "%ld:%ld\n", k.data()-reinterpret_cast<const char*>(_origin_event.data()), k.size()) < 0) {
-            throw std::runtime_error("AggregatedEvent::Write(): Failed to agg key value");
+    ae->_data.reserve(round_up_pow_2(header.data_size));
+    ae->_data.assign(reinterpret_cast<const char*>(values), header.data_size);
+
+    // The aggregation key is made of every origin event field that isn't an aggregated field
+    Event origin_event(ae->_origin_event.data(), ae->_origin_event.size());
+    size_t num_key_fields = 0;
+    for (auto& f : origin_event.RecordAt(0)) {
+        if (!ae->_rule->HasAggregationField(f.FieldName())) {
+            num_key_fields += 1;
         }
     }
+    if (header.num_key_values != num_key_fields) {
+        throw std::runtime_error("AggregatedEvent::Read(): Invalid AggregatedEvent header: Num key values does not match origin event");
+    }
 
-    if (fprintf(file, "AGGFIELDS: %ld\n", _aggregated_fields.size()) < 0) {
-        throw std::runtime_error("AggregatedEvent::Write(): Failed to agg fields header");
+    std::vector<std::pair<size_t, size_t>> key;
+    if (!reader.ReadValues(key, header.num_key_values, ae->_origin_event.size())) {
+        throw std::runtime_error("AggregatedEvent::Read(): Invalid aggregate key value");
     }
-    if (fprintf(file, "AGGFIELD: %ld\n", _event_times.size()) < 0) {
-        throw std::runtime_error("AggregatedEvent::Write(): Failed to agg field header");
+    ae->_agg_key.reserve(key.size());
+    for (auto& k : key) {
+        ae->_agg_key.emplace_back(reinterpret_cast<const char*>(ae->_origin_event.data())+k.first, k.second);
+    }
+    ae->_agg_key_hash = AggregationRule::AggregationKeyHash(ae->_agg_key);
+
+    if (!reader.ReadValues(ae->_event_times, header.num_times, ae->_data.size()) ||
+            !reader.ReadValues(ae->_event_serials, header.num_serials, ae->_data.size())) {
+        throw std::runtime_error("AggregatedEvent::Read(): Invalid aggregate field value");
     }
-    for (auto& v : _event_times) {
-        if (fprintf(file, "%ld:%ld\n", v.first, v.second) < 0) {
-            throw std::runtime_error("AggregatedEvent::Write(): Failed to agg field value");
+
+    ae->_aggregated_fields.resize(header.num_agg_fields);
+    for (auto& field : ae->_aggregated_fields) {
+        uint32_t num_values;
+        if (!reader.Read(&num_values, sizeof(num_values))) {
+            throw std::runtime_error("AggregatedEvent::Read(): Invalid aggregate field header: Failed to read");
+        }
+        if (num_values > ae->_rule->MaxCount()) {
+            throw std::runtime_error("AggregatedEvent::Read(): Invalid aggregate field header: Num values exceeds rule max count");
+        }
+        if (!reader.ReadValues(field, num_values, ae->_data.size())) {
+            throw std::runtime_error("AggregatedEvent::Read(): Invalid aggregate field value");
         }
     }
-    if (fprintf(file, "AGGFIELD: %ld\n", _event_serials.size()) < 0) {
-        throw std::runtime_error("AggregatedEvent::Write(): Failed to agg field header");
+
+    if (!reader.Done()) {
+        throw std::runtime_error("AggregatedEvent::Read(): Unexpected data after AggregatedEvent");
     }
-    for (auto& v : _event_serials) {
-        if (fprintf(file, "%ld:%ld\n", v.first, v.second) < 0) {
-            throw std::runtime_error("AggregatedEvent::Write(): Failed to agg field value");
-        }
+
+    return ae;
+}
+
+void AggregatedEvent::Write(std::string& buf, uint32_t rule_idx) const {
+    AggregatedEventHeader header;
+    header.rule_idx = rule_idx;
+    header.count = _count;
+    header.expiration_time = steady_to_unix(_expiration_time);
+    header.last_event_sec = _last_event.Seconds();
+    header.last_event_serial = _last_event.Serial();
+    header.last_event_msec = _last_event.Milliseconds();
+    header.origin_size = static_cast<uint32_t>(_origin_event.size());
+    header.data_size = static_cast<uint32_t>(_data.size());
+    header.num_key_values = static_cast<uint32_t>(_agg_key.size());
+    header.num_times = static_cast<uint32_t>(_event_times.size());
+    header.num_serials = static_cast<uint32_t>(_event_serials.size());
+    header.num_agg_fields = static_cast<uint32_t>(_aggregated_fields.size());
+    header.reserved = 0;
+
+    buf.append(reinterpret_cast<const char*>(&header), sizeof(header));
+    buf.append(reinterpret_cast<const char*>(_origin_event.data()), _origin_event.size());
+    buf.append(_data);
+
+    auto origin = reinterpret_cast<const char*>(_origin_event.data());
+    for (auto& k : _agg_key) {
+        append_u32(buf, static_cast<uint32_t>(k.data()-origin));
+        append_u32(buf, static_cast<uint32_t>(k.size()));
     }
+
+    append_values(buf, _event_times);
+    append_values(buf, _event_serials);
     for (auto& f : _aggregated_fields) {
-        if (fprintf(file, "AGGFIELD: %ld\n", f.size()) < 0) {
-            throw std::runtime_error("AggregatedEvent::Write(): Failed to agg field header");
-        }
-        for (auto& v : f) {
-            if (v.second > 0) {
-                if (fprintf(file, "%ld:%ld\n", v.first, v.second) < 0) {
-                    throw std::runtime_error("AggregatedEvent::Write(): Failed to agg field value");
-                }
-            } else {
-                if (fprintf(file, "0:0\n") < 0) {
-                    throw std::runtime_error("AggregatedEvent::Write(): Failed to agg field value");
-                }
-            }
-        }
+        append_u32(buf, static_cast<uint32_t>(f.size()));
+        append_values(buf, f);
     }
 }
 
+void AggregatedEvent::init_first_event() {
+    Event origin_event(_origin_event.data(), _origin_event.size());
+    _first_event = EventId(origin_event.Seconds(), origin_event.Milliseconds(), origin_event.Serial());
+}
+
 bool AggregatedEvent::AddEvent(const Event& event) {
     if (_count == 0) {
         _origin_event.resize(event.Size());
         memcpy(_origin_event.data(), event.Data(), _origin_event.size());
         _rule->CalcAggregationKey(_agg_key, Event(_origin_event.data(), _origin_event.size()));
-        Event origin_event(_origin_event.data(), _origin_event.size());
-        _first_event = EventId(origin_event.Seconds(), origin_event.Milliseconds(), origin_event.Serial());
+        _agg_key_hash = AggregationRule::AggregationKeyHash(_agg_key);
+        init_first_event();
     }
 
     if (_count >= _rule->MaxCount()) {
@@ -844,7 +999,127 @@ int AggregatedEvent::BuildEvent(EventBuilder& builder, rapidjson::StringBuffer&
  *
  ****************************************************************************/
 
+const std::shared_ptr<AggregatedEvent> AggregationTable::_not_found;
+
+const std::shared_ptr<AggregatedEvent>& AggregationTable::Find(uint64_t hash, const std::vector<std::string_view>& key) const {
+    auto mask = _slots.size()-1;
+    for (auto i = hash & mask; _slots[i].agg; i = (i+1) & mask) {
+        if (_slots[i].hash == hash && _slots[i].agg->AggregationKey() == key) {
+            return _slots[i].agg;
+        }
+    }
+    return _not_found;
+}
+
+void AggregationTable::Add(const std::shared_ptr<AggregatedEvent>& agg) {
+    // Keep the load factor at or below 50%
+    if ((_size+1)*2 > _slots.size()) {
+        resize(_slots.size()*2);
+    }
+    insert_slot(agg->AggregationKeyHash(), agg);
+    _size += 1;
+
+    agg->_older = _newest;
+    agg->_newer = nullptr;
+    if (_newest != nullptr) {
+        _newest->_newer = agg.get();
+    } else {
+        _oldest = agg.get();
+    }
+    _newest = agg.get();
+}
+
+std::shared_ptr<AggregatedEvent> AggregationTable::Remove(const AggregatedEvent* agg) {
+    auto mask = _slots.size()-1;
+    auto i = agg->AggregationKeyHash() & mask;
+    for (; _slots[i].agg.get() != agg; i = (i+1) & mask) {
+        if (!_slots[i].agg) {
+            return nullptr;
+        }
+    }
+
+    auto ret = std::move(_slots[i].agg);
+
+    // Backward shift deletion: move later entries of the probe sequence into the hole,
+    // unless their home slot is after the hole.
+    for (auto j = (i+1) & mask; _slots[j].agg; j = (j+1) & mask) {
+        auto home = _slots[j].hash & mask;
+        if (((j - home) & mask) >= ((j - i) & mask)) {
+            _slots[i] = std::move(_slots[j]);
+            i = j;
+        }
+    }
+    _size -= 1;
+
+    if (ret->_older != nullptr) {
+        ret->_older->_newer = ret->_newer;
+    } else {
+        _oldest = ret->_newer;
+    }
+    if (ret->_newer != nullptr) {
+        ret->_newer->_older = ret->_older;
+    } else {
+        _newest = ret->_older;
+    }
+    ret->_older = nullptr;
+    ret->_newer = nullptr;
+
+    return ret;
+}
+
+void AggregationTable::GetAll(std::vector<std::shared_ptr<AggregatedEvent>>& vec) const {
+    vec.reserve(vec.size() + _size);
+    for (auto& slot : _slots) {
+        if (slot.agg) {
+            vec.emplace_back(slot.agg);
+        }
+    }
+}
+
+void AggregationTable::insert_slot(uint64_t hash, std::shared_ptr<AggregatedEvent> agg) {
+    auto mask = _slots.size()-1;
+    auto i = hash & mask;
+    while (_slots[i].agg) {
+        i = (i+1) & mask;
+    }
+    _slots[i].hash = hash;
+    _slots[i].agg = std::move(agg);
+}
+
+void AggregationTable::resize(size_t num_slots) {
+    std::vector<Slot> old_slots(num_slots);
+    _slots.swap(old_slots);
+    for (auto& slot : old_slots) {
+        if (slot.agg) {
+            insert_slot(slot.hash, std::move(slot.agg));
+        }
+    }
+}
+
+/****************************************************************************
+ *
+ ****************************************************************************/
+
+void EventAggregator::add_pending(PerRuleAgg& e, std::vector<std::shared_ptr<AggregatedEvent>>& aggs) {
+    std::sort(aggs.begin(), aggs.end(), [](const std::shared_ptr<AggregatedEvent>& a, const std::shared_ptr<AggregatedEvent>& b) {
+        return a->AgeKey() < b->AgeKey();
+    });
+    for (auto& agg : aggs) {
+        e._events.Add(agg);
+    }
+}
+
+void EventAggregator::push_ready(std::shared_ptr<AggregatedEvent> agg) {
+    agg->_cp_state = AggregatedEvent::CheckpointState::READY;
+    agg->_cp_ready_seq = _cp_next_ready_seq++;
+    mark_dirty(agg);
+    _ready_events.emplace(std::move(agg));
+}
+
 void EventAggregator::SetRules(const std::vector<std::shared_ptr<AggregationRule>>& rules) {
+    // The rule indexes in the save file and checkpoint log are no longer valid
+    _cp_rules_changed = true;
+
     if (_rules.empty()) {
         // Assume this is empty so just init _rules and _events.
         _rules = rules;
@@ -877,32 +1152,27 @@ void EventAggregator::SetRules(const std::vector<std::shared_ptr<AggregationRule
             _events.emplace_back(std::make_shared<PerRuleAgg>(r));
         }
 
-        // Sort out the existing events        
+        // Sort out the existing events
+        std::vector<std::vector<std::shared_ptr<AggregatedEvent>>> pending(_events.size());
         for (auto& e : events) {
             std::string js = e->_rule->ToJSONString();
             auto it = rule_idx.find(js);
             if (it == rule_idx.end()) {
                 // This entries rule doesn't match any of the new rules so stuff its events into _ready_events
-                for (auto& a : e->_events) {
-                    _ready_events.push(a.second);
+                std::vector<std::shared_ptr<AggregatedEvent>> aggs;
+                e->_events.GetAll(aggs);
+                for (auto& a : aggs) {
+                    push_ready(a);
                 }
             } else {
                 // This entries rule matches a new rule
-                // Copy its events into _events
-                for (auto& a : e->_events) {
-                    _events[it->second]->_events.emplace(a);
-                    _events[it->second]->_events_age.emplace(a.second->AgeKey(), a.first);
-                }
+                // Collect its events for the new rule
+                e->_events.GetAll(pending[it->second]);
             }
         }
 
-        // Re-initialize _aged_events
-        _aged_events.clear();
         for (int i = 0; i < _events.size(); ++i) {
-            auto e = _events[i];
-            for (auto& a : e->_events) {
-                _aged_events.emplace(a.second->AgeKey(), std::make_pair(a.second,i));
-            }
+            add_pending(*_events[i], pending[i]);
         }
     }
 
@@ -917,16 +1187,265 @@ void EventAggregator::SetRules(const std::vector<std::shared_ptr<AggregationRule
     }
 }
 
+EventAggregator::~EventAggregator() {
+    close_log();
+}
+
+// FNV-1a
+static uint32_t checksum(const void* data, size_t size) {
+    auto ptr = reinterpret_cast<const uint8_t*>(data);
+    uint32_t hash = 2166136261U;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= ptr[i];
+        hash *= 16777619U;
+    }
+    return hash;
+}
+
+// Return false if the file does not exist and missing_ok is true
+static bool read_file(const std::string& path, std::vector<uint8_t>& data, bool missing_ok) {
+    int fd = open(path.c_str(), O_RDONLY|O_CLOEXEC);
+    if (fd < 0) {
+        if (errno == ENOENT && missing_ok) {
+            return false;
+        }
+        throw std::system_error(errno, std::system_category(), "open("+path+", O_RDONLY)");
+    }
+    Defer defer_close([fd](){
+        close(fd);
+    });
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        throw std::system_error(errno, std::system_category(), "fstat("+path+")");
+    }
+
+    data.resize(st.st_size);
+    size_t nread = 0;
+    while (nread < data.size()) {
+        auto ret = read(fd, data.data()+nread, data.size()-nread);
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::system_error(errno, std::system_category(), "read("+path+")");
+        }
+        if (ret == 0) {
+            break;
+        }
+        nread += ret;
+    }
+    data.resize(nread);
+    return true;
+}
+
+// fsync the directory containing path, so that a preceding rename() into it is durable
+static void fsync_dir(const std::string& path) {
+    auto idx = path.rfind('/');
+    std::string dir = ".";
+    if (idx == 0) {
+        dir = "/";
+    } else if (idx != std::string::npos) {
+        dir = path.substr(0, idx);
+    }
+    int fd = open(dir.c_str(), O_RDONLY|O_DIRECTORY|O_CLOEXEC);
+    if (fd < 0) {
+        throw std::system_error(errno, std::system_category(), "open("+dir+", O_RDONLY|O_DIRECTORY)");
+    }
+    Defer defer_close([fd](){
+        close(fd);
+    });
+    if (fsync(fd) != 0) {
+        throw std::system_error(errno, std::system_category(), "fsync("+dir+")");
+    }
+}
+
+static void write_all(int fd, const std::string& path, const void* data, size_t size) {
+    auto ptr = reinterpret_cast<const uint8_t*>(data);
+    while (size > 0) {
+        auto ret = write(fd, ptr, size);
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::system_error(errno, std::system_category(), "write("+path+")");
+        }
+        ptr += ret;
+        size -= ret;
+    }
+}
+
+size_t EventAggregator::parse_records(const std::vector<uint8_t>& data, size_t offset, const std::function<void(const RecordHeader& header, const uint8_t* data)>& fn) {
+    while (data.size() - offset >= sizeof(RecordHeader)) {
+        RecordHeader header;
+        memcpy(&header, data.data()+offset, sizeof(header));
+        if (header._size > data.size() - offset - sizeof(header)) {
+            break;
+        }
+        if (header._type < static_cast<uint32_t>(CheckpointRecordType::PENDING) || header._type > static_cast<uint32_t>(CheckpointRecordType::REMOVED)) {
+            break;
+        }
+        auto expected = header._checksum;
+        header._checksum = 0;
+        auto sum = checksum(&header, sizeof(header));
+        sum = checksum(data.data()+offset+sizeof(header), header._size) ^ sum;
+        if (sum != expected) {
+            break;
+        }
+        fn(header, data.data()+offset+sizeof(header));
+        offset += sizeof(header) + header._size;
+    }
+    return offset;
+}
+
 void EventAggregator::Load(const std::string& path) {
-    std::array<char, 256*1024> buf;
+    close_log();
+
+    std::vector<uint8_t> data;
+    read_file(path, data, false);
+
+    uint64_t magic = 0;
+    if (data.size() >= sizeof(magic)) {
+        memcpy(&magic, data.data(), sizeof(magic));
+    }
+
+    while(!_ready_events.empty()) {
+        _ready_events.pop();
+    }
+
+    if (magic == SAVE_FILE_MAGIC) {
+        load_binary(path, data);
+    } else {
+        // Save file written by a version that predates the binary format
+        FILE *file = fopen(path.c_str(), "r");
+        if (file == nullptr) {
+            throw std::system_error(errno, std::system_category(), "fopen("+path+", 'r')");
+        }
+        Defer defer_close([file](){
+            fclose(file);
+        });
+        load_text(file);
+    }
+
+    // Collect the EventMatchRule from the Aggregation rules
+    std::vector<std::shared_ptr<EventMatchRule>> erules;
+    erules.reserve(_rules.size());
+    for (auto& r : _rules) {
+        erules.emplace_back(r->MatchRule());
+    }
 
-    FILE *file = fopen(path.c_str(), "r");
-    if (file == nullptr) {
-        throw std::system_error(errno, std::system_category(), "fopen("+path+", 'r')");
+    // Compile the matcher
+    if (!_matcher->Compile(erules)) {
+        throw std::runtime_error(join(_matcher->Errors(), "\n"));
     }
-    Defer defer_close([file](){
-        fclose(file);
+}
+
+void EventAggregator::load_binary(const std::string& path, const std::vector<uint8_t>& data) {
+    FileHeader header;
+    if (data.size() < sizeof(header)) {
+        throw std::runtime_error("EventAggregator::Load(): Invalid header");
+    }
+    memcpy(&header, data.data(), sizeof(header));
+    if (header._version != FILE_VERSION) {
+        throw std::runtime_error("EventAggregator::Load(): Unsupported file version: " + std::to_string(header._version));
+    }
+
+    // Read the aggregation rules
+    size_t offset = sizeof(header);
+    std::vector<std::shared_ptr<AggregationRule>> rules;
+    for (size_t i = 0; i < static_cast<size_t>(header._num_rules) + header._num_ready_rules; ++i) {
+        uint32_t rule_size;
+        if (data.size() - offset < sizeof(rule_size)) {
+            throw std::runtime_error("EventAggregator::Load(): Invalid rules header: Failed to read");
+        }
+        memcpy(&rule_size, data.data()+offset, sizeof(rule_size));
+        offset += sizeof(rule_size);
+        if (rule_size > data.size() - offset) {
+            throw std::runtime_error("EventAggregator::Load(): Invalid rules header: size too large");
+        }
+        try {
+            rules.emplace_back(AggregationRule::FromJSON(std::string(reinterpret_cast<const char*>(data.data()+offset), rule_size)));
+        } catch (const std::exception& ex) {
+            throw std::runtime_error(std::string("EventAggregator::Load(): Failed to parse rule: ") + ex.what());
+        }
+        offset += rule_size;
+    }
+
+    // Read the events, then apply the changes from the checkpoint log
+    struct LoadedEvent {
+        CheckpointRecordType type;
+        uint64_t ready_seq;
+        uint64_t order;
+        std::shared_ptr<AggregatedEvent> agg;
+    };
+    std::unordered_map<uint64_t, LoadedEvent> events;
+    uint64_t order = 0;
+    auto apply_fn = [&](const RecordHeader& rheader, const uint8_t* rdata) {
+        auto type = static_cast<CheckpointRecordType>(rheader._type);
+        if (type == CheckpointRecordType::REMOVED) {
+            events.erase(rheader._id);
+        } else {
+            events[rheader._id] = LoadedEvent{type, rheader._ready_seq, order++, AggregatedEvent::Read(rdata, rheader._size, rules)};
+        }
+    };
+
+    if (parse_records(data, offset, apply_fn) != data.size()) {
+        throw std::runtime_error("EventAggregator::Load(): Invalid or corrupted record");
+    }
+
+    std::vector<uint8_t> log;
+    if (read_file(CheckpointLogPath(path), log, true) && log.size() >= sizeof(FileHeader)) {
+        FileHeader log_header;
+        memcpy(&log_header, log.data(), sizeof(log_header));
+        // A log with a different generation was written for an earlier save file
+        if (log_header._magic == LOG_FILE_MAGIC && log_header._version == FILE_VERSION && log_header._generation == header._generation) {
+            // The records after the last complete checkpoint (e.g. one interrupted by a crash) are ignored
+            parse_records(log, sizeof(log_header), apply_fn);
+        }
+    }
+
+    _rules.assign(rules.begin(), rules.begin()+header._num_rules);
+    _events.reserve(_rules.size());
+    _events.resize(0);
+    std::unordered_map<std::shared_ptr<AggregationRule>, int> rule_idxs;
+    for (auto& r : _rules) {
+        rule_idxs.emplace(r, _events.size());
+        _events.emplace_back(std::make_shared<PerRuleAgg>(r));
+    }
+
+    std::vector<LoadedEvent*> ready;
+    std::vector<LoadedEvent*> pending;
+    for (auto& e : events) {
+        if (e.second.type == CheckpointRecordType::READY || rule_idxs.count(e.second.agg->Rule()) == 0) {
+            ready.emplace_back(&e.second);
+        } else {
+            pending.emplace_back(&e.second);
+        }
+    }
+
+    std::sort(ready.begin(), ready.end(), [](const LoadedEvent* a, const LoadedEvent* b) {
+        return std::make_pair(a->ready_seq, a->order) < std::make_pair(b->ready_seq, b->order);
     });
+    for (auto e : ready) {
+        push_ready(e->agg);
+    }
+
+    // Re-assign the ids so that events that expire in the same second keep their saved age order
+    std::sort(pending.begin(), pending.end(), [](const LoadedEvent* a, const LoadedEvent* b) {
+        return std::make_pair(a->agg->ExpirationTime(), a->order) < std::make_pair(b->agg->ExpirationTime(), b->order);
+    });
+    std::vector<std::vector<std::shared_ptr<AggregatedEvent>>> rule_pending(_events.size());
+    for (auto e : pending) {
+        e->agg->_id = AggregatedEvent::_next_id.fetch_add(1);
+        rule_pending[rule_idxs.at(e->agg->Rule())].emplace_back(e->agg);
+    }
+    for (int i = 0; i < _events.size(); ++i) {
+        add_pending(*_events[i], rule_pending[i]);
+    }
+}
+
+void EventAggregator::load_text(FILE* file) {
+    std::array<char, 256*1024> buf;
 
     // Rerad the header
     size_t num_rules;
@@ -980,12 +1499,8 @@ void EventAggregator::Load(const std::string& path) {
     }
 
     // Read the ready events
-    while(!_ready_events.empty()) {
-        _ready_events.pop();
-    }
     for (size_t i = 0; i < num_ready_events; ++i) {
-        auto e = AggregatedEvent::Read(file, _rules);
-        _ready_events.push(e);
+        push_ready(AggregatedEvent::Read(file, _rules));
     }
 
     // Capture rule indexes
@@ -994,94 +1509,205 @@ void EventAggregator::Load(const std::string& path) {
         rule_idxs[_rules[i]] = i;
     }
 
-    _aged_events.clear();
-
     // Read the partial events
+    std::vector<std::vector<std::shared_ptr<AggregatedEvent>>> pending(_events.size());
     for (size_t i = 0; i < num_partial_events; ++i) {
         auto e = AggregatedEvent::Read(file, _rules);
         auto ridx = rule_idxs.at(e->Rule());
-        _events[ridx]->_events.emplace(std::make_pair(e->AggregationKey(), e));
-        _events[ridx]->_events_age.emplace(e->AgeKey(), e->AggregationKey());
-        _aged_events.emplace(e->AgeKey(), std::make_pair(e, ridx));
+        pending[ridx].emplace_back(e);
     }
+    for (int i = 0; i < _events.size(); ++i) {
+        add_pending(*_events[i], pending[i]);
+    }
+}
 
-    // Collect the EventMatchRule from the Aggregation rules
-    std::vector<std::shared_ptr<EventMatchRule>> erules;
-    erules.reserve(_rules.size());
+void EventAggregator::append_record(CheckpointRecordType type, uint64_t id, const AggregatedEvent* agg) {
+    auto start = _cp_buf.size();
+    _cp_buf.append(sizeof(RecordHeader), 0);
+    uint64_t ready_seq = 0;
+    if (agg != nullptr) {
+        agg->Write(_cp_buf, _cp_rule_idxs.at(agg->Rule().get()));
+        ready_seq = agg->_cp_ready_seq;
+    }
+
+    RecordHeader header(static_cast<uint32_t>(_cp_buf.size() - start - sizeof(RecordHeader)), type, id, ready_seq);
+    auto sum = checksum(&header, sizeof(header));
+    header._checksum = checksum(_cp_buf.data()+start+sizeof(header), header._size) ^ sum;
+    memcpy(&_cp_buf[start], &header, sizeof(header));
+}
+
+uint64_t EventAggregator::write_save_file(const std::string& path) {
+    // Each save file gets a new generation, so that a log written for a previous save file is never applied to it
+    auto generation = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count());
+    if (generation <= _cp_generation) {
+        generation = _cp_generation + 1;
+    }
+    _cp_generation = generation;
+
+    std::vector<std::shared_ptr<AggregatedEvent>> ready;
+    ready.reserve(_ready_events.size());
+    for (auto revents = _ready_events; !revents.empty(); revents.pop()) {
+        ready.emplace_back(revents.front());
+    }
+
+    // Capture rule indexes, ready events may reference rules that are no longer in _rules
+    std::vector<const AggregationRule*> rules;
+    _cp_rule_idxs.clear();
     for (auto& r : _rules) {
-        erules.emplace_back(r->MatchRule());
+        _cp_rule_idxs.emplace(r.get(), rules.size());
+        rules.emplace_back(r.get());
+    }
+    for (auto& agg : ready) {
+        if (_cp_rule_idxs.emplace(agg->Rule().get(), rules.size()).second) {
+            rules.emplace_back(agg->Rule().get());
+        }
     }
 
-    // Compile the matcher
-    if (!_matcher->Compile(erules)) {
-        throw std::runtime_error(join(_matcher->Errors(), "\n"));
+    _cp_buf.clear();
+    FileHeader header(SAVE_FILE_MAGIC, _rules.size(), rules.size() - _rules.size(), generation);
+    _cp_buf.append(reinterpret_cast<const char*>(&header), sizeof(header));
+    for (auto r : rules) {
+        auto js = r->ToJSONString();
+        append_u32(_cp_buf, static_cast<uint32_t>(js.size()));
+        _cp_buf.append(js);
     }
-}
 
-void EventAggregator::Save(const std::string& path) {
-    size_t num_partial_events = 0;
+    _cp_next_ready_seq = 0;
+    for (auto& agg : ready) {
+        agg->_cp_ready_seq = _cp_next_ready_seq++;
+        agg->_cp_saved = true;
+        append_record(CheckpointRecordType::READY, agg->Id(), agg.get());
+    }
     for (auto& e : _events) {
-        num_partial_events += e->_events.size();
+        for (auto agg = e->_events.Oldest(); agg != nullptr; agg = agg->_newer) {
+            agg->_cp_saved = true;
+            append_record(CheckpointRecordType::PENDING, agg->Id(), agg);
+        }
     }
+    _cp_rules_changed = false;
 
-
-    FILE *file = fopen(path.c_str(), "w");
-    if (file == nullptr) {
-        throw std::system_error(errno, std::system_category(), "fopen("+path+", 'w')");
+    // Write to a temp file and rename it, so that the previous save file remains intact if the write fails
+    auto tmp_path = path + ".tmp";
+    int fd = open(tmp_path.c_str(), O_WRONLY|O_CREAT|O_TRUNC|O_CLOEXEC, 0600);
+    if (fd < 0) {
+        throw std::system_error(errno, std::system_category(), "open("+tmp_path+", O_WRONLY|O_CREAT|O_TRUNC)");
     }
-    Defer defer_close([file](){
-        fclose(file);
+    Defer defer_close([fd](){
+        close(fd);
     });
 
-    if (fchmod(fileno(file), 0600) != 0) {
+    if (fchmod(fd, 0600) != 0) {
         throw std::system_error(errno, std::system_category(), "fchmod()");
     }
 
-    rapidjson::StringBuffer js_buffer;
-    rapidjson::Writer<rapidjson::StringBuffer> writer(js_buffer);
+    write_all(fd, tmp_path, _cp_buf.data(), _cp_buf.size());
 
-    // Write header
-    if (fprintf(file, "EventAggregator::HEADER: %ld:%ld:%ld\n", _rules.size(), _ready_events.size(), num_partial_events) < 0) {
-        throw std::runtime_error("EventAggregator::Save(): Failed to write header");
+    if (fsync(fd) != 0) {
+        throw std::system_error(errno, std::system_category(), "fsync("+tmp_path+")");
     }
 
-    // Write Aggregation Rules
-    for (auto& r : _rules) {
-        js_buffer.Clear();
-        writer.Reset(js_buffer);
-        r->ToJSON(writer);
-        if (fprintf(file, "RULE HEADER: %ld\n", js_buffer.GetSize()+1) < 0) {
-            throw std::runtime_error("EventAggregator::Save(): Failed to write rule header");
-        }
-        if (fwrite(js_buffer.GetString(), js_buffer.GetSize(), 1, file) != 1) {
-            throw std::runtime_error("EventAggregator::Save(): Failed to write rule data");
-        }
-        if (fprintf(file, "\n") < 0) {
-            throw std::runtime_error("EventAggregator::Save(): Failed to write rule data");
+    if (rename(tmp_path.c_str(), path.c_str()) != 0) {
+        throw std::system_error(errno, std::system_category(), "rename("+tmp_path+", "+path+")");
+    }
+    fsync_dir(path);
+
+    _cp_save_size = _cp_buf.size();
+
+    return generation;
+}
+
+void EventAggregator::start_log(const std::string& path, uint64_t generation) {
+    auto log_path = CheckpointLogPath(path);
+    int fd = open(log_path.c_str(), O_WRONLY|O_CREAT|O_TRUNC|O_APPEND|O_CLOEXEC, 0600);
+    if (fd < 0) {
+        throw std::system_error(errno, std::system_category(), "open("+log_path+", O_WRONLY|O_CREAT|O_TRUNC|O_APPEND)");
+    }
+
+    try {
+        if (fchmod(fd, 0600) != 0) {
+            throw std::system_error(errno, std::system_category(), "fchmod()");
         }
+        FileHeader header(LOG_FILE_MAGIC, 0, 0, generation);
+        write_all(fd, log_path, &header, sizeof(header));
+    } catch (...) {
+        close(fd);
+        throw;
     }
 
-    // Capture rule indexes
-    std::unordered_map<std::shared_ptr<AggregationRule>, int> rule_idxs;
-    for (int i = 0; i < _rules.size(); ++i) {
-        rule_idxs[_rules[i]] = i;
+    _cp_path = path;
+    _cp_log_fd = fd;
+    _cp_log_size = sizeof(FileHeader);
+}
+
+void EventAggregator::close_log() {
+    if (_cp_log_fd >= 0) {
+        close(_cp_log_fd);
+        _cp_log_fd = -1;
     }
+    _cp_path.clear();
+    for (auto& agg : _cp_dirty) {
+        agg->_cp_dirty = false;
+    }
+    _cp_dirty.clear();
+    _cp_removed.clear();
+}
 
-    // Make a copy of the _ready_events queue
-    std::queue<std::shared_ptr<AggregatedEvent>> revents(_ready_events);
+void EventAggregator::Save(const std::string& path) {
+    close_log();
+    write_save_file(path);
 
-    // Write the ready events
-    while(!revents.empty()) {
-        revents.front()->Write(file, rule_idxs);
-        revents.pop();
+    auto log_path = CheckpointLogPath(path);
+    if (unlink(log_path.c_str()) != 0 && errno != ENOENT) {
+        throw std::system_error(errno, std::system_category(), "unlink("+log_path+")");
     }
+}
 
-    // Write the partial events
-    for (auto& e : _events) {
-        for (auto& a : e->_events) {
-            a.second->Write(file, rule_idxs);
+void EventAggregator::Checkpoint(const std::string& path) {
+    if (_cp_log_fd < 0 || path != _cp_path || _cp_rules_changed || _cp_log_size > std::max(_cp_save_size, MIN_COMPACT_LOG_SIZE)) {
+        close_log();
+        auto generation = write_save_file(path);
+        start_log(path, generation);
+        return;
+    }
+
+    if (_cp_dirty.empty() && _cp_removed.empty()) {
+        return;
+    }
+
+    _cp_buf.clear();
+    for (auto& agg : _cp_dirty) {
+        agg->_cp_dirty = false;
+        switch (agg->_cp_state) {
+            case AggregatedEvent::CheckpointState::PENDING:
+                append_record(CheckpointRecordType::PENDING, agg->Id(), agg.get());
+                agg->_cp_saved = true;
+                break;
+            case AggregatedEvent::CheckpointState::READY:
+                append_record(CheckpointRecordType::READY, agg->Id(), agg.get());
+                agg->_cp_saved = true;
+                break;
+            case AggregatedEvent::CheckpointState::DONE:
+                // If needed, the REMOVED record is already in _cp_removed
+                break;
         }
     }
+    _cp_dirty.clear();
+    for (auto id : _cp_removed) {
+        append_record(CheckpointRecordType::REMOVED, id, nullptr);
+    }
+    _cp_removed.clear();
+
+    try {
+        write_all(_cp_log_fd, CheckpointLogPath(path), _cp_buf.data(), _cp_buf.size());
+        if (fdatasync(_cp_log_fd) != 0) {
+            throw std::system_error(errno, std::system_category(), "fdatasync("+CheckpointLogPath(path)+")");
+        }
+    } catch (...) {
+        // The log may now end with a partial record, the next checkpoint will save the full state
+        close_log();
+        throw;
+    }
+    _cp_log_size += _cp_buf.size();
 }
 
 bool EventAggregator::AddEvent(const Event& event) {
@@ -1100,17 +1726,11 @@ bool EventAggregator::AddEvent(const Event& event) {
 
     // Find AggregatedEvent based on Aggregation Key
     e->_rule->CalcAggregationKey(_tmp_key, event);
-    auto it = e->_events.find(_tmp_key);
-    if (it == e->_events.end()) {
+    auto& existing = e->_events.Find(AggregationRule::AggregationKeyHash(_tmp_key), _tmp_key);
+    if (!existing) {
         // Make sure we don't exceed the max pending limit
-        while (e->_events.size() >= e->_rule->MaxPending()) {
-            auto it2 = e->_events.find(e->_events_age.begin()->second);
-            e->_events_age.erase(e->_events_age.begin());
-            if (it2 != e->_events.end()) {
-                _aged_events.erase(it2->second->AgeKey());
-                _ready_events.emplace(it2->second);
-                e->_events.erase(it2);
-            }
+        while (e->_events.Size() >= e->_rule->MaxPending()) {
+            push_ready(e->_events.Remove(e->_events.Oldest()));
         }
 
         // Create new AggregatedEvent
@@ -1118,19 +1738,16 @@ bool EventAggregator::AddEvent(const Event& event) {
         if (!agg->AddEvent(event)) {
             return false;
         }
-        // Event was added so add new AggregatedEvent to e->_events and _agged_events
-        e->_events.emplace(std::make_pair(agg->AggregationKey(), agg));
-        e->_events_age.emplace(agg->AgeKey(), agg->AggregationKey());
-        _aged_events.emplace(agg->AgeKey(), std::make_pair(agg,idx));
+        // Event was added so add new AggregatedEvent to e->_events
+        e->_events.Add(agg);
+        mark_dirty(agg);
         return true;
     } else {
-        if (!it->second->AddEvent(event)) {
+        if (!existing->AddEvent(event)) {
             // Event wasn't added to current AggregatedEvent so treat it as full and move it to the _ready_events queue
-            _ready_events.emplace(it->second);
-            _aged_events.erase(it->second->AgeKey());
             // Remove the entry from e->_events, it's key data lifecycle is tied to the agg we just removed.
-            e->_events_age.erase(it->second->AgeKey());
-            e->_events.erase(it);
+            // existing refers to the table slot, so it must not be used after the Remove().
+            push_ready(e->_events.Remove(existing.get()));
             // Create a new AggregatedEvent
             auto agg = std::make_shared<AggregatedEvent>(e->_rule);
             // Try to add the event to the new AggregatedEvent
@@ -1138,9 +1755,10 @@ bool EventAggregator::AddEvent(const Event& event) {
                 // The event wasn't added to the new AggregatedEvent so return false
                 return false;
             }
-            e->_events.emplace(std::make_pair(agg->AggregationKey(), agg));
-            e->_events_age.emplace(agg->AgeKey(), agg->AggregationKey());
-            _aged_events.emplace(agg->AgeKey(), std::make_pair(agg,idx));
+            e->_events.Add(agg);
+            mark_dirty(agg);
+        } else {
+            mark_dirty(existing);
         }
         return true;
     }
@@ -1148,15 +1766,21 @@ bool EventAggregator::AddEvent(const Event& event) {
 
 std::tuple<bool, int64_t, bool> EventAggregator::HandleEvent(const std::function<std::pair<int64_t, bool> (const Event& event)>& handler_fn) {
     auto now = std::chrono::steady_clock::now();
-    while (!_aged_events.empty() && _aged_events.begin()->first.first < now) {
-        auto agg = _aged_events.begin()->second.first;
-        auto idx = _aged_events.begin()->second.second;
-        _ready_events.emplace(agg);
+    // Move expired events, in expiration order, to _ready_events
+    // Only the oldest event of each rule needs to be checked
+    for (;;) {
+        AggregationTable* next = nullptr;
+        for (auto& e : _events) {
+            auto oldest = e->_events.Oldest();
+            if (oldest != nullptr && oldest->ExpirationTime() < now && (next == nullptr || oldest->AgeKey() < next->Oldest()->AgeKey())) {
+                next = &e->_events;
+            }
+        }
+        if (next == nullptr) {
+            break;
+        }
         // Remove the agg from _events so it doesn't keep accumulatting
-        _events[idx]->_events_age.erase(_aged_events.begin()->first);
-        _events[idx]->_events.erase(agg->AggregationKey());
-        // Remove from _aged_events
-        _aged_events.erase(_aged_events.begin());
+        push_ready(next->Remove(next->Oldest()));
     }
 
     if (_ready_events.empty()) {
@@ -1173,6 +1797,10 @@ std::tuple<bool, int64_t, bool> EventAggregator::HandleEvent(const std::function
     auto fret = handler_fn(_allocator->GetEvent());
 
     if (fret.second) {
+        agg->_cp_state = AggregatedEvent::CheckpointState::DONE;
+        if (_cp_log_fd >= 0 && agg->_cp_saved) {
+            _cp_removed.emplace_back(agg->Id());
+        }
         _ready_events.pop();
     }
 
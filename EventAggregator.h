@@ -234,6 +234,15 @@ public:
     // same validity lifespan
     void CalcAggregationKey(std::vector<std::string_view>& key, const Event& event) const;
 
+    static inline uint64_t AggregationKeyHash(const std::vector<std::string_view>& key) {
+        uint64_t h = key.size();
+        for (auto& k : key) {
+            // This is algorithm is taken from boost:hash_combine();
+            h ^= std::hash<std::string_view>{}(k) + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+        }
+        return h;
+    }
+
 private:
     std::shared_ptr<EventMatchRule> _match_rule;
     std::vector<AggregationField> _aggregation_fields;
@@ -249,6 +258,7 @@ private:
 };
 
 class EventAggregator;
+class AggregationTable;
 
 class AggregatedEvent {
 public:
@@ -265,8 +275,12 @@ public:
         }
     }
 
+    // Read an event from a (pre binary format) text save file
     static std::shared_ptr<AggregatedEvent> Read(FILE* file, std::vector<std::shared_ptr<AggregationRule>> rules);
-    void Write(FILE* file, const std::unordered_map<std::shared_ptr<AggregationRule>, int>& rules_map) const;
+
+    // Read/Write the binary format used by the save file and checkpoint log
+    static std::shared_ptr<AggregatedEvent> Read(const uint8_t* data, size_t size, const std::vector<std::shared_ptr<AggregationRule>>& rules);
+    void Write(std::string& buf, uint32_t rule_idx) const;
 
     inline const std::shared_ptr<AggregationRule>& Rule() const {
         return _rule;
@@ -292,6 +306,10 @@ public:
         return _agg_key;
     }
 
+    inline uint64_t AggregationKeyHash() const {
+        return _agg_key_hash;
+    }
+
     // Return true of the event was added
     // Return false if the event was not added (and thus the AggregatedEvent is full)
     bool AddEvent(const Event& event);
@@ -300,9 +318,19 @@ public:
 
 private:
     friend class EventAggregator;
+    friend class AggregationTable;
+
+    // Checkpoint state, maintained by EventAggregator
+    enum class CheckpointState: uint8_t {
+        PENDING,
+        READY,
+        DONE,
+    };
 
     AggregatedEvent() {}
 
+    void init_first_event();
+
     static std::atomic<uint64_t> _next_id;
 
     std::shared_ptr<AggregationRule> _rule;
@@ -313,24 +341,75 @@ private:
     uint32_t _count;
     std::vector<uint8_t> _origin_event;
     std::vector<std::string_view> _agg_key;
+    uint64_t _agg_key_hash = 0;
+    // Age order links, maintained by AggregationTable
+    AggregatedEvent* _older = nullptr;
+    AggregatedEvent* _newer = nullptr;
     std::string _data;
     std::vector<std::pair<size_t, size_t>> _event_times;
     std::vector<std::pair<size_t, size_t>> _event_serials;
     std::vector<std::vector<std::pair<size_t, size_t>>> _aggregated_fields;
+    CheckpointState _cp_state = CheckpointState::PENDING;
+    // True if the event is in the _cp_dirty list
+    bool _cp_dirty = false;
+    // True if the save file or checkpoint log has a record of the event
+    bool _cp_saved = false;
+    // Position in the ready queue
+    uint64_t _cp_ready_seq = 0;
 };
 
-template<>
-struct std::hash<std::vector<std::string_view>>
-{
-    std::size_t operator()(std::vector<std::string_view> const& v) const noexcept
-    {
-        size_t h = 0;
-        for (auto& i : v) {
-            // This is algorithm is taken from boost:hash_combine();
-            h ^= std::hash<std::string_view>{}(i) + 0x9e3779b9 + (h << 6) + (h >> 2);
-        }
-        return h;
+/*
+ * The pending (partially aggregated) events of a rule.
+ *
+ * Events are found by their aggregation key hash in an open addressing (linear probing) table, the full
+ * aggregation key is only compared when the hashes are equal.
+ * The events are also linked in age order. All the events of a rule have the same max_time, so the oldest
+ * event is both the next one to expire and the one to evict when max_pending is reached.
+ */
+class AggregationTable {
+public:
+    static constexpr size_t MIN_SLOTS = 16;
+
+    AggregationTable(): _slots(MIN_SLOTS), _size(0), _oldest(nullptr), _newest(nullptr) {}
+    AggregationTable(const AggregationTable&) = delete;
+    AggregationTable& operator=(const AggregationTable&) = delete;
+
+    inline size_t Size() const {
+        return _size;
     }
+
+    // Return an empty pointer if there is no event with the key
+    const std::shared_ptr<AggregatedEvent>& Find(uint64_t hash, const std::vector<std::string_view>& key) const;
+
+    // Events must be added in age order, oldest first
+    void Add(const std::shared_ptr<AggregatedEvent>& agg);
+
+    // Remove the event from the table and return it
+    std::shared_ptr<AggregatedEvent> Remove(const AggregatedEvent* agg);
+
+    // Return nullptr if the table is empty
+    inline AggregatedEvent* Oldest() const {
+        return _oldest;
+    }
+
+    // Append all the events to vec (in no particular order)
+    void GetAll(std::vector<std::shared_ptr<AggregatedEvent>>& vec) const;
+
+private:
+    struct Slot {
+        uint64_t hash;
+        std::shared_ptr<AggregatedEvent> agg;
+    };
+
+    void insert_slot(uint64_t hash, std::shared_ptr<AggregatedEvent> agg);
+    void resize(size_t num_slots);
+
+    static const std::shared_ptr<AggregatedEvent> _not_found;
+
+    std::vector<Slot> _slots;
+    size_t _size;
+    AggregatedEvent* _oldest;
+    AggregatedEvent* _newest;
 };
 
 class EventAggregator {
@@ -338,20 +417,38 @@ public:
     EventAggregator():
         _allocator(std::make_shared<BasicEventBuilderAllocator>(256*1024)),
         _builder(_allocator, DefaultPrioritizer::Create(0)),
-        _matcher(std::make_shared<EventMatcher>())
+        _matcher(std::make_shared<EventMatcher>()),
+        _cp_log_fd(-1), _cp_generation(0), _cp_save_size(0), _cp_log_size(0), _cp_next_ready_seq(0), _cp_rules_changed(false)
     {}
+    EventAggregator(const EventAggregator&) = delete;
+    EventAggregator& operator=(const EventAggregator&) = delete;
+
+    ~EventAggregator();
 
     // Set rules
     // If existing rules exist, any events associated with old rules that are not in the new set, will be flushed to the _ready_events queue.
     void SetRules(const std::vector<std::shared_ptr<AggregationRule>>& rules);
 
     // Load saved aggregation state from file
+    // Changes recorded in the file's checkpoint log (see Checkpoint()) are also loaded
     // Any previous state is lost
     void Load(const std::string& path);
 
     // Save aggregation state to file
+    // Any checkpoint log for the file is removed
     void Save(const std::string& path);
 
+    // Incrementally save aggregation state to file
+    // The first call for a path saves the full state (as Save() does) and starts a checkpoint log (CheckpointLogPath(path)).
+    // Later calls only append the aggregated events that changed since the previous call to the log.
+    // The full state is saved again, and the log emptied, once the log grows larger than the save file (or MIN_COMPACT_LOG_SIZE).
+    // Save() and Checkpoint() both write the save file atomically (write to a temp file, then rename).
+    void Checkpoint(const std::string& path);
+
+    static inline std::string CheckpointLogPath(const std::string& path) {
+        return path + ".log";
+    }
+
     // Check if event is aggregated
     // Return true if the event was consumed (aggregated)
     bool AddEvent(const Event& event);
@@ -370,30 +467,112 @@ public:
     size_t NumPendingAggregates() const {
         size_t count = 0;
         for (auto& e : _events) {
-            count += e->_events.size();
+            count += e->_events.Size();
         }
         return count;
     }
 
 private:
+    static constexpr uint64_t SAVE_FILE_MAGIC = 0x4147475341564546;
+    static constexpr uint64_t LOG_FILE_MAGIC = 0x414747434B4C4F47;
+    static constexpr uint32_t FILE_VERSION = 0x00000001;
+    // The log is compacted once it is larger than the save file, or this, whichever is larger
+    static constexpr size_t MIN_COMPACT_LOG_SIZE = 1024*1024;
+
+    // Used for both the save file and the checkpoint log.
+    // The save file header is followed by the rules (each a uint32_t size followed by the rule JSON), then the records
+    // of the ready events (in queue order) and pending events (in age order). The log header is followed by records only.
+    class FileHeader {
+    public:
+        FileHeader(): _magic(0), _version(0), _num_rules(0), _generation(0), _num_ready_rules(0), _reserved(0) {}
+        explicit FileHeader(uint64_t magic, uint32_t num_rules, uint32_t num_ready_rules, uint64_t generation): _magic(magic), _version(FILE_VERSION), _num_rules(num_rules), _generation(generation), _num_ready_rules(num_ready_rules), _reserved(0) {}
+
+        uint64_t _magic;
+        uint32_t _version;
+        uint32_t _num_rules;
+        // The log records only apply to the save file with the same generation
+        uint64_t _generation;
+        // Rules (removed by SetRules()) that are only referenced by ready events, they follow the _num_rules current rules
+        uint32_t _num_ready_rules;
+        uint32_t _reserved;
+    };
+
+    enum class CheckpointRecordType: uint32_t {
+        PENDING = 1,
+        READY = 2,
+        REMOVED = 3,
+    };
+
+    // A record replaces any previous record with the same id
+    class RecordHeader {
+    public:
+        RecordHeader(): _size(0), _checksum(0), _type(0), _reserved(0), _id(0), _ready_seq(0) {}
+        RecordHeader(uint32_t size, CheckpointRecordType type, uint64_t id, uint64_t ready_seq): _size(size), _checksum(0), _type(static_cast<uint32_t>(type)), _reserved(0), _id(id), _ready_seq(ready_seq) {}
+
+        uint32_t _size;
+        // Covers the header (with _checksum == 0) and the record data
+        uint32_t _checksum;
+        uint32_t _type;
+        uint32_t _reserved;
+        uint64_t _id;
+        uint64_t _ready_seq;
+    };
+
     class PerRuleAgg {
     public:
-        explicit PerRuleAgg(const std::shared_ptr<AggregationRule>& rule): _rule(rule), _events(16) {}
+        explicit PerRuleAgg(const std::shared_ptr<AggregationRule>& rule): _rule(rule), _events() {}
 
         std::shared_ptr<AggregationRule> _rule;
-        std::unordered_map<std::vector<std::string_view>,std::shared_ptr<AggregatedEvent>> _events;
-        std::map<std::pair<std::chrono::steady_clock::time_point, uint64_t>, std::vector<std::string_view>> _events_age;
+        AggregationTable _events;
     };
 
+    // Add the events, in age order, to the rule's pending events
+    static void add_pending(PerRuleAgg& e, std::vector<std::shared_ptr<AggregatedEvent>>& aggs);
+
+    // Move the event to the _ready_events queue
+    void push_ready(std::shared_ptr<AggregatedEvent> agg);
+
+    // Add the event to the list of events to include in the next checkpoint
+    inline void mark_dirty(const std::shared_ptr<AggregatedEvent>& agg) {
+        if (_cp_log_fd >= 0 && !agg->_cp_dirty) {
+            agg->_cp_dirty = true;
+            _cp_dirty.emplace_back(agg);
+        }
+    }
+
+    // Call fn for each record, stop at the first incomplete or corrupt record.
+    // Return the offset of the first byte not consumed.
+    static size_t parse_records(const std::vector<uint8_t>& data, size_t offset, const std::function<void(const RecordHeader& header, const uint8_t* data)>& fn);
+
+    void load_text(FILE* file);
+    void load_binary(const std::string& path, const std::vector<uint8_t>& data);
+    // Append a record to _cp_buf, agg is nullptr for REMOVED records
+    void append_record(CheckpointRecordType type, uint64_t id, const AggregatedEvent* agg);
+    uint64_t write_save_file(const std::string& path);
+    void start_log(const std::string& path, uint64_t generation);
+    void close_log();
+
     std::vector<std::shared_ptr<AggregationRule>> _rules;
     std::shared_ptr<EventMatcher> _matcher;
     std::vector<std::shared_ptr<PerRuleAgg>> _events;
-    std::map<std::pair<std::chrono::steady_clock::time_point, uint64_t>, std::pair<std::shared_ptr<AggregatedEvent>, int>> _aged_events;
     std::queue<std::shared_ptr<AggregatedEvent>> _ready_events;
     std::vector<std::string_view> _tmp_key;
     rapidjson::StringBuffer _js_buffer;
     std::shared_ptr<BasicEventBuilderAllocator> _allocator;
     EventBuilder _builder;
+
+    // Checkpoint state
+    std::string _cp_path;
+    int _cp_log_fd;
+    uint64_t _cp_generation;
+    size_t _cp_save_size;
+    size_t _cp_log_size;
+    uint64_t _cp_next_ready_seq;
+    bool _cp_rules_changed;
+    std::unordered_map<const AggregationRule*, uint32_t> _cp_rule_idxs;
+    std::vector<std::shared_ptr<AggregatedEvent>> _cp_dirty;
+    std::vector<uint64_t> _cp_removed;
+    std::string _cp_buf;
 };
 
 #endif //AUOMS_EVENTAGGREGATOR_H
@@ -18,6 +18,10 @@
 #include <boost/test/unit_test.hpp>
 
 #include <memory>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
 
 #include "EventAggregator.h"
 #include "TestEventData.h"
@@ -25,6 +29,7 @@
 #include "FieldType.h"
 #include "RecordType.h"
 #include "TempFile.h"
+#include "Defer.h"
 
 
 void diff_event(int idx, const Event& e, const Event& a) {
@@ -610,6 +615,86 @@ BOOST_AUTO_TEST_CASE( test_max_pending ) {
     BOOST_REQUIRE_EQUAL(std::get<2>(ret), true);
 }
 
+BOOST_AUTO_TEST_CASE( test_max_pending_many ) {
+    constexpr int NUM_PENDING = 100;
+    constexpr int NUM_EVENTS = 150;
+
+    auto in_allocator = std::make_shared<TestEventQueue>();
+    auto prioritizer = DefaultPrioritizer::Create(0);
+    auto in_builder = std::make_shared<EventBuilder>(std::dynamic_pointer_cast<IEventBuilderAllocator>(in_allocator), prioritizer);
+
+    // Each event has a different aggregation key (ppid)
+    for (int i = 0; i < NUM_EVENTS; ++i) {
+        auto ppid = std::to_string(i);
+        in_builder->BeginEvent(i, 0, i, 1);
+        in_builder->BeginRecord(static_cast<uint32_t>(RecordType::AUOMS_EXECVE), "AUOMS_EXECVE", "", 4);
+        in_builder->AddField("syscall", "59", "execve", field_type_t::SYSCALL);
+        in_builder->AddField("ppid", ppid.c_str(), nullptr, field_type_t::UNCLASSIFIED);
+        in_builder->AddField("pid", "2", nullptr, field_type_t::UNCLASSIFIED);
+        in_builder->AddField("cmdline", "testcmd", nullptr, field_type_t::UNESCAPED);
+        in_builder->EndRecord();
+        if (in_builder->EndEvent() != 1) {
+            BOOST_FAIL("EndEvent failed");
+        }
+    }
+
+    std::string agg_rule_json = R"json({
+        "match_rule": {
+            "record_types": ["AUOMS_EXECVE"],
+            "field_rules": [
+                {
+                    "name": "syscall",
+                    "op": "eq",
+                    "value": "execve"
+                }
+            ]
+        },
+        "aggregation_fields": {
+            "pid": {}
+        },
+        "max_pending": 100
+    })json";
+
+    std::vector<std::shared_ptr<AggregationRule>> rules;
+    rules.emplace_back(AggregationRule::FromJSON(agg_rule_json));
+
+    auto agg = std::make_shared<EventAggregator>();
+    agg->SetRules(rules);
+
+    for (int i = 0; i < NUM_EVENTS; ++i) {
+        auto added = agg->AddEvent(in_allocator->GetEvent(i));
+        BOOST_REQUIRE_EQUAL(added, true);
+    }
+
+    BOOST_REQUIRE_EQUAL(agg->NumPendingAggregates(), NUM_PENDING);
+    BOOST_REQUIRE_EQUAL(agg->NumReadyAggregates(), NUM_EVENTS-NUM_PENDING);
+
+    // The events still pending are found by their key and aggregated
+    for (int i = NUM_EVENTS-NUM_PENDING; i < NUM_EVENTS; ++i) {
+        auto added = agg->AddEvent(in_allocator->GetEvent(i));
+        BOOST_REQUIRE_EQUAL(added, true);
+    }
+
+    BOOST_REQUIRE_EQUAL(agg->NumPendingAggregates(), NUM_PENDING);
+    BOOST_REQUIRE_EQUAL(agg->NumReadyAggregates(), NUM_EVENTS-NUM_PENDING);
+
+    // The oldest events were evicted first
+    uint64_t expected_serial = 0;
+    std::function<std::pair<long int, bool>(const Event&)> check_fn = [&](const Event& event) -> std::pair<int64_t, bool> {
+        BOOST_REQUIRE_EQUAL(event.Serial(), expected_serial);
+        BOOST_REQUIRE_EQUAL(event.RecordAt(0).FieldByName("num_aggregated_events").RawValue(), "1");
+        expected_serial += 1;
+        return std::make_pair(1, true);
+    };
+
+    for (int i = 0; i < NUM_EVENTS-NUM_PENDING; ++i) {
+        auto ret = agg->HandleEvent(check_fn);
+        BOOST_REQUIRE_EQUAL(std::get<0>(ret), true);
+    }
+
+    BOOST_REQUIRE_EQUAL(agg->NumReadyAggregates(), 0);
+}
+
 BOOST_AUTO_TEST_CASE( test_max_time ) {
     auto in_allocator = std::make_shared<TestEventQueue>();
     auto prioritizer = DefaultPrioritizer::Create(0);
@@ -1211,6 +1296,269 @@ BOOST_AUTO_TEST_CASE( test_save_load_same_obj ) {
 }
 
 
+BOOST_AUTO_TEST_CASE( test_checkpoint ) {
+    TempFile tmpFile("/tmp/agg_checkpoint_");
+    auto log_path = EventAggregator::CheckpointLogPath(tmpFile.Path());
+    Defer remove_log([&log_path]() {
+        unlink(log_path.c_str());
+    });
+    auto in_allocator = std::make_shared<TestEventQueue>();
+    auto prioritizer = DefaultPrioritizer::Create(0);
+    auto in_builder = std::make_shared<EventBuilder>(std::dynamic_pointer_cast<IEventBuilderAllocator>(in_allocator), prioritizer);
+
+    auto out_allocator = std::make_shared<BasicEventBuilderAllocator>();
+    auto out_builder = std::make_shared<EventBuilder>(std::dynamic_pointer_cast<IEventBuilderAllocator>(out_allocator), prioritizer);
+
+    out_builder->BeginEvent(2, 0, 2, 1);
+    out_builder->BeginRecord(static_cast<uint32_t>(RecordType::AUOMS_AGGREGATE), "AUOMS_AGGREGATE", "", 19);
+    out_builder->AddField("original_record_type_code", "14688", nullptr, field_type_t::UNCLASSIFIED);
+    out_builder->AddField("original_record_type", "AUOMS_EXECVE", nullptr, field_type_t::UNCLASSIFIED);
+    out_builder->AddField("first_event_time", "1970-01-01T00:00:00.000Z", nullptr, field_type_t::UNCLASSIFIED);
+    out_builder->AddField("last_event_time", "1970-01-01T00:00:02.000Z", nullptr, field_type_t::UNCLASSIFIED);
+    out_builder->AddField("num_aggregated_events", "3", nullptr, field_type_t::UNCLASSIFIED);
+    out_builder->AddField("syscall", "59", "execve", field_type_t::SYSCALL);
+    out_builder->AddField("ppid", "1", nullptr, field_type_t::UNCLASSIFIED);
+    out_builder->AddField("user", "1000", "test_user", field_type_t::UID);
+    out_builder->AddField("group", "1000", "test_group", field_type_t::GID);
+    out_builder->AddField("exe", "\"/usr/local/bin/testcmd\"", nullptr, field_type_t::ESCAPED);
+    out_builder->AddField("cmdline", "testcmd", nullptr, field_type_t::UNESCAPED);
+    out_builder->AddField("event_times", R"json(["0.000","1.000","2.000"])json", nullptr, field_type_t::UNCLASSIFIED);
+    out_builder->AddField("serials", R"json(["0","1","2"])json", nullptr, field_type_t::UNCLASSIFIED);
+    out_builder->AddField("pid", R"json(["2","2","2"])json", nullptr, field_type_t::UNCLASSIFIED);
+    out_builder->AddField("raw_test", R"json(["raw0","raw1","raw2"])json", nullptr, field_type_t::UNCLASSIFIED);
+    out_builder->AddField("interp_test", R"json(["interp0","interp1","interp2"])json", nullptr, field_type_t::UNCLASSIFIED);
+    out_builder->AddField("dyn_test", R"json(["test0","test1","test2"])json", nullptr, field_type_t::UNCLASSIFIED);
+    out_builder->AddField("test_null", R"json(["","",""])json", nullptr, field_type_t::UNCLASSIFIED);
+    out_builder->AddField("test_a", R"json(["test0","","test2"])json", nullptr, field_type_t::UNCLASSIFIED);
+    out_builder->EndRecord();
+    if (out_builder->EndEvent() != 1) {
+        BOOST_FAIL("EndEvent failed");
+    }
+
+    BOOST_CHECK_EQUAL(out_allocator->IsCommited(), true);
+
+    for (int i = 0; i < 4; ++i) {
+        char raw_str[16];
+        char interp_str[16];
+        char test_str[16];
+        snprintf(raw_str, sizeof(raw_str), "raw%i", i);
+        snprintf(interp_str, sizeof(interp_str), "interp%i", i);
+        snprintf(test_str, sizeof(test_str), "test%i", i);
+
+        uint16_t num_fields = 12;
+        if (i % 2 == 0) {
+            num_fields += 1;
+        }
+
+        in_builder->BeginEvent(i, 0, i, 1);
+        in_builder->BeginRecord(static_cast<uint32_t>(RecordType::AUOMS_EXECVE), "AUOMS_EXECVE", "", num_fields);
+        in_builder->AddField("syscall", "59", "execve", field_type_t::SYSCALL);
+        in_builder->AddField("ppid", "1", nullptr, field_type_t::UNCLASSIFIED);
+        in_builder->AddField("pid", "2", nullptr, field_type_t::UNCLASSIFIED);
+        in_builder->AddField("user", "1000", "test_user", field_type_t::UID);
+        in_builder->AddField("group", "1000", "test_group", field_type_t::GID);
+        in_builder->AddField("exe", "\"/usr/local/bin/testcmd\"", nullptr, field_type_t::ESCAPED);
+        in_builder->AddField("cmdline", "testcmd", nullptr, field_type_t::UNESCAPED);
+        in_builder->AddField("test_r", raw_str, interp_str, field_type_t::UNCLASSIFIED);
+        in_builder->AddField("test_drop", "012345", nullptr, field_type_t::UNCLASSIFIED);
+        in_builder->AddField("test_i", raw_str, interp_str, field_type_t::UNCLASSIFIED);
+        if (i % 2 == 0) {
+            in_builder->AddField("test_d", test_str, nullptr, field_type_t::UNCLASSIFIED);
+        } else {
+            in_builder->AddField("test_d", "bad", test_str, field_type_t::UNCLASSIFIED);
+        }
+        in_builder->AddField("test_null", "bad", nullptr, field_type_t::UNCLASSIFIED);
+        if (i % 2 == 0) {
+            in_builder->AddField("test_a", test_str, nullptr, field_type_t::UNCLASSIFIED);
+        }
+        in_builder->EndRecord();
+        if (in_builder->EndEvent() != 1) {
+            BOOST_FAIL("EndEvent failed");
+        }
+    }
+
+    std::string agg_rule_json = R"json({
+        "match_rule": {
+            "record_types": ["AUOMS_EXECVE"],
+            "field_rules": [
+                {
+                    "name": "syscall",
+                    "op": "eq",
+                    "value": "execve"
+                },
+                {
+                    "name": "cmdline",
+                    "op": "eq",
+                    "value": "testcmd"
+                }
+            ]
+        },
+        "aggregation_fields": {
+            "pid": {},
+            "test_r": {
+                "mode": "raw",
+                "output_name": "raw_test"
+            },
+            "test_i": {
+                "mode": "interp",
+                "output_name": "interp_test"
+            },
+            "test_d": {
+                "output_name": "dyn_test"
+            },
+            "test_null": {
+                "mode": "interp"
+            },
+            "test_drop": {
+                "mode": "drop"
+            },
+            "test_a": {
+                "mode": "raw"
+            }
+        },
+        "max_count": 3,
+        "max_size": 8192,
+        "max_time": 86400,
+        "send_first": false
+    })json";
+
+
+    std::vector<std::shared_ptr<AggregationRule>> rules;
+    rules.emplace_back(AggregationRule::FromJSON(agg_rule_json));
+
+    auto agg = std::make_shared<EventAggregator>();
+    agg->SetRules(rules);
+
+    std::function<std::pair<long int, bool>(const Event&)> ignore_fn = [&](const Event& event) -> std::pair<int64_t, bool> {
+        return std::make_pair(-1, false);
+    };
+
+    std::function<std::pair<long int, bool>(const Event&)> diff_fn = [&](const Event& event) -> std::pair<int64_t, bool> {
+        diff_event(0, out_allocator->GetEvent(), event);
+        return std::make_pair(1, true);
+    };
+
+    // The first checkpoint saves the full state and starts the log
+    agg->Checkpoint(tmpFile.Path());
+    BOOST_REQUIRE_EQUAL(access(log_path.c_str(), F_OK), 0);
+
+    for (int i = 0; i < 3; ++i) {
+        auto added = agg->AddEvent(in_allocator->GetEvent(i));
+        BOOST_REQUIRE_EQUAL(added, true);
+    }
+    agg->Checkpoint(tmpFile.Path());
+
+    // Load from the save file and log, as after a crash
+    auto agg2 = std::make_shared<EventAggregator>();
+    agg2->Load(tmpFile.Path());
+    BOOST_REQUIRE_EQUAL(agg2->NumPendingAggregates(), 1);
+    BOOST_REQUIRE_EQUAL(agg2->NumReadyAggregates(), 0);
+
+    // The aggregate is full, so the next event moves it to the ready queue
+    auto added = agg->AddEvent(in_allocator->GetEvent(3));
+    BOOST_REQUIRE_EQUAL(added, true);
+    agg->Checkpoint(tmpFile.Path());
+
+    auto agg3 = std::make_shared<EventAggregator>();
+    agg3->Load(tmpFile.Path());
+    BOOST_REQUIRE_EQUAL(agg3->NumPendingAggregates(), 1);
+    BOOST_REQUIRE_EQUAL(agg3->NumReadyAggregates(), 1);
+
+    auto ret = agg3->HandleEvent(diff_fn);
+    BOOST_REQUIRE_EQUAL(std::get<0>(ret), true);
+    BOOST_REQUIRE_EQUAL(std::get<1>(ret), 1);
+    BOOST_REQUIRE_EQUAL(std::get<2>(ret), true);
+
+    // Events consumed by the handler are removed from the checkpoint
+    ret = agg->HandleEvent(diff_fn);
+    BOOST_REQUIRE_EQUAL(std::get<0>(ret), true);
+    agg->Checkpoint(tmpFile.Path());
+
+    auto agg4 = std::make_shared<EventAggregator>();
+    agg4->Load(tmpFile.Path());
+    BOOST_REQUIRE_EQUAL(agg4->NumPendingAggregates(), 1);
+    BOOST_REQUIRE_EQUAL(agg4->NumReadyAggregates(), 0);
+
+    // An incomplete record at the end of the log (e.g. from a crash during a checkpoint) is ignored
+    int fd = open(log_path.c_str(), O_WRONLY|O_APPEND);
+    BOOST_REQUIRE(fd >= 0);
+    BOOST_REQUIRE_EQUAL(write(fd, "\x10\x00\x00\x00", 4), 4);
+    close(fd);
+
+    auto agg5 = std::make_shared<EventAggregator>();
+    agg5->Load(tmpFile.Path());
+    BOOST_REQUIRE_EQUAL(agg5->NumPendingAggregates(), 1);
+    BOOST_REQUIRE_EQUAL(agg5->NumReadyAggregates(), 0);
+
+    // Save writes the full state and removes the log
+    agg->Save(tmpFile.Path());
+    BOOST_REQUIRE_NE(access(log_path.c_str(), F_OK), 0);
+}
+
+
+BOOST_AUTO_TEST_CASE( test_read_corrupt_record ) {
+    auto in_allocator = std::make_shared<TestEventQueue>();
+    auto prioritizer = DefaultPrioritizer::Create(0);
+    auto in_builder = std::make_shared<EventBuilder>(std::dynamic_pointer_cast<IEventBuilderAllocator>(in_allocator), prioritizer);
+
+    in_builder->BeginEvent(0, 0, 0, 1);
+    in_builder->BeginRecord(static_cast<uint32_t>(RecordType::AUOMS_EXECVE), "AUOMS_EXECVE", "", 8);
+    in_builder->AddField("syscall", "59", "execve", field_type_t::SYSCALL);
+    in_builder->AddField("ppid", "1", nullptr, field_type_t::UNCLASSIFIED);
+    in_builder->AddField("pid", "2", nullptr, field_type_t::UNCLASSIFIED);
+    in_builder->AddField("user", "1000", "test_user", field_type_t::UID);
+    in_builder->AddField("group", "1000", "test_group", field_type_t::GID);
+    in_builder->AddField("exe", "\"/usr/local/bin/testcmd\"", nullptr, field_type_t::ESCAPED);
+    in_builder->AddField("cmdline", "testcmd", nullptr, field_type_t::UNESCAPED);
+    in_builder->AddField("test", "test0", nullptr, field_type_t::UNCLASSIFIED);
+    in_builder->EndRecord();
+    if (in_builder->EndEvent() != 1) {
+        BOOST_FAIL("EndEvent failed");
+    }
+
+    std::string agg_rule_json = R"json({
+        "match_rule": {
+            "record_types": ["AUOMS_EXECVE"],
+            "field_rules": [
+                {
+                    "name": "syscall",
+                    "op": "eq",
+                    "value": "execve"
+                }
+            ]
+        },
+        "aggregation_fields": {
+            "pid": {},
+            "test": {}
+        }
+    })json";
+
+    std::vector<std::shared_ptr<AggregationRule>> rules;
+    rules.emplace_back(AggregationRule::FromJSON(agg_rule_json));
+
+    AggregatedEvent ae(rules[0]);
+    BOOST_REQUIRE_EQUAL(ae.AddEvent(in_allocator->GetEvent(0)), true);
+
+    std::string buf;
+    ae.Write(buf, 0);
+
+    auto read_ae = AggregatedEvent::Read(reinterpret_cast<const uint8_t*>(buf.data()), buf.size(), rules);
+    BOOST_REQUIRE(read_ae);
+    BOOST_CHECK_EQUAL(read_ae->AggregationKey().size(), 6);
+    BOOST_CHECK_EQUAL(read_ae->AggregationKeyHash(), ae.AggregationKeyHash());
+
+    // num_key_values follows rule_idx, count, expiration_time, last_event_sec, last_event_serial, last_event_msec,
+    // origin_size and data_size in the record header
+    const size_t num_key_values_offset = 44;
+    for (uint32_t num_key_values : {0u, 5u, 7u, 0x7FFFFFFFu, 0xFFFFFFFFu}) {
+        auto corrupt = buf;
+        memcpy(&corrupt[num_key_values_offset], &num_key_values, sizeof(num_key_values));
+        BOOST_CHECK_THROW(AggregatedEvent::Read(reinterpret_cast<const uint8_t*>(corrupt.data()), corrupt.size(), rules), std::runtime_error);
+    }
+
+    BOOST_CHECK_THROW(AggregatedEvent::Read(reinterpret_cast<const uint8_t*>(buf.data()), buf.size()-1, rules), std::runtime_error);
+}
+
 BOOST_AUTO_TEST_CASE( basic_time_serial_delta ) {
     auto in_allocator = std::make_shared<TestEventQueue>();
     auto prioritizer = DefaultPrioritizer::Create(0);
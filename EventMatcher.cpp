@@ -21,7 +21,10 @@
 #include "StringUtils.h"
 
 #include <cassert>
+#include <cctype>
+#include <cstring>
 #include <sstream>
+#include <string_view>
 #include <re2/re2.h>
 #include <re2/set.h>
 #include <re2/stringpiece.h>
@@ -253,9 +256,44 @@ std::string EventMatchRule::ToJSONString() const {
  *
  ****************************************************************************/
 
+// If the anchored pattern ("^...$") generated for an EQ/IN value matches only a single literal string,
+// put that string in literal and return true.
+// Only plain ASCII and backslash escaped punctuation are accepted, anything else is left to RE2.
+static bool anchored_pattern_to_literal(const std::string& pattern, std::string& literal) {
+    if (pattern.size() < 2 || pattern.front() != '^' || pattern.back() != '$') {
+        return false;
+    }
+
+    literal.clear();
+    literal.reserve(pattern.size()-2);
+    for (size_t i = 1; i < pattern.size()-1; ++i) {
+        auto c = static_cast<unsigned char>(pattern[i]);
+        if (c >= 0x80) {
+            return false;
+        }
+        if (c == '\\') {
+            ++i;
+            if (i >= pattern.size()-1 || !std::ispunct(static_cast<unsigned char>(pattern[i]))) {
+                return false;
+            }
+            literal.push_back(pattern[i]);
+            continue;
+        }
+        if (std::strchr(".+*?()|[]{}^$", c) != nullptr) {
+            return false;
+        }
+        literal.push_back(static_cast<char>(c));
+    }
+    return true;
+}
+
+/*
+ * EQ and IN values that are plain literals are matched with a hash lookup of the field value,
+ * only regex values (and all RE values) are added to the RE2::Set.
+ */
 class EventMatcher::FieldMatcher {
 public:
-    FieldMatcher(const std::string& name, int num_event_rules, int index): _name(name), _num_event_rules(num_event_rules), _index(index), _re_set(RE2::Options(), RE2::UNANCHORED) {
+    FieldMatcher(const std::string& name, int num_event_rules, int index): _name(name), _num_event_rules(num_event_rules), _index(index), _re_set(RE2::Options(), RE2::UNANCHORED), _num_patterns(0) {
         RE2::Options opts;
         opts.set_never_capture(true);
 
@@ -279,10 +317,22 @@ public:
             }
         }
 
+        _literal_values.clear();
+        _literals.clear();
+        _num_patterns = 0;
+
+        std::vector<int> literal_rules;
         std::string error;
+        std::string literal;
         for (int i = 0; i < _rules.size(); i++) {
             if (_rules[i] != nullptr) {
+                auto op = _rules[i]->Op() & ~FIELD_OP_NOT;
                 for (auto& p : _rules[i]->Values()) {
+                    if ((op == FIELD_OP_EQ || op == FIELD_OP_IN) && anchored_pattern_to_literal(p, literal)) {
+                        _literal_values.emplace_back(literal);
+                        literal_rules.emplace_back(i);
+                        continue;
+                    }
                     std::string e;
                     auto idx = _re_set.Add(p, &e);
                     if (idx < 0) {
@@ -291,11 +341,20 @@ public:
                     }
                     _to_rule.emplace_back(i);
                     assert(_to_rule.size() == idx+1);
+                    _num_patterns++;
                 }
             }
         }
 
-        if (!_re_set.Compile()) {
+        // _literal_values is no longer modified, so the keys can safely reference its strings
+        for (size_t n = 0; n < _literal_values.size(); ++n) {
+            auto& rules = _literals[_literal_values[n]];
+            if (rules.empty() || rules.back() != literal_rules[n]) {
+                rules.emplace_back(literal_rules[n]);
+            }
+        }
+
+        if (_num_patterns > 0 && !_re_set.Compile()) {
             return false;
         }
 
@@ -319,7 +378,28 @@ public:
             val = re2::StringPiece(f.RawValuePtr(), f.RawValueSize());
         }
 
-        if (!_re_set.Match(val, &_matches)) {
+        int32_t tmp[_shift_counts.size()];
+        std::fill(tmp, tmp+_shift_counts.size(), 0x80000000);
+
+        bool matched = false;
+        if (!_literals.empty()) {
+            auto lit = _literals.find(std::string_view(val.data(), val.size()));
+            if (lit != _literals.end()) {
+                for (auto i : lit->second) {
+                    tmp[i] >>= 1;
+                }
+                matched = true;
+            }
+        }
+
+        if (_num_patterns > 0 && _re_set.Match(val, &_matches)) {
+            for (auto m :_matches) {
+                tmp[_to_rule[m]] >>= 1;
+            }
+            matched = true;
+        }
+
+        if (!matched) {
             uint32_t matchCount = 0;
             for (int i = 0; i < _not_mask.size(); i++) {
                 auto tmp = (0 ^ _not_mask[i]);
@@ -329,13 +409,6 @@ public:
             return matchCount > 0;
         }
 
-        int32_t tmp[_shift_counts.size()];
-        std::fill(tmp, tmp+_shift_counts.size(), 0x80000000);
-
-        for (auto m :_matches) {
-            tmp[_to_rule[m]] >>= 1;
-        }
-
         for (int i = 0; i < _shift_counts.size(); i++) {
             ruleMatchedFields[i] |= (((static_cast<uint32_t>(tmp[i]) >> 31-_shift_counts[i]) & 1) ^ _not_mask[i]) << _index;
         }
@@ -348,6 +421,9 @@ public:
     int _index;
     std::vector<std::shared_ptr<FieldMatchRule>> _rules;
     RE2::Set _re_set;
+    int _num_patterns;
+    std::vector<std::string> _literal_values;
+    std::unordered_map<std::string_view, std::vector<int>> _literals;
     std::vector<int> _to_rule;
     std::vector<int32_t> _shift_counts;
     std::vector<uint32_t> _not_mask;
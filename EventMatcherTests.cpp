@@ -276,6 +276,46 @@ BOOST_AUTO_TEST_CASE( basic_test ) {
                 ]})json"},
             }}
         },
+        {
+            "1 field eq escaped literal, match",
+            {{
+                {true, R"json({"record_types": ["AUOMS_EXECVE"], "field_rules": [{"name": "user", "op": "eq", "value": "test\\_user"}]})json"},
+            }}
+        },
+        {
+            "1 field eq regex, match",
+            {{
+                {true, R"json({"record_types": ["AUOMS_EXECVE"], "field_rules": [{"name": "cmdline", "op": "eq", "value": "testcmd .* lastarg"}]})json"},
+            }}
+        },
+        {
+            "1 field eq literal, not partial match",
+            {{
+                {false, R"json({"record_types": ["AUOMS_EXECVE"], "field_rules": [{"name": "cmdline", "op": "eq", "value": "testcmd arg1"}]})json"},
+            }}
+        },
+        {
+            "1 field in literal and regex, match regex",
+            {{
+                {true, R"json({"record_types": ["AUOMS_EXECVE"], "field_rules": [{"name": "syscall", "op": "in", "values": ["open","exec.*"]}]})json"},
+            }}
+        },
+        {
+            "1 field !in literal and regex, not match literal",
+            {{
+                {false, R"json({"record_types": ["AUOMS_EXECVE"], "field_rules": [{"name": "syscall", "op": "!in", "values": ["execve","open.*"]}]})json"},
+            }}
+        },
+        {
+            "2 rules, same literal, match first",
+            {{
+                {true, R"json({"record_types": ["AUOMS_EXECVE"], "field_rules": [
+                    {"name": "syscall", "op": "in", "values": ["connect","execve"]},
+                    {"name": "user", "op": "eq", "value": "test_user"}
+                ]})json"},
+                {false, R"json({"record_types": ["AUOMS_EXECVE"], "field_rules": [{"name": "syscall", "op": "eq", "value": "execve"}]})json"},
+            }}
+        },
     };
 
     for (auto& test : tests) {
@@ -283,4 +323,4 @@ BOOST_AUTO_TEST_CASE( basic_test ) {
             BOOST_FAIL(test.Error());
         }
     }
-}
\ No newline at end of file
+}
@@ -22,10 +22,12 @@
 #include "TempDir.h"
 #include "TestEventData.h"
 #include "RawEventProcessor.h"
+#include "RawEventProcessorPool.h"
 #include "RawEventAccumulator.h"
 #include "StringUtils.h"
 #include "EventPrioritizer.h"
 #include "InputBuffer.h"
+#include "Signals.h"
 
 #include <fstream>
 #include <stdexcept>
@@ -47,7 +49,8 @@ void write_file(const std::string& path, const std::string& text) {
 
 class RawEventQueue: public IEventBuilderAllocator {
 public:
-    explicit RawEventQueue(std::shared_ptr<RawEventProcessor> proc): _buffer(), _size(0), _proc(std::move(proc)) {}
+    explicit RawEventQueue(std::shared_ptr<RawEventProcessor> proc): _buffer(), _size(0), _fn([proc](const void* data, size_t size) { proc->ProcessData(data, size); }) {}
+    explicit RawEventQueue(std::function<void(const void*, size_t)> fn): _buffer(), _size(0), _fn(std::move(fn)) {}
 
     bool Allocate(void** data, size_t size) override {
         if (_size != size) {
@@ -64,7 +67,7 @@ public:
         if (_size > InputBuffer::MAX_DATA_SIZE) {
             return -1;
         }
-        _proc->ProcessData(_buffer.data(), _size);
+        _fn(_buffer.data(), _size);
         _size = 0;
         return 1;
     }
@@ -77,7 +80,7 @@ public:
 private:
     std::vector<uint8_t> _buffer;
     size_t _size;
-    std::shared_ptr<RawEventProcessor> _proc;
+    std::function<void(const void*, size_t)> _fn;
 };
 
 
@@ -354,3 +357,203 @@ BOOST_AUTO_TEST_CASE( oversized_event_test ) {
     Event e = actual_queue->GetEvent(0);
     BOOST_REQUIRE_LE(e.Size(), InputBuffer::MAX_DATA_SIZE);
 }
+
+BOOST_AUTO_TEST_CASE( pool_test ) {
+    TempDir dir("/tmp/EventProcessorTests");
+
+    // RunBase uses SIGQUIT to interrupt the worker threads
+    Signals::Init();
+
+    write_file(dir.Path() + "/passwd", passwd_file_text);
+    write_file(dir.Path() + "/group", group_file_text);
+
+    auto user_db = std::make_shared<UserDB>(dir.Path());
+
+    user_db->update();
+
+    auto expected_queue = new TestEventQueue();
+    auto metrics_queue = new TestEventQueue();
+    auto prioritizer = DefaultPrioritizer::Create(0);
+    auto expected_allocator = std::shared_ptr<IEventBuilderAllocator>(expected_queue);
+    auto metrics_allocator = std::shared_ptr<IEventBuilderAllocator>(metrics_queue);
+    auto expected_builder = std::make_shared<EventBuilder>(expected_allocator, prioritizer);
+    auto metrics_builder = std::make_shared<EventBuilder>(metrics_allocator, prioritizer);
+
+    std::shared_ptr<FiltersEngine> filtersEngine; // Intentionally left unassigned
+    std::shared_ptr<ProcessTree> processTree; // Intentionally left unassigned
+
+    auto metrics = std::make_shared<Metrics>("test", metrics_builder);
+
+    auto cmdline_redactor = std::make_shared<CmdlineRedactor>();
+    auto test_rule = std::make_shared<const CmdlineRedactionRule>(test_redaction_rule_filename, test_redaction_rule_name, test_redaction_rule_regex, '*');
+    cmdline_redactor->AddRule(test_rule);
+
+    // Each worker gets its own output queue
+    std::vector<TestEventQueue*> worker_queues;
+    RawEventProcessorPool pool(4, 4, [&worker_queues, &prioritizer]() {
+        auto queue = new TestEventQueue();
+        worker_queues.emplace_back(queue);
+        return std::make_shared<EventBuilder>(std::shared_ptr<IEventBuilderAllocator>(queue), prioritizer);
+    }, user_db, cmdline_redactor, processTree, filtersEngine, metrics);
+    BOOST_REQUIRE_EQUAL(pool.NumWorkers(), 4);
+    pool.Start();
+
+    auto actual_raw_queue = new RawEventQueue([&pool](const void* data, size_t size) {
+        BOOST_REQUIRE(pool.ProcessData(data, size));
+    });
+    auto actual_raw_allocator = std::shared_ptr<IEventBuilderAllocator>(actual_raw_queue);
+    auto actual_raw_builder = std::make_shared<EventBuilder>(actual_raw_allocator, prioritizer);
+
+    for (auto e : test_events) {
+        e.Write(expected_builder);
+    }
+
+    RawEventAccumulator accumulator(actual_raw_builder, metrics);
+
+    for (int i = 0; i < raw_test_events.size(); i++) {
+        auto raw_event = raw_test_events[i];
+        auto do_flush = raw_events_do_flush[i];
+        std::string event_txt = raw_event;
+        auto lines = split(event_txt, '\n');
+        for (auto& line: lines) {
+            std::unique_ptr<RawEventRecord> record = std::make_unique<RawEventRecord>();
+            std::memcpy(record->Data(), line.c_str(), line.size());
+            if (record->Parse(RecordType::UNKNOWN, line.size())) {
+                accumulator.AddRecord(std::move(record));
+            } else {
+                Logger::Warn("Received unparsable event data: %s", line.c_str());
+            }
+        }
+        if (do_flush) {
+            accumulator.Flush(0);
+        }
+    }
+
+    // Stop waits for all queued events to be processed
+    pool.Stop();
+
+    // The first worker also generates process inventory events, ignore them
+    std::vector<Event> actual_events;
+    for (auto queue : worker_queues) {
+        for (size_t idx = 0; idx < queue->GetEventCount(); ++idx) {
+            auto event = queue->GetEvent(idx);
+            if (static_cast<RecordType>(event.begin().RecordType()) != RecordType::AUOMS_PROCESS_INVENTORY) {
+                actual_events.emplace_back(event);
+            }
+        }
+    }
+
+    BOOST_REQUIRE_EQUAL(expected_queue->GetEventCount(), actual_events.size());
+
+    // Events are only ordered within a worker, so match each expected event to any identical actual event
+    std::vector<bool> matched(actual_events.size(), false);
+    for (size_t idx = 0; idx < expected_queue->GetEventCount(); ++idx) {
+        auto expected = expected_queue->GetEvent(idx);
+        bool found = false;
+        for (size_t a = 0; a < actual_events.size() && !found; ++a) {
+            if (!matched[a] && actual_events[a].Serial() == expected.Serial()) {
+                try {
+                    diff_event(idx, expected, actual_events[a]);
+                    matched[a] = true;
+                    found = true;
+                } catch (const std::exception&) {}
+            }
+        }
+        if (!found) {
+            BOOST_FAIL("No matching event found for expected event " + std::to_string(idx));
+        }
+    }
+}
+
+// The key=value splitting RawEventRecord::Parse did with std::string_view::find_first_of before it used
+// find_first_of_chars. Returns the fields in the order RawEventRecord::AddRecord adds them.
+std::vector<std::pair<std::string, std::string>> baseline_record_fields(std::string_view str) {
+    std::vector<std::pair<std::string, std::string>> fields;
+
+    // Skip the "node=<> type=<> msg=audit(<>):" prefix
+    size_t idx = 0;
+    std::string_view type_name;
+    for (;;) {
+        auto end = std::min(str.find_first_of(" \n"), str.size());
+        auto text = str.substr(0, end);
+        idx = str.find_first_not_of(" \n", end);
+        str = idx == std::string_view::npos ? std::string_view() : str.substr(idx);
+        if (starts_with(text, "node=")) {
+            fields.emplace_back("node", text.substr(5));
+        } else if (starts_with(text, "type=")) {
+            type_name = text.substr(5);
+        } else {
+            break;
+        }
+    }
+
+    if (type_name == "INTEGRITY_POLICY_RULE") {
+        fields.emplace_back("unparsed_text", str);
+        return fields;
+    }
+
+    int unknown_key = 1;
+    idx = 0;
+    while (idx != std::string_view::npos && idx < str.size()) {
+        auto eq = str.find_first_of('=', idx);
+        if (eq == std::string_view::npos) {
+            fields.emplace_back("unknown" + std::to_string(unknown_key++), str.substr(idx));
+            break;
+        }
+        auto key = str.substr(idx, eq-idx);
+        idx = eq+1;
+        if (key == "msg" && str[idx] == '\'') {
+            idx += 1;
+            continue;
+        }
+        size_t end;
+        if (str[idx] == '"') {
+            end = str.find_first_of('"', idx+1);
+            end = end == std::string_view::npos ? str.size() : end+1;
+        } else {
+            end = std::min(str.find_first_of("' \n", idx), str.size());
+        }
+        fields.emplace_back(key, str.substr(idx, end-idx));
+        idx = str.find_first_not_of("' \n", end);
+    }
+    return fields;
+}
+
+BOOST_AUTO_TEST_CASE( parse_record_fields_test ) {
+    auto queue = new TestEventQueue();
+    auto allocator = std::shared_ptr<IEventBuilderAllocator>(queue);
+    auto builder = std::make_shared<EventBuilder>(allocator, DefaultPrioritizer::Create(0));
+
+    // Reuse one pooled record for every line, so that any state left over from the previous Parse() shows up
+    RawEventRecordPool pool;
+    auto record = pool.Alloc();
+    size_t num_records = 0;
+    for (auto raw_event: raw_test_events) {
+        for (auto& line: split(std::string(raw_event), '\n')) {
+            if (line.empty()) {
+                continue;
+            }
+            std::memcpy(record->Data(), line.data(), line.size());
+            BOOST_REQUIRE_MESSAGE(record->Parse(RecordType::UNKNOWN, line.size()), "Failed to parse: " + line);
+            auto expected = baseline_record_fields(line);
+            // Records without fields (e.g. EOE) are never added to an event
+            if (expected.empty()) {
+                continue;
+            }
+            BOOST_REQUIRE_EQUAL(builder->BeginEvent(0, 0, 0, 1), 1);
+            BOOST_REQUIRE(record->AddRecord(*builder));
+            BOOST_REQUIRE_EQUAL(builder->EndEvent(), 1);
+
+            auto rec = queue->GetEvent(queue->GetEventCount()-1).RecordAt(0);
+            BOOST_REQUIRE_EQUAL(rec.NumFields(), expected.size());
+            for (uint16_t i = 0; i < rec.NumFields(); ++i) {
+                auto field = rec.FieldAt(i);
+                BOOST_REQUIRE_EQUAL(field.FieldName(), expected[i].first);
+                BOOST_REQUIRE_EQUAL(field.RawValue(), expected[i].second);
+            }
+            num_records++;
+        }
+    }
+    pool.Release(std::move(record));
+    BOOST_REQUIRE(num_records > 0);
+}
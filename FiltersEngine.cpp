@@ -17,6 +17,7 @@
 
 #include "Logger.h"
 #include "StringUtils.h"
+#include "Translate.h"
 
 #include <string>
 #include <iostream>
@@ -27,6 +28,19 @@
 #include <unistd.h>
 #include <limits.h>
 
+// Bounds the size of _syscallMasks, syscalls with a larger number are looked up by name
+constexpr int MAX_SYSCALL_NUMBER = 1024;
+
+// Any syscall table will do as an index, but the host's will have numbers for the most syscall names
+FiltersEngine::FiltersEngine(): FiltersEngine(DetectMachine()) {}
+
+FiltersEngine::FiltersEngine(MachineType syscallMachine): _nextBitPosition(0), _syscallMachine(syscallMachine)
+{
+    if (_syscallMachine == MachineType::UNKNOWN) {
+        _syscallMachine = MachineType::X86_64;
+    }
+}
+
 std::bitset<FILTER_BITSET_SIZE> FiltersEngine::AddFilter(const ProcFilterSpec& pfs, const std::string& outputName)
 {
     std::bitset<FILTER_BITSET_SIZE> ret;
@@ -57,7 +71,7 @@ std::bitset<FILTER_BITSET_SIZE> FiltersEngine::AddFilter(const ProcFilterSpec& p
                 }
             } else {
                 if (syscalls.count(s.substr(1)) == 0) {
-                    syscalls[s] = false;
+                    syscalls[s.substr(1)] = false;
                 }
             }
         }
@@ -80,6 +94,7 @@ std::bitset<FILTER_BITSET_SIZE> FiltersEngine::AddFilterList(const std::vector<P
     }
 
     SetCommonFlagsMask();
+    SetSyscallMasks();
 
     return ret;
 }
@@ -116,6 +131,7 @@ void FiltersEngine::RemoveFilterList(const std::vector<ProcFilterSpec>& pfsVec,
 
     _outputs.erase(outputName);
     SetCommonFlagsMask();
+    SetSyscallMasks();
 }
 
 bool FiltersEngine::ProcessMatchFilter(const std::shared_ptr<ProcessTreeItem>& process, const ProcFilterSpec& pfs, unsigned int height)
@@ -136,7 +152,7 @@ bool FiltersEngine::ProcessMatchFilter(const std::shared_ptr<ProcessTreeItem>& p
         }
     }
 
-    auto exe = process->exe();
+    const auto& exe = process->exe();
 
     if (pfs._match_mask & PFS_MATCH_EXE_EQUALS) {
         if (pfs._exeMatchValue != exe) {
@@ -161,7 +177,7 @@ bool FiltersEngine::ProcessMatchFilter(const std::shared_ptr<ProcessTreeItem>& p
         }
     }
 
-    auto cmdline = process->cmdline();
+    const auto& cmdline = process->cmdline();
 
     for (auto cf : pfs._cmdlineFilters) {
         if (cf._matchType == MatchEquals) {
@@ -219,43 +235,75 @@ void FiltersEngine::SetCommonFlagsMask()
     _globalFlagsMask = flags;
 }
 
-bool FiltersEngine::syscallIsFiltered(const std::string& syscall, const std::unordered_map<std::string, bool>& syscalls)
+void FiltersEngine::SetSyscallMasks()
 {
-    auto it = syscalls.find(syscall);
-    if (it != syscalls.end()) {
-        return it->second;
-    } else {
-        if (syscalls.count("*") > 0) {
-            return true;
+    std::vector<SyscallMasks> masks;
+    std::vector<std::string> names;
+    std::unordered_map<std::string, SyscallMasks> other_masks;
+    std::bitset<FILTER_BITSET_SIZE> wildcard;
+
+    for (auto& element : _bitPositionSyscalls) {
+        auto bit = element.first;
+        if (bit >= FILTER_BITSET_SIZE) {
+            continue;
+        }
+        for (auto& syscall : element.second) {
+            if (syscall.first == "*") {
+                if (syscall.second) {
+                    wildcard[bit] = true;
+                }
+                continue;
+            }
+            SyscallMasks* m;
+            auto num = SyscallNameToNumber(_syscallMachine, syscall.first);
+            // Names that share a number (e.g. i386 madvise and madvise1) must not share masks, so only the name
+            // the number translates back to is indexed by number
+            if (num >= 0 && num < MAX_SYSCALL_NUMBER && SyscallToName(_syscallMachine, num) == syscall.first) {
+                if (static_cast<size_t>(num) >= masks.size()) {
+                    masks.resize(num + 1);
+                    names.resize(num + 1);
+                }
+                names[num] = syscall.first;
+                m = &masks[num];
+            } else {
+                m = &other_masks[syscall.first];
+            }
+            m->listed[bit] = true;
+            m->excluded[bit] = syscall.second;
         }
     }
-    return false;
+
+    _syscallMasks = std::move(masks);
+    _syscallNames = std::move(names);
+    _otherSyscallMasks = std::move(other_masks);
+    _wildcardMask = wildcard;
 }
 
 bool FiltersEngine::IsEventFiltered(const std::string& syscall, const std::shared_ptr<ProcessTreeItem>& p, const std::bitset<FILTER_BITSET_SIZE>& filterFlagsMask)
 {
-    // Get event syscall
-    bool filtered = false;
-
     if (syscall.empty() || !p) {
         return false;
     }
 
     // Check if this process is filtered
     std::bitset<FILTER_BITSET_SIZE> matched_flags = p->flags() & filterFlagsMask;
+    if (matched_flags.none()) {
+        return false;
+    }
 
-    // Find syscalls filtered for process
-    for (unsigned int i=0; i<_nextBitPosition; i++) {
-        if (matched_flags[i]) {
-            std::unordered_map<std::string, bool>& syscalls = _bitPositionSyscalls[i];
-            if (syscallIsFiltered(syscall, syscalls)) {
-                filtered = true;
-                break;
-            }
+    // Find the filters that list this syscall
+    static const SyscallMasks empty_masks;
+    const SyscallMasks* masks = &empty_masks;
+    auto num = SyscallNameToNumber(_syscallMachine, syscall);
+    if (num >= 0 && static_cast<size_t>(num) < _syscallMasks.size() && _syscallNames[num] == syscall) {
+        masks = &_syscallMasks[num];
+    } else if (!_otherSyscallMasks.empty()) {
+        auto it = _otherSyscallMasks.find(syscall);
+        if (it != _otherSyscallMasks.end()) {
+            masks = &it->second;
         }
     }
 
-    return filtered;
+    // A filter excludes the syscall if it lists it without a '!', or doesn't list it but has "*"
+    return (matched_flags & (masks->excluded | (_wildcardMask & ~masks->listed))).any();
 }
-
-
@@ -30,6 +30,7 @@
 #include "ProcFilter.h"
 #include "ProcessTree.h"
 #include "ProcessDefines.h"
+#include "MachineType.h"
 
 
 struct FiltersInfo {
@@ -41,7 +42,9 @@ class ProcessTreeItem;
 
 class FiltersEngine {
 public:
-    FiltersEngine(): _nextBitPosition(0) {}
+    FiltersEngine();
+    // Use the syscall table of syscallMachine to index the syscall names
+    explicit FiltersEngine(MachineType syscallMachine);
     std::bitset<FILTER_BITSET_SIZE> AddFilterList(const std::vector<ProcFilterSpec>& pfsVec, const std::string& outputName);
     void RemoveFilterList(const std::vector<ProcFilterSpec>& pfsVec, const std::string& outputName);
     std::bitset<FILTER_BITSET_SIZE> GetFlags(const std::shared_ptr<ProcessTreeItem>& process, unsigned int height);
@@ -53,13 +56,29 @@ private:
     void RemoveFilter(const ProcFilterSpec& pfs, const std::string& outputName);
     void SetCommonFlagsMask();
     bool ProcessMatchFilter(const std::shared_ptr<ProcessTreeItem>& process, const ProcFilterSpec& pfs, unsigned int height);
-    bool syscallIsFiltered(const std::string& syscall, const std::unordered_map<std::string, bool>& syscalls);
+    void SetSyscallMasks();
+
+    // The filters that list a syscall, and the subset of those that exclude it (i.e. list it without a leading '!')
+    struct SyscallMasks {
+        std::bitset<FILTER_BITSET_SIZE> listed;
+        std::bitset<FILTER_BITSET_SIZE> excluded;
+    };
 
     unsigned int _nextBitPosition;
     std::bitset<FILTER_BITSET_SIZE> _globalFlagsMask;
     std::unordered_set<std::string> _outputs;
     std::unordered_map<ProcFilterSpec, FiltersInfo, ProcFilterSpecHash, ProcFilterSpecCompare> _filtersBitPosition;
     std::unordered_map<unsigned int, std::unordered_map<std::string, bool>> _bitPositionSyscalls;
+
+    // Built from _bitPositionSyscalls by SetSyscallMasks(). The syscall numbers of _syscallMachine are used as a
+    // dense index for the syscall names, names that have no number (or are an alias for another name's number)
+    // go in _otherSyscallMasks. _syscallNames holds the name each _syscallMasks entry belongs to.
+    MachineType _syscallMachine;
+    std::vector<SyscallMasks> _syscallMasks;
+    std::vector<std::string> _syscallNames;
+    std::unordered_map<std::string, SyscallMasks> _otherSyscallMasks;
+    // The filters that exclude every syscall they don't list ("*")
+    std::bitset<FILTER_BITSET_SIZE> _wildcardMask;
 };
 
 #endif //AUOMS_FILTERS_ENGINE_H
@@ -0,0 +1,103 @@
+/*
+    microsoft-oms-auditd-plugin
+
+    Copyright (c) Microsoft Corporation
+
+    All rights reserved.
+
+    MIT License
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+//#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE "FiltersEngineTests"
+#include <boost/test/unit_test.hpp>
+
+#include "FiltersEngine.h"
+#include "ProcessTree.h"
+#include <vector>
+
+BOOST_AUTO_TEST_CASE( syscall_filter_test ) {
+    auto filtersEngine = std::make_shared<FiltersEngine>();
+    auto processTree = std::make_shared<ProcessTree>(nullptr, filtersEngine);
+
+    std::vector<std::string> listed = {"open", "connect", "not-a-syscall"};
+    std::vector<std::string> wildcard = {"*"};
+    std::vector<ProcFilterSpec> filters;
+    filters.emplace_back(PFS_MATCH_EXE_EQUALS, -1, 0, 0, listed, "/usr/bin/listed", std::vector<cmdlineFilter>());
+    filters.emplace_back(PFS_MATCH_EXE_EQUALS, -1, 0, 0, wildcard, "/usr/bin/wildcard", std::vector<cmdlineFilter>());
+    auto mask = filtersEngine->AddFilterList(filters, "test");
+
+    auto p1 = processTree->AddProcess(ProcessTreeSource_execve, 1000, 1, 0, 0, "/usr/bin/listed", "listed");
+    auto p2 = processTree->AddProcess(ProcessTreeSource_execve, 1001, 1, 0, 0, "/usr/bin/wildcard", "wildcard");
+    auto p3 = processTree->AddProcess(ProcessTreeSource_execve, 1002, 1, 0, 0, "/usr/bin/other", "other");
+
+    BOOST_REQUIRE(filtersEngine->IsEventFiltered("open", p1, mask));
+    BOOST_REQUIRE(filtersEngine->IsEventFiltered("connect", p1, mask));
+    BOOST_REQUIRE(filtersEngine->IsEventFiltered("not-a-syscall", p1, mask));
+    BOOST_REQUIRE(!filtersEngine->IsEventFiltered("execve", p1, mask));
+
+    BOOST_REQUIRE(filtersEngine->IsEventFiltered("execve", p2, mask));
+    BOOST_REQUIRE(filtersEngine->IsEventFiltered("connect", p2, mask));
+    BOOST_REQUIRE(filtersEngine->IsEventFiltered("unknown-syscall(999)", p2, mask));
+
+    BOOST_REQUIRE(!filtersEngine->IsEventFiltered("open", p3, mask));
+
+    // Once removed, nothing is filtered
+    filtersEngine->RemoveFilterList(filters, "test");
+    BOOST_REQUIRE(!filtersEngine->IsEventFiltered("open", p1, mask));
+    BOOST_REQUIRE(!filtersEngine->IsEventFiltered("connect", p2, mask));
+}
+
+BOOST_AUTO_TEST_CASE( syscall_exclude_test ) {
+    auto filtersEngine = std::make_shared<FiltersEngine>();
+    auto processTree = std::make_shared<ProcessTree>(nullptr, filtersEngine);
+
+    // "!syscall" keeps a syscall that "*" would otherwise filter, and only the first entry for a syscall counts
+    std::vector<std::string> all_but = {"*", "!execve", "open", "!open", "!connect", "connect"};
+    std::vector<ProcFilterSpec> filters;
+    filters.emplace_back(PFS_MATCH_EXE_EQUALS, -1, 0, 0, all_but, "/usr/bin/all_but", std::vector<cmdlineFilter>());
+    auto mask = filtersEngine->AddFilterList(filters, "test");
+
+    auto p1 = processTree->AddProcess(ProcessTreeSource_execve, 1000, 1, 0, 0, "/usr/bin/all_but", "all_but");
+    auto p2 = processTree->AddProcess(ProcessTreeSource_execve, 1001, 1, 0, 0, "/usr/bin/other", "other");
+
+    BOOST_REQUIRE(!filtersEngine->IsEventFiltered("execve", p1, mask));
+    BOOST_REQUIRE(filtersEngine->IsEventFiltered("open", p1, mask));
+    BOOST_REQUIRE(!filtersEngine->IsEventFiltered("connect", p1, mask));
+    BOOST_REQUIRE(filtersEngine->IsEventFiltered("read", p1, mask));
+
+    BOOST_REQUIRE(!filtersEngine->IsEventFiltered("read", p2, mask));
+}
+
+BOOST_AUTO_TEST_CASE( syscall_alias_test ) {
+    // In the i386 syscall table, madvise and madvise1 are both 219
+    auto filtersEngine = std::make_shared<FiltersEngine>(MachineType::X86);
+    auto processTree = std::make_shared<ProcessTree>(nullptr, filtersEngine);
+
+    std::vector<std::string> madvise = {"madvise"};
+    std::vector<std::string> madvise1 = {"madvise1"};
+    std::vector<std::string> all_but = {"*", "!madvise"};
+    std::vector<ProcFilterSpec> filters;
+    filters.emplace_back(PFS_MATCH_EXE_EQUALS, -1, 0, 0, madvise, "/usr/bin/madvise", std::vector<cmdlineFilter>());
+    filters.emplace_back(PFS_MATCH_EXE_EQUALS, -1, 0, 0, madvise1, "/usr/bin/madvise1", std::vector<cmdlineFilter>());
+    filters.emplace_back(PFS_MATCH_EXE_EQUALS, -1, 0, 0, all_but, "/usr/bin/all_but", std::vector<cmdlineFilter>());
+    auto mask = filtersEngine->AddFilterList(filters, "test");
+
+    auto p1 = processTree->AddProcess(ProcessTreeSource_execve, 1000, 1, 0, 0, "/usr/bin/madvise", "madvise");
+    auto p2 = processTree->AddProcess(ProcessTreeSource_execve, 1001, 1, 0, 0, "/usr/bin/madvise1", "madvise1");
+    auto p3 = processTree->AddProcess(ProcessTreeSource_execve, 1002, 1, 0, 0, "/usr/bin/all_but", "all_but");
+
+    BOOST_REQUIRE(filtersEngine->IsEventFiltered("madvise", p1, mask));
+    BOOST_REQUIRE(!filtersEngine->IsEventFiltered("madvise1", p1, mask));
+
+    BOOST_REQUIRE(!filtersEngine->IsEventFiltered("madvise", p2, mask));
+    BOOST_REQUIRE(filtersEngine->IsEventFiltered("madvise1", p2, mask));
+
+    BOOST_REQUIRE(!filtersEngine->IsEventFiltered("madvise", p3, mask));
+    BOOST_REQUIRE(filtersEngine->IsEventFiltered("madvise1", p3, mask));
+}
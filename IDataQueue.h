@@ -0,0 +1,50 @@
+/*
+    microsoft-oms-auditd-plugin
+
+    Copyright (c) Microsoft Corporation
+
+    All rights reserved.
+
+    MIT License
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef AUOMS_IDATAQUEUE_H
+#define AUOMS_IDATAQUEUE_H
+
+#include <cinttypes>
+#include <cstddef>
+
+#include <sys/types.h>
+
+// A single producer, single consumer queue of variable sized data items.
+// The producer calls Allocate() then Commit(), the consumer calls Get() then Release().
+class IDataQueue {
+public:
+    virtual ~IDataQueue() = default;
+
+    // Returns nullptr if the queue is closed.
+    // If data was lost (to make room, or because there was no room) then *loss_bytes is set to the number of bytes lost.
+    virtual uint8_t* Allocate(size_t size, size_t* loss_bytes) = 0;
+    inline uint8_t* Allocate(size_t size) { return Allocate(size, nullptr); }
+
+    virtual void Commit(size_t size) = 0;
+
+    virtual void Close() = 0;
+
+    // Blocks until an item is available.
+    // Returns the size of the item, or -1 if the queue is closed and empty.
+    virtual ssize_t Get(uint8_t** ptr) = 0;
+
+    virtual void Release() = 0;
+
+    virtual bool IsClosed() = 0;
+};
+
+#endif //AUOMS_IDATAQUEUE_H
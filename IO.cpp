@@ -17,7 +17,9 @@
 #include "IO.h"
 #include "Signals.h"
 
+#include <algorithm>
 #include <cassert>
+#include <climits>
 #include <system_error>
 
 extern "C" {
@@ -274,3 +276,48 @@ ssize_t IOBase::WriteAll(const void * buf, size_t size, long timeout, const std:
 
     return OK;
 }
+
+ssize_t IOBase::WriteAllV(struct iovec *iov, int iovcnt, long timeout, const std::function<bool()>& fn)
+{
+    while (iovcnt > 0 && iov->iov_len == 0) {
+        iov++;
+        iovcnt--;
+    }
+    while (iovcnt > 0) {
+        int fd = _fd.load();
+        if (fd < 0 || _wclosed.load()) {
+            return CLOSED;
+        }
+        auto ret = WaitWritable(timeout);
+        if (ret != OK) {
+            return ret;
+        }
+        auto nw = writev(fd, iov, std::min(iovcnt, IOV_MAX));
+        if (nw < 0) {
+            if (errno == EINTR) {
+                if (fn && fn()) {
+                    return INTERRUPTED;
+                }
+            } else if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                return FAILED;
+            }
+        } else if (nw == 0) {
+            // This shouldn't happen, but treat as a EOF if it does in order to avoid infinite loop.
+            return CLOSED;
+        } else {
+            // Skip past the fully written buffers, and adjust the partially written one
+            size_t left = static_cast<size_t>(nw);
+            while (iovcnt > 0 && left >= iov->iov_len) {
+                left -= iov->iov_len;
+                iov++;
+                iovcnt--;
+            }
+            if (iovcnt > 0) {
+                iov->iov_base = reinterpret_cast<char*>(iov->iov_base) + left;
+                iov->iov_len -= left;
+            }
+        }
+    }
+
+    return OK;
+}
@@ -23,6 +23,7 @@
 
 extern "C" {
 #include <unistd.h>
+#include <sys/uio.h>
 }
 
 class IO {
@@ -131,6 +132,13 @@ public:
     ssize_t DiscardAll(size_t size, const std::function<bool()>& fn) override;
     ssize_t WriteAll(const void *buf, size_t size, long timeout, const std::function<bool()>& fn) override;
 
+    /*
+     * Write all the data in iov (using writev).
+     * The iov array is modified to track partial writes.
+     * Return values are the same as WriteAll()
+     */
+    ssize_t WriteAllV(struct iovec *iov, int iovcnt, long timeout, const std::function<bool()>& fn);
+
 protected:
     std::atomic<int> _fd;
     std::atomic<bool> _rclosed;
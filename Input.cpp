@@ -55,17 +55,19 @@ void Input::run() {
                         break;
                 }
             }
-            _buffer->AbandonWrite();
+            _buffer->AbandonWrite(ptr);
             // For CLOSED and INTERRUPTED just stop.
             // INTERRUPTED should only be returned if IsStopping() is true
             on_stopping();
             return;
         }
 
-        if (_buffer->CommitWrite(ret)) {
-            Event event(ptr, ret);
+        // The slot may be reused as soon as it has been handled, so capture the event id before committing it.
+        Event event(ptr, ret);
+        EventId event_id(event.Seconds(), event.Milliseconds(), event.Serial());
 
-            ret = _reader.WriteAck(event, _conn.get());
+        if (_buffer->CommitWrite(ptr, ret)) {
+            ret = _reader.WriteAck(event_id, _conn.get());
             if (ret != IO::OK) {
                 if (!IsStopping()) {
                     switch (ret) {
@@ -17,59 +17,126 @@
 #ifndef AUOMS_INPUTBUFFER_H
 #define AUOMS_INPUTBUFFER_H
 
+#include "Metrics.h"
+
 #include <array>
+#include <vector>
+#include <deque>
+#include <memory>
 #include <mutex>
 #include <condition_variable>
 #include <functional>
+#include <chrono>
 
+/*
+ * A fixed ring of MAX_DATA_SIZE slots shared by all Input threads (writers) and the event processing loop (reader).
+ *
+ * Writers acquire a free slot with BeginWrite(), fill it, then CommitWrite() queues the slot for the reader and
+ * returns immediately. The reader consumes committed slots, in commit order, via HandleData(). A slot is only
+ * returned to the free list after HandleData() has finished with it, so readers of the socket and the event
+ * processing overlap as long as there is a free slot. Writers only block when every slot is in use.
+ *
+ * After Close(), BeginWrite() and CommitWrite() fail, but HandleData() keeps returning committed slots until
+ * the ring is empty, so that data that was already acknowledged to the collector is not lost.
+ */
 class InputBuffer {
 public:
     static constexpr size_t MAX_DATA_SIZE = 256*1024;
+    static constexpr size_t DEFAULT_NUM_SLOTS = 8;
+
+    explicit InputBuffer(size_t num_slots = DEFAULT_NUM_SLOTS): _slots(), _free(), _ready(), _close(false) {
+        if (num_slots < 1) {
+            num_slots = 1;
+        }
+        _slots.reserve(num_slots);
+        _free.reserve(num_slots);
+        for (size_t i = 0; i < num_slots; ++i) {
+            _slots.emplace_back(std::make_unique<std::array<char,MAX_DATA_SIZE>>());
+            _free.emplace_back(num_slots-i-1);
+        }
+    }
+
+    // occupancy_metric is updated with the number of slots in use (committed or being handled) on every commit and release.
+    // stall_metric accumulates the time (in microseconds) writers spent waiting for a free slot.
+    void SetMetrics(const std::shared_ptr<Metric>& occupancy_metric, const std::shared_ptr<Metric>& stall_metric) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _occupancy_metric = occupancy_metric;
+        _stall_metric = stall_metric;
+    }
 
-    InputBuffer(): _data(std::make_unique<std::array<char,MAX_DATA_SIZE>>()), _data_size(0), _has_writer(false), _close(false) {}
+    size_t NumSlots() const {
+        return _slots.size();
+    }
 
     bool BeginWrite(void** data_ptr) {
         std::unique_lock<std::mutex> lock(_mutex);
-        // Wait until there is no writer and buffer is empty
-        _cond.wait(lock, [this]() { return _close || (!_has_writer && _data_size == 0); });
+        long stall_usec = 0;
+        if (!_close && _free.empty()) {
+            auto start = std::chrono::steady_clock::now();
+            // Wait until there is a free slot
+            _cond.wait(lock, [this]() { return _close || !_free.empty(); });
+            stall_usec = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+        }
         if (_close) {
             *data_ptr = nullptr;
             return false;
         }
-        *data_ptr = _data->data();
+        auto idx = _free.back();
+        _free.pop_back();
+        *data_ptr = _slots[idx]->data();
+        auto stall_metric = _stall_metric;
+        lock.unlock();
+        if (stall_usec > 0 && stall_metric) {
+            stall_metric->Update(static_cast<double>(stall_usec));
+        }
         return true;
     }
 
-    bool CommitWrite(size_t size) {
+    // Queue the slot returned by BeginWrite() for the reader. Returns without waiting for the data to be handled.
+    bool CommitWrite(void* data_ptr, size_t size) {
         std::unique_lock<std::mutex> lock(_mutex);
-        _has_writer = false;
-        _data_size = size;
-        _cond.notify_all();
-        // Wait until reader has handled data in buffer
-        _cond.wait(lock, [this]() { return _close || _data_size == 0; });
+        auto idx = slot_index(data_ptr);
         if (_close) {
+            _free.emplace_back(idx);
+            _cond.notify_all();
             return false;
         }
+        _ready.emplace_back(idx, size);
+        auto occupancy = _slots.size() - _free.size();
+        auto occupancy_metric = _occupancy_metric;
+        _cond.notify_all();
+        lock.unlock();
+        if (occupancy_metric) {
+            occupancy_metric->Update(static_cast<double>(occupancy));
+        }
         return true;
     }
 
-    void AbandonWrite() {
+    void AbandonWrite(void* data_ptr) {
         std::unique_lock<std::mutex> lock(_mutex);
-        _has_writer = false;
-        _data_size = 0;
+        _free.emplace_back(slot_index(data_ptr));
         _cond.notify_all();
     }
 
     bool HandleData(const std::function<void(void*,size_t)>& fn) {
         std::unique_lock<std::mutex> lock(_mutex);
-        _cond.wait(lock, [this]() { return _close || _data_size != 0; });
-        if (_data_size > 0) {
-            fn(_data->data(), _data_size);
-            _data_size = 0;
-            _cond.notify_all();
-            return true;
+        _cond.wait(lock, [this]() { return _close || !_ready.empty(); });
+        if (_ready.empty()) {
+            return false;
+        }
+        auto entry = _ready.front();
+        _ready.pop_front();
+        lock.unlock();
+
+        // Release the slot even if fn throws
+        try {
+            fn(_slots[entry.first]->data(), entry.second);
+        } catch (...) {
+            release(entry.first);
+            throw;
         }
-        return false;
+        release(entry.first);
+        return true;
     }
 
     void Close() {
@@ -78,12 +145,35 @@ public:
         _cond.notify_all();
     }
 private:
+    size_t slot_index(void* data_ptr) {
+        for (size_t i = 0; i < _slots.size(); ++i) {
+            if (_slots[i]->data() == data_ptr) {
+                return i;
+            }
+        }
+        throw std::runtime_error("InputBuffer: data_ptr does not belong to this buffer");
+    }
+
+    void release(size_t idx) {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _free.emplace_back(idx);
+        auto occupancy = _slots.size() - _free.size();
+        auto occupancy_metric = _occupancy_metric;
+        _cond.notify_all();
+        lock.unlock();
+        if (occupancy_metric) {
+            occupancy_metric->Update(static_cast<double>(occupancy));
+        }
+    }
+
     std::mutex _mutex;
     std::condition_variable _cond;
-    std::unique_ptr<std::array<char,MAX_DATA_SIZE>> _data;
-    size_t _data_size;
-    bool _has_writer;
+    std::vector<std::unique_ptr<std::array<char,MAX_DATA_SIZE>>> _slots;
+    std::vector<size_t> _free;
+    std::deque<std::pair<size_t, size_t>> _ready;
     bool _close;
+    std::shared_ptr<Metric> _occupancy_metric;
+    std::shared_ptr<Metric> _stall_metric;
 };
 
 
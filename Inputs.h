@@ -29,7 +29,8 @@
 
 class Inputs: public RunBase {
 public:
-    explicit Inputs(const std::string& addr, const std::shared_ptr<OperationalStatus>& op_status): _listener(addr), _buffer(std::make_shared<InputBuffer>()), _op_status(op_status) {}
+    explicit Inputs(const std::string& addr, const std::shared_ptr<OperationalStatus>& op_status, size_t num_buffer_slots = InputBuffer::DEFAULT_NUM_SLOTS)
+        : _listener(addr), _buffer(std::make_shared<InputBuffer>(num_buffer_slots)), _op_status(op_status) {}
 
     bool Initialize();
 
@@ -37,6 +38,10 @@ public:
         return _buffer->HandleData(fn);
     }
 
+    void SetBufferMetrics(const std::shared_ptr<Metric>& occupancy_metric, const std::shared_ptr<Metric>& stall_metric) {
+        _buffer->SetMetrics(occupancy_metric, stall_metric);
+    }
+
 protected:
     void on_stopping() override;
     void on_stop() override;
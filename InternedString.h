@@ -0,0 +1,106 @@
+/*
+    microsoft-oms-auditd-plugin
+
+    Copyright (c) Microsoft Corporation
+
+    All rights reserved.
+
+    MIT License
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef AUOMS_INTERNEDSTRING_H
+#define AUOMS_INTERNEDSTRING_H
+
+#include <string>
+#include <string_view>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+// Immutable reference to a string held by a StringInternPool.
+// Copies share the same string, and a default constructed InternedString is an empty string.
+class InternedString {
+public:
+    InternedString() = default;
+
+    inline const std::string& str() const {
+        static const std::string empty;
+        return _str ? *_str : empty;
+    }
+
+    inline bool empty() const { return !_str || _str->empty(); }
+
+    inline bool operator==(const InternedString& other) const { return str() == other.str(); }
+    inline bool operator!=(const InternedString& other) const { return !(*this == other); }
+
+private:
+    friend class StringInternPool;
+
+    explicit InternedString(std::shared_ptr<const std::string> str): _str(std::move(str)) {}
+
+    std::shared_ptr<const std::string> _str;
+};
+
+struct StringInternPoolStats {
+    size_t num_strings;
+    // Bytes used by the pooled strings
+    size_t pooled_bytes;
+    // Bytes that would be used if every reference held its own copy
+    size_t referenced_bytes;
+};
+
+// Reference counted pool of unique strings.
+// Strings stay in the pool until Purge() is called after the last InternedString referencing them is gone.
+class StringInternPool {
+public:
+    InternedString Intern(std::string_view str) {
+        if (str.empty()) {
+            return InternedString();
+        }
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto itr = _strings.find(str);
+        if (itr != _strings.end()) {
+            return InternedString(itr->second);
+        }
+        auto s = std::make_shared<const std::string>(str);
+        // The key refers to the pooled string, which is never modified or moved
+        _strings.emplace(std::string_view(*s), s);
+        return InternedString(s);
+    }
+
+    // Remove strings that are no longer referenced outside the pool, and return the pool stats
+    StringInternPoolStats Purge() {
+        StringInternPoolStats stats = {0, 0, 0};
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (auto itr = _strings.begin(); itr != _strings.end();) {
+            auto refs = itr->second.use_count() - 1;
+            if (refs <= 0) {
+                itr = _strings.erase(itr);
+                continue;
+            }
+            auto size = sizeof(std::string) + itr->second->capacity();
+            stats.num_strings++;
+            stats.pooled_bytes += size;
+            stats.referenced_bytes += size * refs;
+            ++itr;
+        }
+        return stats;
+    }
+
+    size_t Size() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _strings.size();
+    }
+
+private:
+    std::mutex _mutex;
+    std::unordered_map<std::string_view, std::shared_ptr<const std::string>> _strings;
+};
+
+#endif //AUOMS_INTERNEDSTRING_H
@@ -48,7 +48,7 @@ inline bool field_to_uint(const EventRecordField& field, T& val, int base) {
     return errno == 0;
 }
 
-static StringTable<int> s_fam_table(-1, {
+static constexpr StringTableEntry<int> s_fam_entries[] = {
         {"local",      AF_LOCAL},
         {"inet",       AF_INET},
         {"ax25",       AF_AX25},
@@ -87,7 +87,9 @@ static StringTable<int> s_fam_table(-1, {
         {"alg",        38},
         {"nfc",        39},
         {"vsock",      40},
-});
+};
+
+static constexpr StringTable<s_fam_entries> s_fam_table(-1);
 
 bool InterpretSockaddrField(std::string& out, const EventRecord& record, const EventRecordField& field) {
     // It is assumed that a sockaddr will never exceed 1024 bytes
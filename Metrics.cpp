@@ -43,6 +43,12 @@ std::shared_ptr<Metric> Metrics::AddMetric(MetricType metric_type, const std::st
             case MetricType::METRIC_FROM_TOTAL:
                 metric = std::shared_ptr<Metric>(new MetricFromTotal(namespace_name, name, sample_period, agg_period));
                 break;
+            case MetricType::METRIC_BY_COUNTER:
+                metric = std::shared_ptr<Metric>(new CounterMetric(namespace_name, name, sample_period, agg_period));
+                break;
+            case MetricType::METRIC_HISTOGRAM:
+                metric = std::shared_ptr<Metric>(new HistogramMetric(namespace_name, name, sample_period, agg_period));
+                break;
             default:
                 metric = std::shared_ptr<Metric>(new AccumulatorMetric(namespace_name, name, sample_period, agg_period));
                 break;
@@ -55,8 +61,15 @@ std::shared_ptr<Metric> Metrics::AddMetric(MetricType metric_type, const std::st
 void Metrics::run() {
     Logger::Info("Metrics starting");
 
-    // Check for metrics to send once per minute
-    while(!_sleep(60000)) {
+    // Fold buffered metric values once per second, and check for metrics to send once per minute
+    int ticks = 0;
+    while(!_sleep(1000)) {
+        ticks++;
+        if (ticks < 60) {
+            fold_metrics();
+            continue;
+        }
+        ticks = 0;
         if (!send_metrics()) {
             return;
         }
@@ -66,6 +79,13 @@ void Metrics::run() {
     }
 }
 
+void Metrics::fold_metrics() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (auto& e : _metrics) {
+        e.second->Fold();
+    }
+}
+
 void system_time_sec_msec(const std::chrono::system_clock::time_point st, uint64_t& sec, uint32_t& msec) {
     sec = std::chrono::system_clock::to_time_t(st);
     auto sec_st = std::chrono::system_clock::from_time_t(sec);
@@ -86,6 +106,9 @@ bool Metrics::send_metrics() {
 
     MetricAggregateSnapshot snap;
 
+    // So that values buffered since the last tick are counted in the current sample
+    fold_metrics();
+
     auto rec_type = RecordType::AUOMS_METRIC;
     auto rec_type_name = RecordTypeToName(RecordType::AUOMS_METRIC);
 
@@ -98,6 +121,9 @@ bool Metrics::send_metrics() {
             uint32_t msec = static_cast<uint32_t>(tv.tv_usec) / 1000;
 
             int num_fields = 10;
+            if (snap.has_percentiles) {
+                num_fields += 4;
+            }
 
             if (!_builder->BeginEvent(sec, msec, 0, 1)) {
                 return false;
@@ -139,6 +165,20 @@ bool Metrics::send_metrics() {
             if (!_builder->AddField("Avg", std::to_string(snap.avg), SV_EMPTY, field_type_t::UNCLASSIFIED)) {
                 return false;
             }
+            if (snap.has_percentiles) {
+                if (!_builder->AddField("P50", std::to_string(snap.p50), SV_EMPTY, field_type_t::UNCLASSIFIED)) {
+                    return false;
+                }
+                if (!_builder->AddField("P90", std::to_string(snap.p90), SV_EMPTY, field_type_t::UNCLASSIFIED)) {
+                    return false;
+                }
+                if (!_builder->AddField("P99", std::to_string(snap.p99), SV_EMPTY, field_type_t::UNCLASSIFIED)) {
+                    return false;
+                }
+                if (!_builder->AddField("P999", std::to_string(snap.p999), SV_EMPTY, field_type_t::UNCLASSIFIED)) {
+                    return false;
+                }
+            }
             if (!_builder->EndRecord()) {
                 return false;
             }
@@ -22,6 +22,7 @@
 #include "PriorityQueue.h"
 #include "Logger.h"
 
+#include <array>
 #include <atomic>
 #include <mutex>
 #include <chrono>
@@ -39,6 +40,8 @@ enum class MetricType {
     METRIC_BY_ACCUMULATION,
     METRIC_BY_FILL,
     METRIC_FROM_TOTAL,
+    METRIC_BY_COUNTER,
+    METRIC_HISTOGRAM,
 };
 
 struct MetricAggregateSnapshot {
@@ -51,6 +54,12 @@ struct MetricAggregateSnapshot {
     double min;
     double max;
     double avg;
+    // Only set by HistogramMetric
+    bool has_percentiles;
+    double p50;
+    double p90;
+    double p99;
+    double p999;
 };
 
 class MetricData {
@@ -106,7 +115,11 @@ public:
 
     virtual void Update(double value) = 0;
 
-    bool GetAggregateSnapshot(MetricAggregateSnapshot *snap) {
+    // Move any values buffered outside of _current_data into the current sample slot.
+    // Metrics calls this once per second, before sending metrics, and from FlushLogMetrics() at exit.
+    virtual void Fold() {}
+
+    virtual bool GetAggregateSnapshot(MetricAggregateSnapshot *snap) {
         std::lock_guard<std::mutex> lock(_mutex);
 
         // The side effect of GetCountsIdx is that _current_data is pushed to _data if _current_data has "expired"
@@ -142,6 +155,7 @@ public:
             snap->min = min;
             snap->max = max;
             snap->avg = total;
+            snap->has_percentiles = false;
             return total > 0;
         }
     }
@@ -205,6 +219,183 @@ public:
 
 };
 
+/*
+ * Same result as AccumulatorMetric (for non-negative integer values) but Update() is a single relaxed atomic add
+ * to a counter that is (usually) only used by the calling thread. No lock is taken and the clock is not read.
+ * The counters are folded into the current sample slot by Fold(), so values are attributed to the sample period
+ * in which they are folded rather than the one in which they were added.
+ */
+class CounterMetric: public Metric {
+public:
+    static constexpr size_t NUM_STRIPES = 16;
+
+    CounterMetric(const std::string& namespace_name, const std::string& name, MetricPeriod sample_period, MetricPeriod agg_period):
+            Metric(namespace_name, name, sample_period, agg_period), _stripes() {}
+
+    void Update(double value) override {
+        _stripes[stripe_index()]._value.fetch_add(static_cast<uint64_t>(value), std::memory_order_relaxed);
+    }
+
+    void Fold() override {
+        uint64_t total = 0;
+        for (auto& stripe : _stripes) {
+            total += stripe._value.exchange(0, std::memory_order_relaxed);
+        }
+        if (total > 0) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            auto idx = GetCountsIdx();
+            _current_data->Add(idx, static_cast<double>(total));
+        }
+    }
+
+private:
+    struct alignas(64) Stripe {
+        std::atomic<uint64_t> _value{0};
+    };
+
+    // Each thread is assigned a stripe, round robin, the first time it updates any CounterMetric
+    static inline size_t stripe_index() {
+        static std::atomic<size_t> next_index(0);
+        thread_local size_t index = next_index.fetch_add(1, std::memory_order_relaxed) % NUM_STRIPES;
+        return index;
+    }
+
+    std::array<Stripe, NUM_STRIPES> _stripes;
+};
+
+/*
+ * Records the distribution of the update values (e.g. latencies in microseconds) over each aggregation period.
+ * Values are counted in log-linear buckets: exact below 16, and 16 buckets per power of two above that
+ * (so percentiles are accurate to within ~6%). Update() is lock-free (relaxed atomic adds).
+ *
+ * Unlike the other metric types, the snapshot min/max/avg are of the individual values, NumSamples is the number
+ * of values recorded, and p50/p90/p99/p999 are included.
+ */
+class HistogramMetric: public Metric {
+public:
+    static constexpr int SUB_BUCKET_BITS = 4;
+    static constexpr uint64_t SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+    static constexpr size_t NUM_BUCKETS = SUB_BUCKETS + (64-SUB_BUCKET_BITS)*SUB_BUCKETS;
+
+    HistogramMetric(const std::string& namespace_name, const std::string& name, MetricPeriod sample_period, MetricPeriod agg_period):
+            Metric(namespace_name, name, sample_period, agg_period), _buckets(), _sum(0), _min(UINT64_MAX), _max(0) {}
+
+    void Update(double value) override {
+        uint64_t v = value > 0 ? static_cast<uint64_t>(value) : 0;
+        _buckets[BucketIndex(v)].fetch_add(1, std::memory_order_relaxed);
+        _sum.fetch_add(v, std::memory_order_relaxed);
+        auto min = _min.load(std::memory_order_relaxed);
+        while (v < min && !_min.compare_exchange_weak(min, v, std::memory_order_relaxed)) {}
+        auto max = _max.load(std::memory_order_relaxed);
+        while (v > max && !_max.compare_exchange_weak(max, v, std::memory_order_relaxed)) {}
+    }
+
+    void Fold() override {
+        std::lock_guard<std::mutex> lock(_mutex);
+        check_period();
+    }
+
+    bool GetAggregateSnapshot(MetricAggregateSnapshot *snap) override {
+        std::lock_guard<std::mutex> lock(_mutex);
+        check_period();
+        while (!_snapshots.empty()) {
+            *snap = _snapshots.front();
+            _snapshots.pop_front();
+            if (snap->num_samples > 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static inline size_t BucketIndex(uint64_t v) {
+        if (v < SUB_BUCKETS) {
+            return v;
+        }
+        int e = 63 - __builtin_clzll(v); // e >= SUB_BUCKET_BITS
+        int shift = e - SUB_BUCKET_BITS;
+        return SUB_BUCKETS + shift*SUB_BUCKETS + ((v >> shift) & (SUB_BUCKETS-1));
+    }
+
+    // The largest value that maps to the bucket
+    static inline uint64_t BucketUpperBound(size_t idx) {
+        if (idx < SUB_BUCKETS) {
+            return idx;
+        }
+        auto shift = (idx - SUB_BUCKETS) / SUB_BUCKETS;
+        auto m = (idx - SUB_BUCKETS) % SUB_BUCKETS;
+        return (((SUB_BUCKETS + m + 1) << shift) - 1);
+    }
+
+private:
+    // If the current aggregation period has ended, move the counts into a snapshot.
+    void check_period() {
+        auto now = std::chrono::steady_clock::now();
+        if (now - _agg_start_steady < _agg_period_size) {
+            return;
+        }
+
+        MetricAggregateSnapshot snap;
+        snap.namespace_name = _nsname;
+        snap.name = _name;
+        snap.start_time = _agg_start_time;
+        snap.end_time = _agg_start_time + _agg_period_size;
+        snap.sample_period = static_cast<uint64_t>(_sample_period);
+
+        std::array<uint64_t, NUM_BUCKETS> counts;
+        uint64_t count = 0;
+        for (size_t i = 0; i < NUM_BUCKETS; ++i) {
+            counts[i] = _buckets[i].exchange(0, std::memory_order_relaxed);
+            count += counts[i];
+        }
+        auto sum = _sum.exchange(0, std::memory_order_relaxed);
+        auto min = _min.exchange(UINT64_MAX, std::memory_order_relaxed);
+        auto max = _max.exchange(0, std::memory_order_relaxed);
+
+        snap.num_samples = count;
+        snap.has_percentiles = true;
+        if (count > 0) {
+            snap.min = static_cast<double>(min);
+            snap.max = static_cast<double>(max);
+            snap.avg = static_cast<double>(sum)/static_cast<double>(count);
+            snap.p50 = percentile(counts, count, 0.5, max);
+            snap.p90 = percentile(counts, count, 0.9, max);
+            snap.p99 = percentile(counts, count, 0.99, max);
+            snap.p999 = percentile(counts, count, 0.999, max);
+        } else {
+            snap.min = snap.max = snap.avg = 0;
+            snap.p50 = snap.p90 = snap.p99 = snap.p999 = 0;
+        }
+        _snapshots.emplace_back(snap);
+
+        auto nagg = (now - _agg_start_steady) / _agg_period_size;
+        auto inc = _agg_period_size * nagg;
+        _agg_start_time += std::chrono::duration_cast<std::chrono::system_clock::time_point::duration>(inc);
+        _agg_start_steady += std::chrono::duration_cast<std::chrono::steady_clock::time_point::duration>(inc);
+    }
+
+    static double percentile(const std::array<uint64_t, NUM_BUCKETS>& counts, uint64_t count, double pct, uint64_t max) {
+        auto target = static_cast<uint64_t>(std::ceil(pct * static_cast<double>(count)));
+        if (target < 1) {
+            target = 1;
+        }
+        uint64_t seen = 0;
+        for (size_t i = 0; i < NUM_BUCKETS; ++i) {
+            seen += counts[i];
+            if (seen >= target) {
+                return static_cast<double>(std::min(BucketUpperBound(i), max));
+            }
+        }
+        return static_cast<double>(max);
+    }
+
+    std::array<std::atomic<uint64_t>, NUM_BUCKETS> _buckets;
+    std::atomic<uint64_t> _sum;
+    std::atomic<uint64_t> _min;
+    std::atomic<uint64_t> _max;
+    std::list<MetricAggregateSnapshot> _snapshots;
+};
+
 /*
  * Some system metrics (e.g. /proc/self/io) only increase for the live of the process
  * Each update calculates the value delta and the value/sample_period.
@@ -253,11 +444,15 @@ public:
 
     std::shared_ptr<Metric> AddMetric(MetricType metric_type, const std::string& namespace_name, const std::string& name, MetricPeriod sample_period, MetricPeriod agg_period);
 
-    void FlushLogMetrics() { send_log_metrics(true); }
+    void FlushLogMetrics() {
+        fold_metrics();
+        send_log_metrics(true);
+    }
 protected:
     void run() override;
 
 private:
+    void fold_metrics();
     bool send_metrics();
     bool send_log_metrics(bool flush_all);
 
@@ -30,6 +30,36 @@
 #define SOL_NETLINK	270
 #endif
 
+void Netlink::SetBatchMode(size_t max_batch, batch_fn_t&& batch_fn) {
+    std::lock_guard<std::mutex> _lock(_run_mutex);
+
+    if (max_batch < 1) {
+        max_batch = 1;
+    }
+    _max_batch = max_batch;
+    _batch_fn = std::move(batch_fn);
+
+    if (_max_batch > 1) {
+        _batch_data.resize(_max_batch * _data.size());
+        _batch_addrs.resize(_max_batch);
+        _batch_iovs.resize(_max_batch);
+        _batch_msgs.resize(_max_batch);
+        for (size_t i = 0; i < _max_batch; ++i) {
+            _batch_iovs[i].iov_base = _batch_data.data() + (i * _data.size());
+            _batch_iovs[i].iov_len = _data.size();
+            ::memset(&_batch_msgs[i], 0, sizeof(mmsghdr));
+            _batch_msgs[i].msg_hdr.msg_name = &_batch_addrs[i];
+            _batch_msgs[i].msg_hdr.msg_iov = &_batch_iovs[i];
+            _batch_msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+    } else {
+        _batch_data.clear();
+        _batch_addrs.clear();
+        _batch_iovs.clear();
+        _batch_msgs.clear();
+    }
+}
+
 int Netlink::Open(reply_fn_t&& default_msg_handler_fn, bool multicast) {
     std::unique_lock<std::mutex> _lock(_run_mutex);
 
@@ -336,6 +366,44 @@ void Netlink::run() {
             last_flush = std::chrono::steady_clock::now();
         }
 
+        if (_max_batch > 1) {
+            for (auto& msg : _batch_msgs) {
+                msg.msg_hdr.msg_namelen = sizeof(sockaddr_nl);
+                msg.msg_len = 0;
+            }
+            int num;
+            do {
+                // Block until at least one message is available, then return whatever else is queued (up to _max_batch)
+                num = recvmmsg(fd, _batch_msgs.data(), _batch_msgs.size(), MSG_WAITFORONE, nullptr);
+            } while (num < 0 && errno == EINTR && !IsStopping());
+
+            if (IsStopping()) {
+                return;
+            }
+
+            if (num < 0) {
+                if (errno == ENOSYS) {
+                    Logger::Warn("Netlink: recvmmsg() is not supported by the kernel, falling back to recvfrom()");
+                    _max_batch = 1;
+                    continue;
+                }
+                Logger::Error("Error receiving packets from AUDIT NETLINK socket: (%d) %s", errno, std::strerror((errno)));
+                return;
+            }
+
+            if (_batch_fn) {
+                _batch_fn(num);
+            }
+
+            for (int i = 0; i < num; ++i) {
+                auto& msg = _batch_msgs[i];
+                if (!handle_packet(reinterpret_cast<uint8_t*>(msg.msg_hdr.msg_iov->iov_base), static_cast<int>(msg.msg_len), _batch_addrs[i], msg.msg_hdr.msg_namelen)) {
+                    return;
+                }
+            }
+            continue;
+        }
+
         sockaddr_nl nladdr;
         socklen_t nladdrlen = sizeof(nladdr);
         int len;
@@ -352,29 +420,41 @@ void Netlink::run() {
             return;
         }
 
-        if (nladdrlen != sizeof(nladdr)) {
-            Logger::Error("Error receiving packet from AUDIT NETLINK socket: Bad address size");
-            return;
+        if (_batch_fn) {
+            _batch_fn(1);
         }
 
-        if (nladdr.nl_pid) {
-            Logger::Error("Received AUDIT NETLINK packet from non-kernel source: pid == %d", nladdr.nl_pid);
-            continue;
+        if (!handle_packet(_data.data(), len, nladdr, nladdrlen)) {
+            return;
         }
+    }
+
+    flush_replies(true);
+}
 
-        auto nl = reinterpret_cast<nlmsghdr*>(_data.data());
+// Returns false if the packet indicates the connection is no longer usable
+bool Netlink::handle_packet(const uint8_t* data, int len, const sockaddr_nl& nladdr, socklen_t nladdrlen) {
+    if (nladdrlen != sizeof(nladdr)) {
+        Logger::Error("Error receiving packet from AUDIT NETLINK socket: Bad address size");
+        return false;
+    }
 
-        if (!NLMSG_OK(nl, len)) {
-            Logger::Error("Received invalid AUDIT NETLINK packet: Type %d, Flags %X, Seq %d", nl->nlmsg_type, nl->nlmsg_flags, nl->nlmsg_seq);
-            continue;
-        }
+    if (nladdr.nl_pid) {
+        Logger::Error("Received AUDIT NETLINK packet from non-kernel source: pid == %d", nladdr.nl_pid);
+        return true;
+    }
 
-        size_t payload_len = len - static_cast<size_t>(reinterpret_cast<char*>(NLMSG_DATA(nl)) - reinterpret_cast<char*>(_data.data()));
+    auto nl = reinterpret_cast<const nlmsghdr*>(data);
 
-        handle_msg(nl->nlmsg_type, nl->nlmsg_flags, nl->nlmsg_seq, NLMSG_DATA(nl), payload_len);
+    if (!NLMSG_OK(nl, len)) {
+        Logger::Error("Received invalid AUDIT NETLINK packet: Type %d, Flags %X, Seq %d", nl->nlmsg_type, nl->nlmsg_flags, nl->nlmsg_seq);
+        return true;
     }
 
-    flush_replies(true);
+    size_t payload_len = len - static_cast<size_t>(reinterpret_cast<const char*>(NLMSG_DATA(nl)) - reinterpret_cast<const char*>(data));
+
+    handle_msg(nl->nlmsg_type, nl->nlmsg_flags, nl->nlmsg_seq, NLMSG_DATA(nl), payload_len);
+    return true;
 }
 
 void Netlink::handle_msg(uint16_t msg_type, uint16_t msg_flags, uint32_t msg_seq, const void* payload_data, size_t payload_len) {
@@ -19,6 +19,9 @@
 
 #include <functional>
 #include <future>
+#include <vector>
+
+#include <sys/socket.h>
 
 #include <linux/netlink.h>
 #include <linux/audit.h>
@@ -30,11 +33,20 @@ class ReplyRec;
 class Netlink: private RunBase {
 public:
     typedef std::function<bool(uint16_t type, uint16_t flags, const void* data, size_t len)> reply_fn_t;
+    typedef std::function<void(size_t num_msgs)> batch_fn_t;
 
-    Netlink(): _fd(-1), _sequence(1), _default_msg_handler_fn(), _quite(false), _known_seq(), _replies(), _data() {}
+    Netlink(): _fd(-1), _sequence(1), _default_msg_handler_fn(), _quite(false), _known_seq(), _replies(), _data(), _max_batch(1), _batch_fn() {}
 
     void SetQuite() { _quite = true; }
 
+    /*
+     * Must be called before Open().
+     * If max_batch > 1, up to max_batch messages are received per syscall (via recvmmsg).
+     * If batch_fn is set, it is called with the number of messages received after each batch is received
+     * (before the messages are passed to the handlers).
+     */
+    void SetBatchMode(size_t max_batch, batch_fn_t&& batch_fn);
+
     /*
      * Methods return 0 on success and < 0 on failure.
      * If the Netlink is closed prior to call, then will return -ENOTCONN
@@ -99,6 +111,7 @@ private:
     };
 
     void flush_replies(bool is_exit);
+    bool handle_packet(const uint8_t* data, int len, const sockaddr_nl& nladdr, socklen_t nladdrlen);
     void handle_msg(uint16_t msg_type, uint16_t msg_flags, uint32_t msg_seq, const void* payload_data, size_t payload_len);
 
     int _fd;
@@ -109,6 +122,12 @@ private:
     std::unordered_map<uint32_t, std::chrono::steady_clock::time_point> _known_seq;
     std::unordered_map<uint32_t, std::shared_ptr<ReplyRec>> _replies;
     std::array<uint8_t, 16*1024> _data;
+    size_t _max_batch;
+    batch_fn_t _batch_fn;
+    std::vector<uint8_t> _batch_data;
+    std::vector<sockaddr_nl> _batch_addrs;
+    std::vector<iovec> _batch_iovs;
+    std::vector<mmsghdr> _batch_msgs;
 };
 
 int NetlinkRetry(const std::function<int()>& fn);
@@ -193,6 +193,58 @@ bool Output::Load(std::unique_ptr<Config>& config) {
         }
     }
 
+    _batch_mode = false;
+    if (_config->HasKey("enable_batch_mode")) {
+        try {
+            _batch_mode = _config->GetBool("enable_batch_mode");
+        } catch (std::exception) {
+            Logger::Error("Output(%s): Invalid enable_batch_mode parameter value", _name.c_str());
+            return false;
+        }
+    }
+
+    if (_batch_mode) {
+        _batch_max_bytes = DEFAULT_BATCH_MAX_BYTES;
+        if (_config->HasKey("batch_max_bytes")) {
+            try {
+                _batch_max_bytes = _config->GetUint64("batch_max_bytes");
+            } catch (std::exception) {
+                Logger::Error("Output(%s): Invalid batch_max_bytes parameter value", _name.c_str());
+                return false;
+            }
+        }
+        if (_batch_max_bytes == 0) {
+            Logger::Warn("Output(%s): batch_max_bytes parameter value to small (0), using (%ld)", _name.c_str(), DEFAULT_BATCH_MAX_BYTES);
+            _batch_max_bytes = DEFAULT_BATCH_MAX_BYTES;
+        }
+
+        _batch_max_latency = DEFAULT_BATCH_MAX_LATENCY;
+        if (_config->HasKey("batch_max_latency")) {
+            try {
+                _batch_max_latency = _config->GetInt64("batch_max_latency");
+            } catch (std::exception) {
+                Logger::Error("Output(%s): Invalid batch_max_latency parameter value", _name.c_str());
+                return false;
+            }
+        }
+        if (_batch_max_latency < 0) {
+            _batch_max_latency = 0;
+        }
+    }
+
+    _aggregation_checkpoint_interval = DEFAULT_AGGREGATION_CHECKPOINT_INTERVAL;
+    if (_config->HasKey("aggregation_checkpoint_interval")) {
+        try {
+            _aggregation_checkpoint_interval = _config->GetInt64("aggregation_checkpoint_interval");
+        } catch (std::exception) {
+            Logger::Error("Output(%s): Invalid aggregation_checkpoint_interval parameter value", _name.c_str());
+            return false;
+        }
+    }
+    if (_aggregation_checkpoint_interval < 0) {
+        _aggregation_checkpoint_interval = 0;
+    }
+
     return true;
 }
 
@@ -241,6 +293,7 @@ ssize_t Output::send_event(const Event& event) {
     if (_ack_mode) {
         _ack_reader->AddPendingAck(id);
     }
+    auto start = std::chrono::steady_clock::now();
     auto ret = _event_writer->WriteEvent(event, _writer.get());
     switch (ret) {
     case IEventWriter::NOOP:
@@ -253,6 +306,7 @@ ssize_t Output::send_event(const Event& event) {
                 return IO::TIMEOUT;
             }
         }
+        update_write_latency(start);
         return IWriter::OK;
     default:
          _ack_reader->RemoveAck(id);
@@ -261,23 +315,118 @@ ssize_t Output::send_event(const Event& event) {
 }
 
 // Return true of the write succeeded
-bool Output::handle_queue_event(const Event& event, uint32_t priority, uint64_t sequence) {
-    auto ret = send_event(event);
-    if (ret != IWriter::OK) {
+bool Output::handle_queue_event(const Event& event) {
+    return send_event(event) == IWriter::OK;
+}
+
+bool Output::batch_event(const Event& event) {
+    EventId id(event.Seconds(), event.Milliseconds(), event.Serial());
+    if (_ack_mode) {
+        // AckReader tracks acks by EventId, so only one event with a given id can be pending at a time.
+        if (_batch_ack_id_set.count(id) > 0 && !flush_batch()) {
+            return false;
+        }
+        _ack_reader->AddPendingAck(id);
+    }
+    auto ret = _event_writer->WriteEvent(event, &_batch_writer);
+    switch (ret) {
+    case IEventWriter::NOOP:
+        _ack_reader->RemoveAck(id);
+        return true;
+    case IWriter::OK:
+        if (_ack_mode) {
+            _batch_ack_ids.emplace_back(id);
+            _batch_ack_id_set.emplace(id);
+        }
+        return true;
+    default:
+        _ack_reader->RemoveAck(id);
         return false;
     }
+}
 
-    _queue->Commit(_cursor_handle, priority, sequence);
+bool Output::flush_batch() {
+    if (!_batch_writer.Empty()) {
+        auto start = std::chrono::steady_clock::now();
+        auto ret = _batch_writer.Flush(_writer.get(), -1, nullptr);
+        if (ret != IWriter::OK) {
+            clear_batch();
+            return false;
+        }
+        if (_ack_mode) {
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(_ack_timeout);
+            for (auto& id : _batch_ack_ids) {
+                auto timeout = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+                if (!_ack_reader->WaitForAck(id, std::max(timeout, static_cast<decltype(timeout)>(0)))) {
+                    Logger::Warn("Output(%s): Timeout waiting for ack", _name.c_str());
+                    clear_batch();
+                    return false;
+                }
+            }
+        }
+        update_write_latency(start);
+    }
 
+    if (!_batch_items.empty()) {
+        _queue->Commit(_cursor_handle, _batch_items, _batch_items.size());
+    }
+    clear_batch();
     return true;
 }
 
+void Output::update_write_latency(const std::chrono::steady_clock::time_point& start) {
+    if (_write_latency_metric) {
+        _write_latency_metric->Update(static_cast<double>(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count()));
+    }
+}
+
+void Output::clear_batch() {
+    for (auto& id : _batch_ack_ids) {
+        _ack_reader->RemoveAck(id);
+    }
+    _batch_writer.Clear();
+    _batch_items.clear();
+    _batch_ack_ids.clear();
+    _batch_ack_id_set.clear();
+}
+
 // Return <err,false> of the write failed
 std::pair<int64_t, bool> Output::handle_agg_event(const Event& event) {
     auto ret = send_event(event);
     return std::make_pair(static_cast<int64_t>(ret), ret == IWriter::OK);
 }
 
+bool Output::checkpoint_aggregation_state(bool force) {
+    if (_aggregation_checkpoint_interval == 0 || _save_file.empty()) {
+        return false;
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    if (!force && now - _aggregation_last_checkpoint < std::chrono::seconds(_aggregation_checkpoint_interval)) {
+        return true;
+    }
+    _aggregation_last_checkpoint = now;
+
+    try {
+        _event_aggregator->Checkpoint(_save_file);
+    } catch (const std::exception& ex) {
+        Logger::Error("Output(%s): Failed to checkpoint event aggregation state to '%s': %s", _name.c_str(), _save_file.c_str(), ex.what());
+        return false;
+    }
+    return true;
+}
+
+void Output::remove_aggregation_state() {
+    if (_save_file.empty()) {
+        return;
+    }
+    for (auto& path : {_save_file, EventAggregator::CheckpointLogPath(_save_file)}) {
+        if (PathExists(path) && unlink(path.c_str()) != 0) {
+            Logger::Error("Output(%s): Failed to remove aggregation state file '%s': %s", _name.c_str(), path.c_str(), std::strerror(errno));
+        }
+    }
+}
+
 bool Output::handle_events(bool checkOpen) {
     _queue->Rollback(_cursor_handle);
 
@@ -303,27 +452,69 @@ bool Output::handle_events(bool checkOpen) {
             }
         }
 
-        std::pair<std::shared_ptr<QueueItem>,bool> get_ret;
-        get_ret = _queue->Get(_cursor_handle, 100, !_ack_mode);
+        long timeout = 100;
+        if (_batch_mode && !_batch_items.empty()) {
+            auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - _batch_start).count();
+            timeout = std::max(0L, std::min(timeout, _batch_max_latency - static_cast<long>(elapsed)));
+        }
+
+        _queue->GetMany(_cursor_handle, _batch, GET_BATCH_MAX_ITEMS, GET_BATCH_MAX_BYTES, timeout, false);
 
-        if(get_ret.first) {
-            Event event(get_ret.first->Data(), get_ret.first->Size());
+        // Items are committed once per batch, up to (but not including) the first item that failed to write.
+        // In batch mode, items are instead committed by flush_batch().
+        size_t num_handled = 0;
+        bool write_failed = false;
+        for (auto& item : _batch) {
+            Event event(item->Data(), item->Size());
             bool filtered = _event_filter && _event_filter->IsEventFiltered(event);
-            if (!filtered) {
-                if (_event_aggregator) {
-                    if (_event_aggregator->AddEvent(event)) {
-                        // The event was consumed
-                        continue;
-                    }
-                }
-                if (!handle_queue_event(event, get_ret.first->Priority(), get_ret.first->Sequence())) {
+            // If the event is consumed by the aggregator then it is handled
+            if (!filtered && !(_event_aggregator && _event_aggregator->AddEvent(event))) {
+                if (!(_batch_mode ? batch_event(event) : handle_queue_event(event))) {
                     // The write failed, so assume the connection is bad
+                    write_failed = true;
+                    break;
+                }
+            }
+            if (_batch_mode) {
+                if (_batch_items.empty()) {
+                    _batch_start = std::chrono::steady_clock::now();
+                }
+                _batch_items.emplace_back(item);
+                if (_batch_writer.Size() >= _batch_max_bytes && !flush_batch()) {
+                    write_failed = true;
+                    break;
+                }
+            } else {
+                num_handled++;
+            }
+        }
+
+        if (num_handled > 0) {
+            _queue->Commit(_cursor_handle, _batch, num_handled);
+        }
+        _batch.clear();
+
+        if (_event_aggregator) {
+            checkpoint_aggregation_state(false);
+        }
+
+        if (write_failed) {
+            break;
+        }
+
+        // Flush if the batch is too old, or if it only contains items that did not produce any output
+        if (_batch_mode && !_batch_items.empty()) {
+            if (_batch_writer.Empty() || std::chrono::steady_clock::now() - _batch_start >= std::chrono::milliseconds(_batch_max_latency)) {
+                if (!flush_batch()) {
                     break;
                 }
             }
         }
     }
 
+    // Any un-flushed items were not committed and will be re-sent after the Rollback() on the next call.
+    clear_batch();
+
     // writer must be closed before calling _ack_reader->Stop(), or the stop may hang until the connection is closed remotely.
     _writer->Close();
 
@@ -377,7 +568,8 @@ void Output::run() {
     if (_aggregation_rules.size() > 0) {
         _event_aggregator = std::make_shared<EventAggregator>();
         if (!_save_file.empty() && PathExists(_save_file)) {
-            if (!IsOnlyRootWritable(_save_file)) {
+            auto log_file = EventAggregator::CheckpointLogPath(_save_file);
+            if (!IsOnlyRootWritable(_save_file) || (PathExists(log_file) && !IsOnlyRootWritable(log_file))) {
                 Logger::Error("Output(%s): Event aggregation state file is non-root writable '%s': It will ignored and removed", _name.c_str(), _save_file.c_str());
                 _event_aggregator = std::make_shared<EventAggregator>();
             } else {
@@ -388,9 +580,6 @@ void Output::run() {
                     _event_aggregator = std::make_shared<EventAggregator>();
                 }
             }
-            if (unlink(_save_file.c_str()) != 0) {
-                Logger::Error("Output(%s): Failed to remove aggregation state file '%s': %s", _name.c_str(), _save_file.c_str(), std::strerror(errno));
-            }
         }
         try {
             _event_aggregator->SetRules(_aggregation_rules);
@@ -398,12 +587,11 @@ void Output::run() {
             Logger::Error("Output(%s): Failed to set event aggregation rules: %s", _name.c_str(), ex.what());
             _event_aggregator.reset();
         }
-    } else {
-        if (!_save_file.empty() && PathExists(_save_file)) {
-            if (unlink(_save_file.c_str()) != 0) {
-                Logger::Error("Output(%s): Failed to remove aggregation state file '%s': %s", _name.c_str(), _save_file.c_str(), std::strerror(errno));
-            }
-        }
+    }
+
+    // The loaded state must not be loaded again (after a crash), so replace it with the current state, or remove it.
+    if (!_event_aggregator || !checkpoint_aggregation_state(true)) {
+        remove_aggregation_state();
     }
 
     _cursor_handle = _queue->OpenCursor(_name);
@@ -25,11 +25,15 @@
 #include "IO.h"
 #include "IEventFilter.h"
 #include "EventAggregator.h"
+#include "BatchWriter.h"
+#include "Metrics.h"
 
 #include <string>
+#include <chrono>
 #include <mutex>
 #include <memory>
 #include <vector>
+#include <unordered_set>
 
 /****************************************************************************
  *
@@ -99,9 +103,16 @@ public:
     static constexpr int DEFAULT_ACK_QUEUE_SIZE = 1000;
     static constexpr long MIN_ACK_TIMEOUT = 100;
     static constexpr long DEFAULT_ACK_TIMEOUT = 300*1000; // 5 minutes
+    static constexpr size_t GET_BATCH_MAX_ITEMS = 256;
+    static constexpr size_t GET_BATCH_MAX_BYTES = 1024*1024;
+    static constexpr size_t DEFAULT_BATCH_MAX_BYTES = 256*1024;
+    static constexpr long DEFAULT_BATCH_MAX_LATENCY = 100;
+    static constexpr long DEFAULT_AGGREGATION_CHECKPOINT_INTERVAL = 10; // seconds
 
     Output(const std::string& name, const std::string& save_dir, const std::shared_ptr<PriorityQueue>& queue, const std::shared_ptr<IEventWriterFactory>& writer_factory, const std::shared_ptr<IEventFilterFactory>& filter_factory):
-            _name(name), _save_dir(save_dir), _queue(queue), _writer_factory(writer_factory), _filter_factory(filter_factory), _ack_mode(false), _ack_timeout(DEFAULT_ACK_TIMEOUT)
+            _name(name), _save_dir(save_dir), _queue(queue), _writer_factory(writer_factory), _filter_factory(filter_factory), _ack_mode(false), _ack_timeout(DEFAULT_ACK_TIMEOUT),
+            _batch_mode(false), _batch_max_bytes(DEFAULT_BATCH_MAX_BYTES), _batch_max_latency(DEFAULT_BATCH_MAX_LATENCY),
+            _aggregation_checkpoint_interval(DEFAULT_AGGREGATION_CHECKPOINT_INTERVAL)
     {
         _ack_reader = std::unique_ptr<AckReader>(new AckReader(name));
         _save_file = _save_dir + "/" + name + ".aggsavefile";
@@ -115,6 +126,10 @@ public:
     // Delete any resources associated with the output
     void Delete();
 
+    // The metric is updated with the time (in microseconds) taken to write (and, in ack mode, get acks for)
+    // each event, or each batch in batch mode.
+    void SetWriteLatencyMetric(const std::shared_ptr<Metric>& metric) { _write_latency_metric = metric; }
+
 protected:
     friend class AckReader;
 
@@ -126,9 +141,30 @@ protected:
     bool check_open();
 
     ssize_t send_event(const Event& event);
-    bool handle_queue_event(const Event& event, uint32_t priority, uint64_t sequence);
+    bool handle_queue_event(const Event& event);
+
+    /*
+     * Batch mode: events are formatted into _batch_writer and sent with a single writev by flush_batch()
+     * once batch_max_bytes are pending or the oldest pending item is batch_max_latency ms old.
+     * Queue items are only committed after the flush succeeds (and, in ack mode, all acks are received).
+     */
+    // Return false if the event could not be added to the batch
+    bool batch_event(const Event& event);
+    // Return false if the write failed or an ack was not received
+    bool flush_batch();
+    void clear_batch();
+    void update_write_latency(const std::chrono::steady_clock::time_point& start);
     std::pair<int64_t, bool> handle_agg_event(const Event& event);
 
+    /*
+     * Unless aggregation_checkpoint_interval is 0, the event aggregation state is checkpointed to _save_file
+     * (see EventAggregator::Checkpoint()) every aggregation_checkpoint_interval seconds, so that at most that
+     * many seconds of aggregation state are lost if auoms crashes.
+     */
+    // Return false if the checkpoint failed, or checkpoints are disabled
+    bool checkpoint_aggregation_state(bool force);
+    void remove_aggregation_state();
+
     // Return true if writer closed and Output should reconnect, false if Output should stop.
     bool handle_events(bool checkOpen=true);
 
@@ -142,6 +178,11 @@ protected:
     std::shared_ptr<IEventFilterFactory> _filter_factory;
     bool _ack_mode;
     uint64_t _ack_timeout;
+    bool _batch_mode;
+    size_t _batch_max_bytes;
+    long _batch_max_latency;
+    long _aggregation_checkpoint_interval;
+    std::chrono::steady_clock::time_point _aggregation_last_checkpoint;
     std::unique_ptr<Config> _config;
     std::shared_ptr<QueueCursorHandle> _cursor_handle;
     std::shared_ptr<IEventWriter> _event_writer;
@@ -150,6 +191,13 @@ protected:
     std::vector<std::shared_ptr<AggregationRule>> _aggregation_rules;
     std::shared_ptr<EventAggregator> _event_aggregator;
     std::unique_ptr<AckReader> _ack_reader;
+    std::vector<std::shared_ptr<QueueItem>> _batch;
+    BatchWriter _batch_writer;
+    std::vector<std::shared_ptr<QueueItem>> _batch_items;
+    std::vector<EventId> _batch_ack_ids;
+    std::unordered_set<EventId> _batch_ack_id_set;
+    std::chrono::steady_clock::time_point _batch_start;
+    std::shared_ptr<Metric> _write_latency_metric;
 };
 
 
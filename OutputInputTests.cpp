@@ -605,3 +605,170 @@ BOOST_AUTO_TEST_CASE( oversized_event_test ) {
         BOOST_FAIL("Expected 3 'header it too large' messages");
     }
 }
+
+BOOST_AUTO_TEST_CASE( batch_mode_test ) {
+    TempDir dir("/tmp/OutputInputTests");
+
+    std::string socket_path = dir.Path() + "/input.socket";
+    std::string status_socket_path = dir.Path() + "/status.socket";
+
+    std::mutex log_mutex;
+    std::vector<std::string> log_lines;
+    Logger::SetLogFunction([&log_mutex,&log_lines](const char* ptr, size_t size){
+        std::lock_guard<std::mutex> lock(log_mutex);
+        log_lines.emplace_back(ptr, size);
+    });
+
+    Signals::Init();
+    Signals::Start();
+
+    auto queue = PriorityQueue::Open(dir.Path(), 8, 4*1024,8, 0, 100, 0);
+    auto event_queue = std::make_shared<EventQueue>(queue);
+    auto builder = std::make_shared<EventBuilder>(event_queue, DefaultPrioritizer::Create(0));
+
+    auto output_config = std::make_unique<Config>(std::unordered_map<std::string, std::string>({
+        {"output_format","raw"},
+        {"output_socket", socket_path},
+        {"enable_ack_mode", "true"},
+        {"ack_queue_size", "10"},
+        {"ack_timeout", "1000"},
+        {"enable_batch_mode", "true"},
+        {"batch_max_bytes", "1024"},
+        {"batch_max_latency", "10"}
+    }));
+    auto writer_factory = std::shared_ptr<IEventWriterFactory>(static_cast<IEventWriterFactory*>(new RawOnlyEventWriterFactory()));
+    Output output("output", "", queue, writer_factory, nullptr);
+    output.Load(output_config);
+
+    auto operational_status = std::make_shared<OperationalStatus>("", nullptr);
+
+    Inputs inputs(socket_path, operational_status);
+    if (!inputs.Initialize()) {
+        BOOST_FAIL("Failed to initialize inputs");
+    }
+
+    Gate start_gate;
+    Gate done_gate;
+    std::vector<std::string> _outputs;
+
+    constexpr int num_events = 100;
+
+    std::thread input_thread([&]() {
+        Signals::InitThread();
+        start_gate.Wait(Gate::OPEN, -1);
+        int num_received = 0;
+        while (num_received < num_events) {
+            if (!inputs.HandleData([&num_received,&_outputs](void* ptr, size_t size) {
+                _outputs.emplace_back(reinterpret_cast<char*>(ptr), size);
+                num_received += 1;
+            })) {
+                break;
+            };
+        }
+        done_gate.Open();
+    });
+
+    inputs.Start();
+    output.Start();
+
+    // Wait for output to start
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    for (int i = 0; i < num_events; i++) {
+        if (!BuildEvent(builder, 1, 1, i, i)) {
+            BOOST_FAIL("Failed to build event");
+        }
+    }
+
+    // Wait long enough for the ack queue to fill completely, but mush less than the ack timeout
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    start_gate.Open();
+
+    if (!done_gate.Wait(Gate::OPEN, 1000)) {
+        BOOST_FAIL("Time out waiting for inputs");
+    }
+
+    output.Stop();
+    inputs.Stop();
+    queue->Close();
+    input_thread.join();
+
+    for (auto& msg : log_lines) {
+        if (starts_with(msg, "Output(output): Timeout waiting for Acks")) {
+            BOOST_FAIL("Found 'Timeout waiting for Acks' in log output");
+        }
+    }
+
+    BOOST_REQUIRE_EQUAL(num_events, _outputs.size());
+
+    for (int i = 0; i < num_events; i++) {
+        Event event(_outputs[i].data(), _outputs[i].size());
+        BOOST_REQUIRE_EQUAL(i, event.Serial());
+    }
+}
+
+BOOST_AUTO_TEST_CASE( input_buffer_ring_test ) {
+    const int num_writers = 3;
+    const int num_per_writer = 10000;
+
+    InputBuffer buffer(4);
+
+    // Writers must not wait for the reader while there are free slots
+    std::vector<void*> ptrs;
+    for (int i = 0; i < 4; ++i) {
+        void* ptr = nullptr;
+        BOOST_REQUIRE(buffer.BeginWrite(&ptr));
+        ptrs.push_back(ptr);
+    }
+    for (auto ptr : ptrs) {
+        *reinterpret_cast<int*>(ptr) = -1;
+        BOOST_REQUIRE(buffer.CommitWrite(ptr, sizeof(int)));
+    }
+    for (int i = 0; i < 4; ++i) {
+        BOOST_REQUIRE(buffer.HandleData([](void* ptr, size_t size) {
+            BOOST_REQUIRE_EQUAL(size, sizeof(int));
+            BOOST_REQUIRE_EQUAL(*reinterpret_cast<int*>(ptr), -1);
+        }));
+    }
+
+    std::vector<std::thread> writers;
+    for (int w = 0; w < num_writers; ++w) {
+        writers.emplace_back([&buffer, w]() {
+            for (int i = 0; i < num_per_writer; ++i) {
+                void* ptr = nullptr;
+                if (!buffer.BeginWrite(&ptr)) {
+                    return;
+                }
+                std::array<int, 2> data({w, i});
+                memcpy(ptr, data.data(), sizeof(data));
+                if (!buffer.CommitWrite(ptr, sizeof(data))) {
+                    return;
+                }
+            }
+        });
+    }
+
+    // Data from each writer must arrive in the order it was committed
+    std::vector<int> last(num_writers, -1);
+    int count = 0;
+    bool in_order = true;
+    while (count < num_writers*num_per_writer && buffer.HandleData([&](void* ptr, size_t size) {
+        std::array<int, 2> data;
+        memcpy(data.data(), ptr, sizeof(data));
+        if (size != sizeof(data) || data[1] != last[data[0]]+1) {
+            in_order = false;
+        }
+        last[data[0]] = data[1];
+        count++;
+    })) {}
+
+    for (auto& t : writers) {
+        t.join();
+    }
+    buffer.Close();
+
+    BOOST_REQUIRE(in_order);
+    BOOST_REQUIRE_EQUAL(count, num_writers*num_per_writer);
+    BOOST_REQUIRE(!buffer.HandleData([](void*, size_t) {}));
+}
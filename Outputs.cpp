@@ -222,6 +222,9 @@ void Outputs::do_conf_sync() {
             }
         } else {
             auto o = std::make_shared<Output>(ent.first, _save_dir, _queue, _writer_factory, _filter_factory);
+            if (_metrics) {
+                o->SetWriteLatencyMetric(_metrics->AddMetric(MetricType::METRIC_HISTOGRAM, "output", ent.first + ":write_usec", MetricPeriod::SECOND, MetricPeriod::HOUR));
+            }
             it = _outputs.insert(std::make_pair(ent.first, o)).first;
             load = true;
         }
@@ -20,6 +20,7 @@
 #include "RunBase.h"
 #include "Output.h"
 #include "PriorityQueue.h"
+#include "Metrics.h"
 
 #include <string>
 #include <unordered_map>
@@ -50,14 +51,14 @@ private:
 
 class Outputs: public RunBase {
 public:
-    Outputs(std::shared_ptr<PriorityQueue>& queue, const std::string& conf_dir, const std::string& save_dir, std::shared_ptr<UserDB>& user_db, std::shared_ptr<FiltersEngine> filtersEngine, std::shared_ptr<ProcessTree> processTree):
-            _queue(queue), _conf_dir(conf_dir), _save_dir(save_dir), _do_reload(false) {
+    Outputs(std::shared_ptr<PriorityQueue>& queue, const std::string& conf_dir, const std::string& save_dir, std::shared_ptr<UserDB>& user_db, std::shared_ptr<FiltersEngine> filtersEngine, std::shared_ptr<ProcessTree> processTree, const std::shared_ptr<Metrics>& metrics = nullptr):
+            _queue(queue), _conf_dir(conf_dir), _save_dir(save_dir), _metrics(metrics), _do_reload(false) {
         _writer_factory = std::shared_ptr<IEventWriterFactory>(static_cast<IEventWriterFactory*>(new OutputsEventWriterFactory()));
         _filter_factory = std::shared_ptr<IEventFilterFactory>(static_cast<IEventFilterFactory*>(new OutputsEventFilterFactory(user_db, filtersEngine, processTree)));
     }
 
-    Outputs(std::shared_ptr<PriorityQueue>& queue, const std::string& conf_dir, const std::string& save_dir, const std::shared_ptr<IEventFilterFactory>& filter_factory):
-            _queue(queue), _conf_dir(conf_dir), _save_dir(save_dir),
+    Outputs(std::shared_ptr<PriorityQueue>& queue, const std::string& conf_dir, const std::string& save_dir, const std::shared_ptr<IEventFilterFactory>& filter_factory, const std::shared_ptr<Metrics>& metrics = nullptr):
+            _queue(queue), _conf_dir(conf_dir), _save_dir(save_dir), _metrics(metrics),
             _writer_factory(std::shared_ptr<IEventWriterFactory>(static_cast<IEventWriterFactory*>(new OutputsEventWriterFactory()))),
             _filter_factory(filter_factory),
             _do_reload(false) {
@@ -77,6 +78,7 @@ private:
     std::shared_ptr<PriorityQueue> _queue;
     std::string _conf_dir;
     std::string _save_dir;
+    std::shared_ptr<Metrics> _metrics;
     std::shared_ptr<IEventWriterFactory> _writer_factory;
     std::shared_ptr<IEventFilterFactory> _filter_factory;
     bool _do_reload;
@@ -23,36 +23,64 @@
 #include <unistd.h>
 #include <sys/stat.h>
 #include <sys/statvfs.h>
+#include <sys/mman.h>
 #include <climits>
+#include <algorithm>
 #include <unordered_set>
 
 /**********************************************************************************************************************
- ** QueueItem
+ ** QueueFileMapping
  *********************************************************************************************************************/
 
+QueueFileMapping::~QueueFileMapping() {
+    if (_addr != nullptr && _addr != MAP_FAILED) {
+        munmap(_addr, _size);
+    }
+}
+
 /**********************************************************************************************************************
  ** QueueItemBucket
  *********************************************************************************************************************/
 
-void QueueItemBucket::Put(std::shared_ptr<QueueItem> item) {
+void QueueItemBucket::Put(uint64_t seq, const void* data, size_t size) {
     std::unique_lock<std::mutex> lock(_mutex);
 
-    _items.emplace(item->Sequence(), item);
-    _size += item->Size();
-    if (_min_seq == 0 || _min_seq > item->Sequence()) {
-        _min_seq = item->Sequence();
+    auto item_data = arena_alloc(size);
+    ::memcpy(item_data, data, size);
+
+    _items.push_back(QueueItem(_priority, seq, item_data, size));
+    _size += size;
+    if (_min_seq == 0 || _min_seq > seq) {
+        _min_seq = seq;
     }
-    if (_max_seq < item->Sequence()) {
-        _max_seq = item->Sequence();
+    if (_max_seq < seq) {
+        _max_seq = seq;
     }
 }
 
+// Only call while _mutex is locked
+uint8_t* QueueItemBucket::arena_alloc(size_t size) {
+    // Keep item data 8 byte aligned
+    auto aligned_size = (size + 7) & ~static_cast<size_t>(7);
+    if (_arena_chunks.empty() || _arena_chunk_used + aligned_size > _arena_chunk_size) {
+        _arena_chunk_size = std::max(ARENA_CHUNK_SIZE, aligned_size);
+        _arena_chunk_used = 0;
+        _arena_chunks.emplace_back(new uint8_t[_arena_chunk_size]);
+    }
+    auto ptr = _arena_chunks.back().get() + _arena_chunk_used;
+    _arena_chunk_used += aligned_size;
+    return ptr;
+}
+
 std::shared_ptr<QueueItem> QueueItemBucket::Get(uint64_t seq) {
     std::unique_lock<std::mutex> lock(_mutex);
 
-    auto itr = _items.lower_bound(seq);
+    auto itr = std::lower_bound(_items.begin(), _items.end(), seq, [](const QueueItem& item, uint64_t seq) {
+        return item._seq < seq;
+    });
     if (itr != _items.end()) {
-        return itr->second;
+        // The returned pointer keeps the bucket (and therefore the item data) alive
+        return std::shared_ptr<QueueItem>(shared_from_this(), &(*itr));
     }
     return nullptr;
 }
@@ -132,8 +160,8 @@ bool QueueFile::Save() {
 
     uint32_t next_offset = sizeof(FileHeader)+(sizeof(IndexEntry)*items.size());
     for (auto& i : items) {
-        index.emplace_back(i.second->Sequence(), next_offset, i.second->Size());
-        next_offset += i.second->Size();
+        index.emplace_back(i._seq, next_offset, i._size);
+        next_offset += i._size;
     }
 
     uint32_t file_size = sizeof(FileHeader)+(sizeof(IndexEntry)*items.size())+bucket->Size();
@@ -146,8 +174,8 @@ bool QueueFile::Save() {
     vec[1].iov_len = index.size() * sizeof(IndexEntry);
     int num_vec = 2;
     for (auto& i : items) {
-        vec[num_vec].iov_base = i.second->Data();
-        vec[num_vec].iov_len = i.second->Size();
+        vec[num_vec].iov_base = i._data;
+        vec[num_vec].iov_len = i._size;
         num_vec += 1;
     }
     int num_vec_written = 0;
@@ -194,10 +222,11 @@ bool QueueFile::Remove() {
     return true;
 }
 
+/*
+ * The file is mapped into memory and the items in the returned bucket point directly into the mapping.
+ * The mapping is released when the bucket, and all items returned from it, are released.
+ */
 std::shared_ptr<QueueItemBucket> QueueFile::Read() {
-    std::vector<IndexEntry> index;
-    std::map<uint64_t, std::shared_ptr<QueueItem>> items;
-
     int fd = open(_path.c_str(), O_CLOEXEC|O_RDONLY);
     if (fd < 0) {
         Logger::Error("QueueFile(%s)::Read: Failed to open: %s", _path.c_str(), std::strerror(errno));
@@ -211,90 +240,58 @@ std::shared_ptr<QueueItemBucket> QueueFile::Read() {
         return nullptr;
     }
 
-    // Read header
-    FileHeader header;
-    int ret = read(fd, &header, sizeof(FileHeader));
-    if (ret != sizeof(FileHeader)) {
-        if (ret < 0) {
-            Logger::Error("QueueFile(%s)::Read: Failed to read header: %s", _path.c_str(), std::strerror(errno));
-        } else {
-            Logger::Error("QueueFile(%s)::Read: Invalid or corrupted file: Bad Header", _path.c_str());
-        }
+    if (st.st_size < sizeof(FileHeader)) {
+        Logger::Error("QueueFile(%s)::Read: Invalid or corrupted file: Bad Header", _path.c_str());
         close(fd);
         return nullptr;
     }
 
-    // Verify header
-    if (header._magic != MAGIC) {
-        Logger::Error("QueueFile(%s)::Read: Invalid or corrupted file: Invalid magic: expected %16lX, found %16lX", _path.c_str(), MAGIC, header._magic);
+    // MAP_PRIVATE + PROT_WRITE so that consumers that modify item data do not modify the file
+    auto addr = mmap(nullptr, st.st_size, PROT_READ|PROT_WRITE, MAP_PRIVATE, fd, 0);
+    if (addr == MAP_FAILED) {
+        Logger::Error("QueueFile(%s)::Read: Failed to mmap: %s", _path.c_str(), std::strerror(errno));
         close(fd);
         return nullptr;
     }
-    if (header._version != FILE_VERSION) {
-        Logger::Error("QueueFile(%s)::Read: Invalid or corrupted file: Invalid version: expected %d, found %d", _path.c_str(), FILE_VERSION, header._version);
-        close(fd);
+    close(fd);
+
+    auto mapping = std::make_shared<QueueFileMapping>(addr, st.st_size);
+    madvise(addr, st.st_size, MADV_SEQUENTIAL);
+
+    // Verify header
+    auto header = reinterpret_cast<const FileHeader*>(mapping->Data());
+    if (header->_magic != MAGIC) {
+        Logger::Error("QueueFile(%s)::Read: Invalid or corrupted file: Invalid magic: expected %16lX, found %16lX", _path.c_str(), MAGIC, header->_magic);
         return nullptr;
     }
-    if (header._file_size != st.st_size) {
-        Logger::Error("QueueFile(%s)::Read: Invalid or corrupted file: File size (%ld) does not match header (%d)", _path.c_str(), st.st_size, header._file_size);
-        close(fd);
+    if (header->_version != FILE_VERSION) {
+        Logger::Error("QueueFile(%s)::Read: Invalid or corrupted file: Invalid version: expected %d, found %d", _path.c_str(), FILE_VERSION, header->_version);
         return nullptr;
     }
-
-    // Read index
-    index.resize(header._num_items);
-    ret = read(fd, &index[0], sizeof(IndexEntry)*header._num_items);
-    if (ret != sizeof(IndexEntry)*header._num_items) {
-        if (ret < 0) {
-            Logger::Error("QueueFile(%s)::Read: Failed to read index: %s", _path.c_str(), std::strerror(errno));
-        } else {
-            Logger::Error("QueueFile(%s)::Read: Invalid or corrupted file: Bad Index", _path.c_str());
-        }
-        close(fd);
+    if (header->_file_size != st.st_size) {
+        Logger::Error("QueueFile(%s)::Read: Invalid or corrupted file: File size (%ld) does not match header (%d)", _path.c_str(), st.st_size, header->_file_size);
+        return nullptr;
+    }
+    if (Overhead(header->_num_items) > mapping->Size()) {
+        Logger::Error("QueueFile(%s)::Read: Invalid or corrupted file: Bad Index", _path.c_str());
         return nullptr;
     }
 
-    // Prepare iovec for reading data
-    struct iovec vec[header._num_items];
-    int idx = 0;
+    // Build the item list from the index
+    auto index = reinterpret_cast<const IndexEntry*>(mapping->Data()+sizeof(FileHeader));
+    std::deque<QueueItem> items;
     size_t num_bytes = 0;
-    for (auto& i : index) {
-        auto item = std::shared_ptr<QueueItem>(new QueueItem(_priority, i._seq, i._size));
-        items.emplace(item->Sequence(), item);
-        vec[idx].iov_len = i._size;
-        vec[idx].iov_base = item->Data();
-        num_bytes += i._size;
-        idx += 1;
-    }
-
-    // Read data
-    int num_vec_read = 0;
-    while (num_vec_read < header._num_items) {
-        int nvec = header._num_items - num_vec_read;
-        if (nvec > IOV_MAX) {
-            nvec = IOV_MAX;
-        }
-        size_t rsize = 0;
-        for (int i = num_vec_read; i < num_vec_read+nvec; i++) {
-            rsize += vec[i].iov_len;
-        }
-        int ret = readv(fd, &vec[num_vec_read], nvec);
-        if (ret < 0 || ret != rsize) {
-            if (ret < 0) {
-                Logger::Error("QueueFile(%s)::Read: Failed to read file: %s", _path.c_str(), std::strerror(errno));
-            } else {
-                Logger::Error("QueueFile(%s)::Read: Failed to read file: fewer bytes read (%d) than expected (%ld)", _path.c_str(), ret, rsize);
-            }
-
-            close(fd);
+    for (uint32_t i = 0; i < header->_num_items; ++i) {
+        auto& e = index[i];
+        if (static_cast<size_t>(e._offset) + e._size > mapping->Size() || (!items.empty() && items.back()._seq >= e._seq)) {
+            Logger::Error("QueueFile(%s)::Read: Invalid or corrupted file: Bad Index", _path.c_str());
             return nullptr;
         }
-        num_vec_read += nvec;
+        items.push_back(QueueItem(_priority, e._seq, mapping->Data()+e._offset, e._size));
+        num_bytes += e._size;
     }
 
-    close(fd);
-
-    return std::make_shared<QueueItemBucket>(_priority, num_bytes, std::move(items));
+    return std::make_shared<QueueItemBucket>(_priority, num_bytes, std::move(items), std::move(mapping));
 }
 
 /**********************************************************************************************************************
@@ -412,32 +409,28 @@ void QueueCursor::init_from_file(const QueueCursorFile& file, const std::vector<
     _saved = true;
 }
 
-std::pair<std::shared_ptr<QueueItem>,bool> QueueCursor::get(std::unique_lock<std::mutex>& lock, PriorityQueue* queue, bool& closed, long timeout, bool auto_commit) {
-start:
+bool QueueCursor::wait(std::unique_lock<std::mutex>& lock, PriorityQueue* queue, bool& closed, long timeout) {
     while(!closed && !data_available(queue->_max_seq)) {
         if (timeout < 0) {
             _cond.wait(lock);
         } else if (timeout == 0) {
-            return std::make_pair<std::shared_ptr<QueueItem>,bool>(nullptr, false);
+            return false;
         } else {
             if (_cond.wait_for(lock, std::chrono::milliseconds(timeout)) == std::cv_status::timeout) {
-                return std::make_pair<std::shared_ptr<QueueItem>,bool>(nullptr, false);
+                return false;
             }
         }
     }
+    return true;
+}
 
-    if (closed) {
-        return std::make_pair<std::shared_ptr<QueueItem>,bool>(nullptr, true);
-    }
-
-    std::shared_ptr<QueueItem> item;
-
+std::shared_ptr<QueueItem> QueueCursor::next_item(std::unique_lock<std::mutex>& lock, PriorityQueue* queue) {
     for (uint32_t p = 0; p < _cursors.size(); ++p) {
         if (_cursors[p] < queue->_max_seq[p]) {
             if (!_buckets[p]) {
                 _buckets[p] = queue->get_next_bucket(lock, p, _cursors[p]);
             }
-            item = _buckets[p]->Get(_cursors[p]+1);
+            auto item = _buckets[p]->Get(_cursors[p]+1);
             if (!item) {
                 _buckets[p] = queue->get_next_bucket(lock, p, _cursors[p]);
                 item = _buckets[p]->Get(_cursors[p]+1);
@@ -448,14 +441,29 @@ start:
                 continue;
             }
             _cursors[p] = item->Sequence();
-            break;
+            return item;
         }
     }
+    return nullptr;
+}
 
-    if (!item) {
-        Logger::Error("QueueCursor: data available was true, but no data found!");
-        goto start;
-    }
+std::pair<std::shared_ptr<QueueItem>,bool> QueueCursor::get(std::unique_lock<std::mutex>& lock, PriorityQueue* queue, bool& closed, long timeout, bool auto_commit) {
+    std::shared_ptr<QueueItem> item;
+
+    do {
+        if (!wait(lock, queue, closed, timeout)) {
+            return std::make_pair<std::shared_ptr<QueueItem>,bool>(nullptr, false);
+        }
+
+        if (closed) {
+            return std::make_pair<std::shared_ptr<QueueItem>,bool>(nullptr, true);
+        }
+
+        item = next_item(lock, queue);
+        if (!item) {
+            Logger::Error("QueueCursor: data available was true, but no data found!");
+        }
+    } while (!item);
 
     if (auto_commit) {
         _need_save = true;
@@ -465,6 +473,44 @@ start:
     return std::make_pair(item, false);
 }
 
+bool QueueCursor::get_many(std::unique_lock<std::mutex>& lock, PriorityQueue* queue, bool& closed, std::vector<std::shared_ptr<QueueItem>>& items, size_t max_items, size_t max_bytes, long timeout, bool auto_commit) {
+    items.clear();
+
+    do {
+        if (!wait(lock, queue, closed, timeout)) {
+            return false;
+        }
+
+        if (closed) {
+            return true;
+        }
+
+        // Always take at least one item, even if it alone exceeds max_bytes
+        size_t num_bytes = 0;
+        while (items.size() < max_items && (items.empty() || num_bytes < max_bytes)) {
+            auto item = next_item(lock, queue);
+            if (!item) {
+                break;
+            }
+            num_bytes += item->Size();
+            items.emplace_back(std::move(item));
+        }
+
+        if (items.empty()) {
+            Logger::Error("QueueCursor: data available was true, but no data found!");
+        }
+    } while (items.empty());
+
+    if (auto_commit) {
+        for (auto& item : items) {
+            _committed[item->Priority()] = item->Sequence();
+        }
+        _need_save = true;
+    }
+
+    return false;
+}
+
 void QueueCursor::rollback() {
     for (uint32_t p = 0; p < _committed.size(); p++) {
         if (_cursors[p] != _committed[p]) {
@@ -476,6 +522,12 @@ void QueueCursor::rollback() {
     }
 }
 
+void QueueCursor::commit(const std::vector<std::shared_ptr<QueueItem>>& items, size_t num_items) {
+    for (size_t i = 0; i < num_items && i < items.size(); ++i) {
+        commit(items[i]->Priority(), items[i]->Sequence());
+    }
+}
+
 void QueueCursor::commit(uint32_t priority, uint64_t seq) {
     if (priority >= _committed.size()) {
         return;
@@ -638,6 +690,12 @@ std::pair<std::shared_ptr<QueueItem>,bool> PriorityQueue::Get(const std::shared_
     return cursor_handle->_cursor->get(lock, this, cursor_handle->_closed, timeout, auto_commit);
 }
 
+bool PriorityQueue::GetMany(const std::shared_ptr<QueueCursorHandle>& cursor_handle, std::vector<std::shared_ptr<QueueItem>>& items, size_t max_items, size_t max_bytes, long timeout, bool auto_commit) {
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    return cursor_handle->_cursor->get_many(lock, this, cursor_handle->_closed, items, max_items, max_bytes, timeout, auto_commit);
+}
+
 void PriorityQueue::Rollback(const std::shared_ptr<QueueCursorHandle>& cursor_handle) {
     std::unique_lock<std::mutex> lock(_mutex);
     cursor_handle->_cursor->rollback();
@@ -648,6 +706,11 @@ void PriorityQueue::Commit(const std::shared_ptr<QueueCursorHandle>& cursor_hand
     cursor_handle->_cursor->commit(priority, seq);
 }
 
+void PriorityQueue::Commit(const std::shared_ptr<QueueCursorHandle>& cursor_handle, const std::vector<std::shared_ptr<QueueItem>>& items, size_t num_items) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    cursor_handle->_cursor->commit(items, num_items);
+}
+
 void PriorityQueue::Close(const std::shared_ptr<QueueCursorHandle>& cursor_handle) {
     std::unique_lock<std::mutex> lock(_mutex);
 
@@ -670,30 +733,23 @@ int PriorityQueue::Put(uint32_t priority, const void* data, size_t size) {
         priority = _num_priorities-1;
     }
 
-    auto item = std::shared_ptr<QueueItem>(new QueueItem(priority, _next_seq, size));
-    item->SetData(data, size);
+    auto seq = _next_seq;
     _next_seq += 1;
 
     std::shared_ptr<QueueItemBucket> bucket = _current_buckets[priority];
 
-    if (bucket->Size()+item->Size() > _max_file_data_size) {
+    if (bucket->Size()+size > _max_file_data_size) {
         bucket = cycle_bucket(priority);
     }
 
-    bucket->Put(item);
+    bucket->Put(seq, data, size);
 
-    _max_seq[priority] = item->Sequence();
+    _max_seq[priority] = seq;
 
     _stats._priority_stats[priority]._num_items_added += 1;
 
-    std::vector<std::shared_ptr<QueueCursor>> cursors;
-    cursors.reserve(_cursors.size());
     for (auto& c : _cursors) {
-        cursors.emplace_back(c.second);
-    }
-
-    for (auto& c : cursors) {
-        c->notify(priority, item->Sequence());
+        c.second->notify(priority, seq);
     }
 
     return 1;
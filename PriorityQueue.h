@@ -39,14 +39,16 @@
  */
 
 class QueueFile;
+class QueueItemBucket;
 class PriorityQueue;
 
+/*
+ * A QueueItem does not own its data. The data is owned by the QueueItemBucket that contains the item
+ * (either heap memory or a read-only mapping of the queue file the bucket was loaded from).
+ * The std::shared_ptr<QueueItem> returned by PriorityQueue::Get() shares ownership of the bucket.
+ */
 class QueueItem {
 public:
-    ~QueueItem() {
-        delete[] _data;
-    }
-
     inline uint32_t Priority() { return _priority; }
     inline uint64_t Sequence() { return _seq; }
     inline void* Data() { return _data; }
@@ -54,16 +56,10 @@ public:
 
 private:
     friend QueueFile;
+    friend QueueItemBucket;
     friend PriorityQueue;
 
-    QueueItem(uint32_t priority, uint64_t seq, size_t size): _priority(priority), _seq(seq), _data(nullptr), _size(size) {
-        _data = new uint8_t[_size];
-    }
-
-    void SetData(const void* data, size_t size) {
-        auto n = std::min(size, _size);
-        ::memcpy(_data, data, n);
-    }
+    QueueItem(uint32_t priority, uint64_t seq, uint8_t* data, size_t size): _priority(priority), _seq(seq), _data(data), _size(size) {}
 
     uint32_t _priority;
     uint64_t _seq;
@@ -71,18 +67,37 @@ private:
     size_t _size;
 };
 
-class QueueItemBucket {
+// A (copy-on-write) memory mapping of a saved queue file.
+class QueueFileMapping {
 public:
-    explicit QueueItemBucket(uint32_t priority): _min_seq(0), _max_seq(0), _priority(priority), _size(0), _items() {}
-    QueueItemBucket(uint32_t priority, size_t size, std::map<uint64_t, std::shared_ptr<QueueItem>> items): _priority(priority), _size(size), _items(std::move(items)) {
+    QueueFileMapping(void* addr, size_t size): _addr(addr), _size(size) {}
+    QueueFileMapping(const QueueFileMapping& other) = delete;
+    QueueFileMapping& operator=(const QueueFileMapping& other) = delete;
+    ~QueueFileMapping();
+
+    inline uint8_t* Data() { return reinterpret_cast<uint8_t*>(_addr); }
+    inline size_t Size() const { return _size; }
+
+private:
+    void* _addr;
+    size_t _size;
+};
+
+class QueueItemBucket: public std::enable_shared_from_this<QueueItemBucket> {
+public:
+    explicit QueueItemBucket(uint32_t priority): _min_seq(0), _max_seq(0), _priority(priority), _size(0), _items(), _arena_chunks(), _arena_chunk_size(0), _arena_chunk_used(0) {}
+    // Items must be in sequence order and their data must reside in the mapping
+    QueueItemBucket(uint32_t priority, size_t size, std::deque<QueueItem> items, std::shared_ptr<QueueFileMapping> mapping): _min_seq(0), _max_seq(0), _priority(priority), _size(size), _items(std::move(items)), _arena_chunks(), _arena_chunk_size(0), _arena_chunk_used(0), _mapping(std::move(mapping)) {
         if (!_items.empty()) {
-            _min_seq = _items.begin()->second->Sequence();
-            _max_seq = _items.rbegin()->second->Sequence();
+            _min_seq = _items.front().Sequence();
+            _max_seq = _items.back().Sequence();
         }
     }
 
-    void Put(std::shared_ptr<QueueItem> item);
+    // seq must be greater than MaxSequence()
+    void Put(uint64_t seq, const void* data, size_t size);
 
+    // Return the first item with a sequence >= seq
     std::shared_ptr<QueueItem> Get(uint64_t seq);
 
     inline size_t Size() const { return _size; }
@@ -90,7 +105,8 @@ public:
     inline uint64_t MinSequence() const { return _min_seq; }
     inline uint64_t MaxSequence() const { return _max_seq; }
 
-    inline const std::map<uint64_t, std::shared_ptr<QueueItem>>& Items() const { return _items; }
+    // Only safe to use once the bucket is no longer being added to.
+    inline const std::deque<QueueItem>& Items() const { return _items; }
 
 private:
     std::mutex _mutex;
@@ -99,7 +115,17 @@ private:
     uint64_t _max_seq;
     uint32_t _priority;
     uint32_t _size;
-    std::map<uint64_t, std::shared_ptr<QueueItem>> _items;
+    static constexpr size_t ARENA_CHUNK_SIZE = 64*1024;
+
+    uint8_t* arena_alloc(size_t size);
+
+    // Sorted by sequence. std::deque is used because push_back does not invalidate references to existing items.
+    std::deque<QueueItem> _items;
+    // Item data added via Put() is bump allocated from these chunks
+    std::vector<std::unique_ptr<uint8_t[]>> _arena_chunks;
+    size_t _arena_chunk_size;
+    size_t _arena_chunk_used;
+    std::shared_ptr<QueueFileMapping> _mapping;
 };
 
 class QueueFile {
@@ -255,8 +281,13 @@ private:
 
     void init_from_file(const QueueCursorFile& file, const std::vector<uint64_t>& max_seq);
 
+    // Return false on timeout
+    bool wait(std::unique_lock<std::mutex>& lock, PriorityQueue* queue, bool& closed, long timeout);
+    std::shared_ptr<QueueItem> next_item(std::unique_lock<std::mutex>& lock, PriorityQueue* queue);
     std::pair<std::shared_ptr<QueueItem>,bool> get(std::unique_lock<std::mutex>& lock, PriorityQueue* queue, bool& closed, long timeout, bool auto_commit = true);
+    bool get_many(std::unique_lock<std::mutex>& lock, PriorityQueue* queue, bool& closed, std::vector<std::shared_ptr<QueueItem>>& items, size_t max_items, size_t max_bytes, long timeout, bool auto_commit);
     void rollback();
+    void commit(const std::vector<std::shared_ptr<QueueItem>>& items, size_t num_items);
     void commit(uint32_t priority, uint64_t seq);
 
     void get_min_seq(std::vector<uint64_t>& min_seq);
@@ -364,8 +395,16 @@ public:
     void RemoveCursor(const std::string& name);
 
     std::pair<std::shared_ptr<QueueItem>,bool> Get(const std::shared_ptr<QueueCursorHandle>& cursor_handle, long timeout, bool auto_commit = true);
+    /*
+     * Get up to max_items items in one call, stopping once the total item size reaches max_bytes.
+     * At least one item is returned unless the timeout expires or the cursor is closed.
+     * items is cleared first. Returns true if the cursor was closed.
+     */
+    bool GetMany(const std::shared_ptr<QueueCursorHandle>& cursor_handle, std::vector<std::shared_ptr<QueueItem>>& items, size_t max_items, size_t max_bytes, long timeout, bool auto_commit = true);
     void Rollback(const std::shared_ptr<QueueCursorHandle>& cursor_handle);
     void Commit(const std::shared_ptr<QueueCursorHandle>& cursor_handle, uint32_t priority, uint64_t seq);
+    // Commit the first num_items entries of items (as returned by GetMany)
+    void Commit(const std::shared_ptr<QueueCursorHandle>& cursor_handle, const std::vector<std::shared_ptr<QueueItem>>& items, size_t num_items);
     void Close(const std::shared_ptr<QueueCursorHandle>& cursor_handle);
 
     // Return 1 on success, 0 on queue closed, and -1 if item too large
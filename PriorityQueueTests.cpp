@@ -1914,3 +1914,131 @@ BOOST_AUTO_TEST_CASE( queue_empty_cursor_reset ) {
         queue->Close();
     }
 }
+
+BOOST_AUTO_TEST_CASE( queue_reopen_item_lifetime ) {
+    TempDir dir("/tmp/PriorityQueueTests");
+
+    {
+        auto queue = PriorityQueue::Open(dir.Path(), 8, 4096, 16, 4096 * 1024, 100, 0);
+        if (!queue) {
+            BOOST_FAIL("Failed to open queue");
+        }
+
+        queue->StartSaver(0);
+
+        auto cursor_handle = queue->OpenCursor("test");
+
+        std::array<uint8_t, 1024> data;
+        for (uint8_t i = 1; i <= 10; i++) {
+            data.fill(i);
+            if (queue->Put(0, data.data(), 100*i) != 1) {
+                BOOST_FAIL("queue->Put() failed!");
+            }
+        }
+
+        queue->Close();
+    }
+
+    std::vector<std::shared_ptr<QueueItem>> items;
+
+    {
+        auto queue = PriorityQueue::Open(dir.Path(), 8, 4096, 16, 4096 * 1024, 100, 0);
+        if (!queue) {
+            BOOST_FAIL("Failed to open queue");
+        }
+
+        queue->StartSaver(0);
+
+        auto cursor_handle = queue->OpenCursor("test");
+
+        for (uint8_t i = 1; i <= 10; i++) {
+            auto val = queue->Get(cursor_handle, 0);
+            if (!val.first) {
+                BOOST_FAIL("cursor->Get() returned nullptr!");
+            }
+            items.emplace_back(val.first);
+        }
+
+        // All items are committed, so the final save will remove the queue files
+        queue->Close();
+    }
+
+    // The items (and the file mapping they point into) must remain valid after the queue and its files are gone
+    BOOST_REQUIRE_EQUAL(items.size(), 10);
+    for (uint8_t i = 1; i <= 10; i++) {
+        auto& item = items[i-1];
+        BOOST_REQUIRE_EQUAL(item->Size(), 100*i);
+        auto ptr = reinterpret_cast<uint8_t*>(item->Data());
+        for (size_t n = 0; n < item->Size(); ++n) {
+            BOOST_REQUIRE_EQUAL(ptr[n], i);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE( queue_get_many ) {
+    TempDir dir("/tmp/PriorityQueueTests");
+
+    auto queue = PriorityQueue::Open(dir.Path(), 8, 4096, 16, 4096 * 1024, 100, 0);
+    if (!queue) {
+        BOOST_FAIL("Failed to open queue");
+    }
+
+    auto cursor_handle = queue->OpenCursor("test");
+
+    std::array<uint8_t, 100> data;
+    for (uint8_t i = 0; i < 20; i++) {
+        data.fill(i);
+        if (queue->Put(i % 2, data.data(), data.size()) != 1) {
+            BOOST_FAIL("queue->Put() failed!");
+        }
+    }
+
+    std::vector<std::shared_ptr<QueueItem>> items;
+
+    // Sequence numbers are shared across priorities. Limited by max_items, priority 0 items come first
+    BOOST_REQUIRE(!queue->GetMany(cursor_handle, items, 4, 1024*1024, 0, false));
+    BOOST_REQUIRE_EQUAL(items.size(), 4);
+    auto first_seq = items[0]->Sequence();
+    for (int i = 0; i < 4; i++) {
+        BOOST_REQUIRE_EQUAL(items[i]->Priority(), 0);
+        BOOST_REQUIRE_EQUAL(items[i]->Sequence(), first_seq+i*2);
+        BOOST_REQUIRE_EQUAL(reinterpret_cast<uint8_t*>(items[i]->Data())[0], i*2);
+    }
+
+    // Commit only part of the batch, then rollback
+    queue->Commit(cursor_handle, items, 2);
+    queue->Rollback(cursor_handle);
+
+    // Limited by max_bytes
+    BOOST_REQUIRE(!queue->GetMany(cursor_handle, items, 100, 250, 0, false));
+    BOOST_REQUIRE_EQUAL(items.size(), 3);
+    BOOST_REQUIRE_EQUAL(items[0]->Priority(), 0);
+    BOOST_REQUIRE_EQUAL(items[0]->Sequence(), first_seq+4);
+
+    // At least one item is returned even if it exceeds max_bytes
+    BOOST_REQUIRE(!queue->GetMany(cursor_handle, items, 100, 1, 0, true));
+    BOOST_REQUIRE_EQUAL(items.size(), 1);
+    BOOST_REQUIRE_EQUAL(items[0]->Sequence(), first_seq+10);
+
+    // Drain the rest, spanning both priorities
+    BOOST_REQUIRE(!queue->GetMany(cursor_handle, items, 100, 1024*1024, 0, true));
+    BOOST_REQUIRE_EQUAL(items.size(), 14);
+    BOOST_REQUIRE_EQUAL(items[3]->Priority(), 0);
+    BOOST_REQUIRE_EQUAL(items[3]->Sequence(), first_seq+18);
+    BOOST_REQUIRE_EQUAL(items[4]->Priority(), 1);
+    BOOST_REQUIRE_EQUAL(items[4]->Sequence(), first_seq+1);
+    BOOST_REQUIRE_EQUAL(items[13]->Sequence(), first_seq+19);
+
+    // Nothing left, and everything was committed
+    BOOST_REQUIRE(!queue->GetMany(cursor_handle, items, 100, 1024*1024, 0, true));
+    BOOST_REQUIRE(items.empty());
+    queue->Rollback(cursor_handle);
+    BOOST_REQUIRE(!queue->GetMany(cursor_handle, items, 100, 1024*1024, 0, true));
+    BOOST_REQUIRE(items.empty());
+
+    queue->Close(cursor_handle);
+    BOOST_REQUIRE(queue->GetMany(cursor_handle, items, 100, 1024*1024, 0, true));
+    BOOST_REQUIRE(items.empty());
+
+    queue->Close();
+}
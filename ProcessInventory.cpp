@@ -0,0 +1,77 @@
+/*
+    microsoft-oms-auditd-plugin
+
+    Copyright (c) Microsoft Corporation
+
+    All rights reserved.
+
+    MIT License
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "ProcessInventory.h"
+#include "ProcessInfo.h"
+#include "Logger.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <sys/time.h>
+
+void ProcessInventory::run() {
+    Logger::Info("ProcessInventory: starting");
+
+    auto next = std::chrono::steady_clock::now();
+    long sleep_duration = 0;
+    do {
+        next += _interval;
+        if (!generate_inventory()) {
+            return;
+        }
+
+        sleep_duration = std::chrono::duration_cast<std::chrono::milliseconds>(next - std::chrono::steady_clock::now()).count();
+        if (sleep_duration < 0) {
+            sleep_duration = 0;
+        }
+    } while (!_sleep(static_cast<int>(std::min(sleep_duration, static_cast<long>(INT_MAX)))));
+}
+
+bool ProcessInventory::generate_inventory() {
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+
+    // All the events in an inventory have the same timestamp
+    uint64_t sec = static_cast<uint64_t>(tv.tv_sec);
+    uint32_t msec = static_cast<uint32_t>(tv.tv_usec)/1000;
+
+    auto pinfo = ProcessInfo::Open(64*1024);
+    if (!pinfo) {
+        Logger::Error("Failed to open '/proc': %s", strerror(errno));
+        return true;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    long count = 0;
+    while(pinfo->next()) {
+        _processor->GenerateProcessInventoryEvent(pinfo.get(), sec, msec);
+        count++;
+
+        if (_max_rate > 0) {
+            // Sleep until the time at which count events may have been sent
+            auto due = start + std::chrono::microseconds(count * 1000000 / _max_rate);
+            auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(due - std::chrono::steady_clock::now()).count();
+            if (wait > 0 && _sleep(static_cast<int>(wait))) {
+                return false;
+            }
+        } else if (IsStopping()) {
+            return false;
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,50 @@
+/*
+    microsoft-oms-auditd-plugin
+
+    Copyright (c) Microsoft Corporation
+
+    All rights reserved.
+
+    MIT License
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef AUOMS_PROCESSINVENTORY_H
+#define AUOMS_PROCESSINVENTORY_H
+
+#include "RunBase.h"
+#include "RawEventProcessor.h"
+
+#include <chrono>
+#include <memory>
+
+/*
+ * Periodically emits an AUOMS_PROCESS_INVENTORY event for every process in /proc.
+ * The inventory is generated on its own thread, with its own RawEventProcessor (and EventBuilder), so the scan of
+ * /proc never blocks event processing. Events are emitted at no more than max_rate per second (0 means no limit),
+ * so a host with many processes produces the inventory over several seconds rather than in a single burst.
+ * The first inventory is generated as soon as the thread starts, then every interval.
+ */
+class ProcessInventory: public RunBase {
+public:
+    ProcessInventory(std::unique_ptr<RawEventProcessor> processor, std::chrono::seconds interval, long max_rate)
+        : _processor(std::move(processor)), _interval(interval), _max_rate(max_rate) {}
+
+protected:
+    void run() override;
+
+private:
+    // Returns false if stopped before the inventory was complete
+    bool generate_inventory();
+
+    std::unique_ptr<RawEventProcessor> _processor;
+    std::chrono::seconds _interval;
+    long _max_rate;
+};
+
+#endif //AUOMS_PROCESSINVENTORY_H
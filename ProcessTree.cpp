@@ -18,6 +18,7 @@
 #include "ProcessTree.h"
 #include "Logger.h"
 #include "StringUtils.h"
+#include "Signals.h"
 #include <stdlib.h>
 #include <dirent.h> 
 #include <ctype.h>
@@ -30,6 +31,7 @@
 #include <linux/netlink.h>
 #include <linux/filter.h>
 #include <sys/stat.h>
+#include <unordered_set>
 
 #ifndef SOL_NETLINK
 // This isn't defined in older socket.h include files.
@@ -40,9 +42,13 @@
 //constexpr int CLEAN_PROCESS_INTERVAL = 300;
 constexpr int CLEAN_PROCESS_TIMEOUT = 5;
 constexpr int CLEAN_PROCESS_INTERVAL = 5;
+// The number of tracked pids checked against /proc by each Clean()
+constexpr size_t VERIFY_PIDS_PER_CLEAN = 1024;
 
 constexpr int CMDLINE_SIZE_LIMIT = 1024;
 
+std::atomic<long> Ancestor::s_count(0);
+
 bool ProcessNotify::InitProcSocket()
 {
     struct sockaddr_nl s_addr;
@@ -247,15 +253,58 @@ void ProcessTree::AddPnExitQueue(int pid)
     _queue_data.notify_one();
 }
 
+void ProcessTree::EnableAsyncResolve(int num_threads, std::chrono::milliseconds max_wait)
+{
+    std::lock_guard<std::mutex> resolve_lock(_resolve_mutex);
+    _num_resolver_threads = std::max(num_threads, 0);
+    _resolve_wait = max_wait;
+}
+
+void ProcessTree::SetResolveMetrics(const std::shared_ptr<Metric>& hit_metric, const std::shared_ptr<Metric>& miss_metric,
+                                    const std::shared_ptr<Metric>& timeout_metric, const std::shared_ptr<Metric>& latency_metric)
+{
+    std::lock_guard<std::mutex> resolve_lock(_resolve_mutex);
+    _resolve_hit_metric = hit_metric;
+    _resolve_miss_metric = miss_metric;
+    _resolve_timeout_metric = timeout_metric;
+    _resolve_latency_metric = latency_metric;
+}
+
 void ProcessTree::on_stopping() {
     _queue_data.notify_all();
+    std::lock_guard<std::mutex> resolve_lock(_resolve_mutex);
+    _resolve_running = false;
+    _resolve_cond.notify_all();
+    _resolve_done_cond.notify_all();
+}
+
+void ProcessTree::on_stop() {
+    for (auto& thread : _resolver_threads) {
+        thread.join();
+    }
+    _resolver_threads.clear();
+
+    std::lock_guard<std::mutex> resolve_lock(_resolve_mutex);
+    _resolve_queue.clear();
+    _resolve_pending.clear();
 }
 
 void ProcessTree::run()
 {
+    {
+        std::lock_guard<std::mutex> resolve_lock(_resolve_mutex);
+        if (!IsStopping() && _num_resolver_threads > 0) {
+            _resolve_running = true;
+            for (int i = 0; i < _num_resolver_threads; ++i) {
+                _resolver_threads.emplace_back([this]() { this->resolver_task(); });
+            }
+        }
+    }
+
     std::unique_lock<std::mutex> queue_lock(_queue_mutex);
     while (!IsStopping()) {
-        _queue_data.wait(queue_lock, [&]{return !_PnQueue.empty() || IsStopping();});
+        // Wake up at least every CLEAN_PROCESS_INTERVAL so exited processes are removed even when there are no events
+        _queue_data.wait_for(queue_lock, std::chrono::seconds(CLEAN_PROCESS_INTERVAL), [&]{return !_PnQueue.empty() || IsStopping();});
         if (IsStopping()) {
             return;
         }
@@ -297,10 +346,10 @@ void ProcessTree::run()
 void ProcessTree::AddPid(int pid, int ppid)
 {
     std::unique_lock<std::mutex> process_write_lock(_process_write_mutex);
-    if (_processes.count(pid) == 0) {
+    if (!_processes.Find(pid)) {
         std::shared_ptr<ProcessTreeItem> process = std::make_shared<ProcessTreeItem>(ProcessTreeSource_pnotify, pid, ppid);
-        if (ppid && _processes.count(ppid) > 0) {
-            auto parent = _processes[ppid];
+        auto parent = ppid ? _processes.Find(ppid) : nullptr;
+        if (parent) {
             process->_uid = parent->_uid;
             process->_gid = parent->_gid;
             process->_exe = parent->_exe;
@@ -308,15 +357,12 @@ void ProcessTree::AddPid(int pid, int ppid)
             process->_containerid = parent->_containerid;
             process->_exec_propagation = parent->_exec_propagation;
             parent->_children.emplace_back(pid);
-            process->_ancestors = parent->_ancestors;
-            struct Ancestor anc = {ppid, parent->_exe};
-            process->_ancestors.emplace_back(anc);
+            set_parent(*process, *parent);
             ApplyFlags(process);
         } else {
-            struct Ancestor anc = {ppid, ""};
-            process->_ancestors.emplace_back(anc);
+            process->_ancestors = std::make_shared<const Ancestor>(ppid, InternedString(), nullptr);
         }
-        _processes[pid] = process;
+        _processes.Set(pid, process);
     }
 }
 
@@ -328,119 +374,79 @@ void ProcessTree::AddPid(int pid, int ppid)
 void ProcessTree::AddPid(int pid)
 {
     std::unique_lock<std::mutex> process_write_lock(_process_write_mutex);
-    if (_processes.count(pid) > 0) {
-        if (_processes[pid]->_source == ProcessTreeSource_pnotify) {
-            _processes[pid]->_exec_propagation += 1;
+    auto process = _processes.Find(pid);
+    if (process) {
+        if (process->_source == ProcessTreeSource_pnotify) {
+            process->_exec_propagation += 1;
         }
     } else {
-        std::shared_ptr<ProcessTreeItem> process = std::make_shared<ProcessTreeItem>(ProcessTreeSource_pnotify, pid);
+        process = std::make_shared<ProcessTreeItem>(ProcessTreeSource_pnotify, pid);
         process->_exec_propagation = 1;
-        _processes[pid] = process;
+        _processes.Set(pid, process);
     }
 }
 
 /* Process event from AuditD (execve)
-   Make a new entry (deleting any existing entry).
+   Make a new entry (replacing any existing entry).
 */
 std::shared_ptr<ProcessTreeItem> ProcessTree::AddProcess(enum ProcessTreeSource source, int pid, int ppid, int uid, int gid, const std::string& exe, const std::string &cmdline)
 {
     std::unique_lock<std::mutex> process_write_lock(_process_write_mutex);
     std::shared_ptr<ProcessTreeItem> process;
 
-    std::string containerid = ExtractContainerId(exe, cmdline);
-
-    auto it = _processes.find(pid);
-    if (it != _processes.end()) {
-        process = it->second;
-        {
-            std::lock_guard<std::mutex> _lock(process->_mutex);
-            process->_source = source;
-            process->_uid = uid;
-            process->_gid = gid;
-            process->_exe = exe;
-            process->_cmdline = cmdline;
-            process->_containeridfromhostprocess = containerid;
-        }
+    auto iexe = _strings.Intern(exe);
+    auto icmdline = _strings.Intern(cmdline);
+    auto containerid = _strings.Intern(ExtractContainerId(exe, cmdline));
+
+    auto existing = _processes.Find(pid);
+    if (existing) {
+        // Published items are never modified, update a copy and replace the existing entry with it
+        process = std::make_shared<ProcessTreeItem>(*existing);
+        process->_source = source;
+        process->_uid = uid;
+        process->_gid = gid;
+        process->_exe = iexe;
+        process->_cmdline = icmdline;
+        process->_containeridfromhostprocess = containerid;
         if (ppid != process->_ppid) {
-            auto it2 = _processes.find(process->_ppid);
-            if (it2 != _processes.end()) {
-                auto oldparent = it2->second;
+            auto oldparent = _processes.Find(process->_ppid);
+            if (oldparent) {
                 auto e = std::find(oldparent->_children.begin(), oldparent->_children.end(), pid);
                 if (e != oldparent->_children.end()) {
                     oldparent->_children.erase(e);
                 }
             }
-            it2 = _processes.find(ppid);
-            if (it2 != _processes.end()) {
-                auto parentproc = it2->second;
+            auto parentproc = _processes.Find(ppid);
+            if (parentproc) {
                 parentproc->_children.emplace_back(pid);
-                {
-                    std::lock_guard<std::mutex> _lock(process->_mutex);
-                    if (!(parentproc->_containeridfromhostprocess).empty()) {
-                        process->_containerid = parentproc->_containeridfromhostprocess;
-                    } else {
-                        process->_containerid = parentproc->_containerid;
-                    }
+                if (!(parentproc->_containeridfromhostprocess).empty()) {
+                    process->_containerid = parentproc->_containeridfromhostprocess;
+                } else {
+                    process->_containerid = parentproc->_containerid;
                 }
-                process->_ancestors = parentproc->_ancestors;
-                struct Ancestor anc = {ppid, parentproc->_exe};
-                process->_ancestors.emplace_back(anc);
+                set_parent(*process, *parentproc);
             }
             process->_ppid = ppid;
         }
         if (process->_exec_propagation > 0) {
             process->_exec_propagation = process->_exec_propagation - 1;
         }
-        for (auto c : process->_children) {
-            auto it2 = _processes.find(c);
-            if (it2 != _processes.end()) {
-                auto p = it2->second;
-                if (p->_exec_propagation > 0) {
-                    {
-                        std::lock_guard<std::mutex> _lock(process->_mutex);
-                        p->_source = source;
-                        p->_exe = exe;
-                        p->_cmdline = cmdline;
-                        p->_uid = uid;
-                        p->_gid = gid;
-                        if (!(process->_containeridfromhostprocess).empty()) {
-                            p->_containerid = process->_containeridfromhostprocess;
-                        } else {
-                            p->_containerid = process->_containerid;
-                        }
-                    }
-                    p->_ancestors = process->_ancestors;
-                    struct Ancestor anc = {pid, exe};
-                    p->_ancestors.emplace_back(anc);
-                    p->_exec_propagation = p->_exec_propagation - 1;
-                    ApplyFlags(p);
-                }
-            }
-        }
-        ApplyFlags(process);
     } else {
-        process = std::make_shared<ProcessTreeItem>(ProcessTreeSource_execve, pid, ppid, uid, gid, exe, cmdline);
-        auto it2 = _processes.find(ppid);
-        if (it2 != _processes.end()) {
-            auto parentproc = it2->second;
+        process = std::make_shared<ProcessTreeItem>(ProcessTreeSource_execve, pid, ppid, uid, gid, iexe, icmdline);
+        auto parentproc = _processes.Find(ppid);
+        if (parentproc) {
             parentproc->_children.emplace_back(pid);
-            {
-                std::lock_guard<std::mutex> _lock(process->_mutex);
-                if (!(parentproc->_containeridfromhostprocess).empty()) {
-                    process->_containerid = parentproc->_containeridfromhostprocess;
-                } else {
-                    process->_containeridfromhostprocess = containerid;
-                    process->_containerid = parentproc->_containerid;
-                }
+            if (!(parentproc->_containeridfromhostprocess).empty()) {
+                process->_containerid = parentproc->_containeridfromhostprocess;
+            } else {
+                process->_containeridfromhostprocess = containerid;
+                process->_containerid = parentproc->_containerid;
             }
-            process->_ancestors = parentproc->_ancestors;
-            struct Ancestor anc = {ppid, parentproc->_exe};
-            process->_ancestors.emplace_back(anc);
+            set_parent(*process, *parentproc);
         }
-        ApplyFlags(process);
-        _processes[pid] = process;
     }
-    
+    ApplyFlags(process);
+
     // The purpose of extracting the container ID from cgroup is to accurately identify
     // the container in which a process is running. This is particularly important for
     // monitoring and logging purposes in containerized environments, where applications
@@ -462,6 +468,32 @@ std::shared_ptr<ProcessTreeItem> ProcessTree::AddProcess(enum ProcessTreeSource
         }
     }
 
+    _processes.Set(pid, process);
+
+    // Children that haven't yet had their own execve inherit the new exe/cmdline
+    if (existing) {
+        for (auto c : process->_children) {
+            auto child = _processes.Find(c);
+            if (child && child->_exec_propagation > 0) {
+                auto p = std::make_shared<ProcessTreeItem>(*child);
+                p->_source = source;
+                p->_exe = iexe;
+                p->_cmdline = icmdline;
+                p->_uid = uid;
+                p->_gid = gid;
+                if (!(process->_containeridfromhostprocess).empty()) {
+                    p->_containerid = process->_containeridfromhostprocess;
+                } else {
+                    p->_containerid = process->_containerid;
+                }
+                set_parent(*p, *process);
+                p->_exec_propagation = p->_exec_propagation - 1;
+                ApplyFlags(p);
+                _processes.Set(c, p);
+            }
+        }
+    }
+
     return process;
 }
 
@@ -470,11 +502,11 @@ std::shared_ptr<ProcessTreeItem> ProcessTree::AddProcess(enum ProcessTreeSource
 void ProcessTree::RemovePid(int pid)
 {
     std::unique_lock<std::mutex> process_write_lock(_process_write_mutex);
-    auto it = _processes.find(pid);
-    if (it != _processes.end()) {
-        auto process = it->second;
+    auto process = _processes.Find(pid);
+    if (process) {
         process->_exit_time = std::chrono::system_clock::now();
         process->_exited = true;
+        _exit_queue.emplace_back(process->_exit_time, pid);
     }
 }
 
@@ -493,69 +525,242 @@ bool proc_is_gone(pid_t pid) {
 
 void ProcessTree::Clean()
 {
+    {
+        std::unique_lock<std::mutex> process_write_lock(_process_write_mutex);
+        expire_exited(std::chrono::system_clock::now());
+    }
+
+    verify_exited();
+
     std::unique_lock<std::mutex> process_write_lock(_process_write_mutex);
+    update_memory_metrics();
+}
 
-    for (auto element = _processes.begin(); element != _processes.end();) {
-        if (element->second->_exited || proc_is_gone(element->second->_pid)) {
-            std::chrono::duration<double> elapsed_seconds = std::chrono::system_clock::now() - element->second->_exit_time;
-            if (elapsed_seconds.count() > CLEAN_PROCESS_TIMEOUT) {
-                // remove this process
-                element = _processes.erase(element);
-                // back round the loop without iterating (as the erase() gave us the next item)
-                continue;
-            }
+// Must be called with _process_write_mutex held
+void ProcessTree::expire_exited(std::chrono::system_clock::time_point now)
+{
+    auto cutoff = now - std::chrono::seconds(CLEAN_PROCESS_TIMEOUT);
+    while (!_exit_queue.empty() && _exit_queue.front().first < cutoff) {
+        auto pid = _exit_queue.front().second;
+        _exit_queue.pop_front();
+        // The pid may have been reused, or have exited again, since this entry was added
+        auto process = _processes.Find(pid);
+        if (process && process->_exited && process->_exit_time < cutoff) {
+            _processes.Erase(pid);
         }
-        element++;
+    }
+}
+
+/*
+ * Exits are normally reported by pnotify, but they can be missed (e.g. if the netlink socket overflows, or the
+ * item was replaced after the exit was reported). Each call checks the next VERIFY_PIDS_PER_CLEAN pids from a
+ * snapshot of the table, and removes the processes that no longer exist. The stat() calls are made without
+ * holding the write mutex.
+ */
+void ProcessTree::verify_exited()
+{
+    if (_verify_pos >= _verify_pids.size()) {
+        _verify_pids = _processes.Pids();
+        _verify_pos = 0;
+    }
+
+    auto end = std::min(_verify_pos + VERIFY_PIDS_PER_CLEAN, _verify_pids.size());
+    std::vector<int> gone;
+    for (; _verify_pos < end; ++_verify_pos) {
+        auto pid = _verify_pids[_verify_pos];
+        if (proc_is_gone(pid)) {
+            gone.emplace_back(pid);
+        }
+    }
+
+    if (gone.empty()) {
+        return;
+    }
+
+    std::unique_lock<std::mutex> process_write_lock(_process_write_mutex);
+    for (auto pid : gone) {
+        auto process = _processes.Find(pid);
+        // Exited processes are removed by expire_exited(), check again in case the pid was reused
+        if (process && !process->_exited && proc_is_gone(pid)) {
+            _processes.Erase(pid);
+        }
+    }
+}
+
+void ProcessTree::update_memory_metrics()
+{
+    // Drop strings no longer used by any item or Ancestor
+    auto stats = _strings.Purge();
+    if (_memory_metric) {
+        _memory_metric->Update(static_cast<double>(_processes.Size() * sizeof(ProcessTreeItem) + Ancestor::Count() * sizeof(Ancestor) + stats.pooled_bytes));
+    }
+    if (_memory_saved_metric) {
+        _memory_saved_metric->Update(static_cast<double>(stats.referenced_bytes - stats.pooled_bytes));
     }
 }
 
 std::shared_ptr<ProcessTreeItem> ProcessTree::GetInfoForPid(int pid)
 {
+    auto process = _processes.Find(pid);
+    if (process && process->_source != ProcessTreeSource_pnotify) {
+        if (_resolve_hit_metric) {
+            _resolve_hit_metric->Update(1.0);
+        }
+        return process;
+    }
+
+    if (_resolve_miss_metric) {
+        _resolve_miss_metric->Update(1.0);
+    }
+
+    {
+        std::unique_lock<std::mutex> resolve_lock(_resolve_mutex);
+        if (_resolve_running) {
+            resolve_lock.unlock();
+            return resolve_async(pid, process);
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
     std::unique_lock<std::mutex> process_write_lock(_process_write_mutex);
-    auto it = _processes.find(pid);
-    if (it != _processes.end() && it->second->_source != ProcessTreeSource_pnotify) {
-        return it->second;
-    } else {
-        // process doesn't currently exist, or we only have rudimentary information for it, so add it
-        auto process = ReadProcEntry(pid);
-        if (process != nullptr) {
-            auto it2 = _processes.find(process->_ppid);
-            if (it2 != _processes.end()) {
-                auto parentproc = it2->second;
-                parentproc->_children.emplace_back(pid);
-                if (!(parentproc->_containeridfromhostprocess).empty()) {
-                    process->_containerid = parentproc->_containeridfromhostprocess;
-                } else {
-                    process->_containerid = parentproc->_containerid;
-                }
-                process->_ancestors = parentproc->_ancestors;
-                struct Ancestor anc = {process->_ppid, parentproc->_exe};
-                process->_ancestors.emplace_back(anc);
+    // Check again, the process may have been added while waiting for the lock
+    process = _processes.Find(pid);
+    if (process && process->_source != ProcessTreeSource_pnotify) {
+        return process;
+    }
+
+    // process doesn't currently exist, or we only have rudimentary information for it, so add it
+    process = install_proc_entry(pid, ReadProcEntry(pid));
+    if (_resolve_latency_metric) {
+        _resolve_latency_metric->Update(static_cast<double>(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count()));
+    }
+    return process;
+}
+
+// Queue the pid for the resolver threads and wait (up to _resolve_wait) for it to be added to the table.
+std::shared_ptr<ProcessTreeItem> ProcessTree::resolve_async(int pid, std::shared_ptr<ProcessTreeItem> process)
+{
+    std::unique_lock<std::mutex> resolve_lock(_resolve_mutex);
+    if (_resolve_pending.count(pid) == 0) {
+        if (_resolve_queue.size() >= MAX_RESOLVE_QUEUE) {
+            // The resolvers are too far behind, proceed with what we have
+            if (_resolve_timeout_metric) {
+                _resolve_timeout_metric->Update(1.0);
             }
+            return process;
+        }
+        _resolve_pending.emplace(pid, std::chrono::steady_clock::now());
+        _resolve_queue.emplace_back(pid);
+        _resolve_cond.notify_one();
+    }
+
+    if (_resolve_wait.count() <= 0) {
+        return process;
+    }
+
+    if (!_resolve_done_cond.wait_for(resolve_lock, _resolve_wait, [this,pid]() { return !_resolve_running || _resolve_pending.count(pid) == 0; })) {
+        if (_resolve_timeout_metric) {
+            _resolve_timeout_metric->Update(1.0);
+        }
+    }
+    resolve_lock.unlock();
+
+    auto resolved = _processes.Find(pid);
+    if (resolved) {
+        return resolved;
+    }
+    return process;
+}
+
+void ProcessTree::resolver_task()
+{
+    Signals::InitThread();
 
-            // If container ID is still empty, set it to be the cgroup container ID
-            if (process->_containerid.empty()) {
-                process->_containerid = process->_cgroupContainerId;                
+    std::unique_lock<std::mutex> resolve_lock(_resolve_mutex);
+    while (_resolve_running) {
+        _resolve_cond.wait(resolve_lock, [this]() { return !_resolve_running || !_resolve_queue.empty(); });
+        if (!_resolve_running) {
+            break;
+        }
+
+        auto pid = _resolve_queue.front();
+        _resolve_queue.pop_front();
+        resolve_lock.unlock();
+
+        // Do the /proc I/O without holding the write mutex
+        std::shared_ptr<ProcessTreeItem> process;
+        auto current = _processes.Find(pid);
+        if (!current || current->_source == ProcessTreeSource_pnotify) {
+            process = ReadProcEntry(pid);
+        }
+        if (process) {
+            std::lock_guard<std::mutex> process_write_lock(_process_write_mutex);
+            install_proc_entry(pid, process);
+        }
+        auto end = std::chrono::steady_clock::now();
+
+        resolve_lock.lock();
+        auto it = _resolve_pending.find(pid);
+        if (it != _resolve_pending.end()) {
+            if (_resolve_latency_metric) {
+                _resolve_latency_metric->Update(static_cast<double>(std::chrono::duration_cast<std::chrono::microseconds>(end - it->second).count()));
             }
+            _resolve_pending.erase(it);
+        }
+        _resolve_done_cond.notify_all();
+    }
+}
 
-            _processes[pid] = process;
-            ApplyFlags(process);
+/*
+ * Add an item read by ReadProcEntry() to the table, unless a better one was added since it was read.
+ * Returns the item now in the table for pid (nullptr if process is nullptr and there wasn't one).
+ * Must be called with _process_write_mutex held.
+ */
+std::shared_ptr<ProcessTreeItem> ProcessTree::install_proc_entry(int pid, const std::shared_ptr<ProcessTreeItem>& process)
+{
+    auto current = _processes.Find(pid);
+    if (!process || (current && current->_source != ProcessTreeSource_pnotify)) {
+        return current;
+    }
+
+    auto parentproc = _processes.Find(process->_ppid);
+    if (parentproc) {
+        parentproc->_children.emplace_back(pid);
+        if (!(parentproc->_containeridfromhostprocess).empty()) {
+            process->_containerid = parentproc->_containeridfromhostprocess;
+        } else {
+            process->_containerid = parentproc->_containerid;
         }
-        return process;
+        set_parent(*process, *parentproc);
     }
+
+    // If container ID is still empty, set it to be the cgroup container ID
+    if (process->_containerid.empty()) {
+        process->_containerid = process->_cgroupContainerId;
+    }
+
+    ApplyFlags(process);
+    _processes.Set(pid, process);
+    return process;
 }
 
+// Must only be called on an item that is not (yet) in _processes
+void ProcessTree::set_parent(ProcessTreeItem& process, const ProcessTreeItem& parent)
+{
+    process._ancestors = std::make_shared<const Ancestor>(parent._pid, parent._exe, parent._ancestors);
+}
+
+// Must only be called on an item that is not (yet) in _processes
 void ProcessTree::ApplyFlags(const std::shared_ptr<ProcessTreeItem>& process)
 {
     unsigned int height = 0;
     process->_flags = _filtersEngine->GetFlags(process, height);
     if (process->_flags.none()) {
-        std::vector<struct Ancestor>::reverse_iterator rit = process->_ancestors.rbegin();
-        for (; rit != process->_ancestors.rend() && process->_flags.none(); ++rit) {
+        for (auto a = process->_ancestors.get(); a != nullptr && process->_flags.none(); a = a->parent.get()) {
             height++;
-            auto it = _processes.find(rit->pid);
-            if (it != _processes.end()) {
-                process->_flags = _filtersEngine->GetFlags(it->second, height);
+            auto ancestor = _processes.Find(a->pid);
+            if (ancestor) {
+                process->_flags = _filtersEngine->GetFlags(ancestor, height);
             }
         }
     }
@@ -577,6 +782,9 @@ void ProcessTree::PopulateTree()
         return;
     }
 
+    // Build the tree privately then publish it once complete
+    std::unordered_map<int, std::shared_ptr<ProcessTreeItem>> processes;
+
     while (pinfo->next()) {
 
         pid = pinfo->pid();
@@ -586,66 +794,72 @@ void ProcessTree::PopulateTree()
         exe = pinfo->exe();
         pinfo->format_cmdline(cmdline);
 
-        auto process = std::make_shared<ProcessTreeItem>(ProcessTreeSource_procfs, pid, ppid, uid, gid, exe, cmdline);
-        process->_containeridfromhostprocess = ExtractContainerId(exe, cmdline);
-        _processes[pid] = process;
+        auto process = std::make_shared<ProcessTreeItem>(ProcessTreeSource_procfs, pid, ppid, uid, gid, _strings.Intern(exe), _strings.Intern(cmdline));
+        process->_containeridfromhostprocess = _strings.Intern(ExtractContainerId(exe, cmdline));
+        processes[pid] = process;
     }
 
-    for (auto& p : _processes) {
+    for (auto& p : processes) {
         auto process = p.second;
-        auto it = _processes.find(process->_ppid);
-        if (it != _processes.end()) {
+        auto it = processes.find(process->_ppid);
+        if (it != processes.end() && it->second != process) {
             it->second->_children.emplace_back(process->_pid);
         }
     }
 
-    for (auto& p : _processes) {
-        std::shared_ptr<ProcessTreeItem> process, parent;
-        process = p.second;
-        auto it = _processes.find(process->_ppid);
-        if (it != _processes.end()) {
-            parent = it->second;
-        } else {
-            parent = nullptr;
+    // Build the ancestor chains, parents before their children
+    std::unordered_set<int> linked;
+    std::vector<std::shared_ptr<ProcessTreeItem>> path;
+    for (auto& p : processes) {
+        path.clear();
+        auto process = p.second;
+        while (process && linked.count(process->_pid) == 0) {
+            linked.emplace(process->_pid);
+            path.emplace_back(process);
+            auto it = processes.find(process->_ppid);
+            process = (it != processes.end() && it->second != process) ? it->second : nullptr;
         }
-        while (parent) {
-            process->_ancestors.insert(process->_ancestors.begin(), {parent->_pid, parent->_exe});
-            auto it2 = _processes.find(parent->_ppid);
-            if (it2 != _processes.end()) {
-                parent = it2->second;
-            } else {
-                parent = nullptr;
+        for (auto it = path.rbegin(); it != path.rend(); ++it) {
+            auto parent = processes.find((*it)->_ppid);
+            if (parent != processes.end() && parent->second != *it) {
+                set_parent(**it, *parent->second);
             }
         }
     }
      // Populate containerid
-    for (auto& p : _processes) {
+    for (auto& p : processes) {
         auto process = p.second;
         if( !(process->_containeridfromhostprocess).empty()) {
-            SetContainerId(process, process->_containeridfromhostprocess);
+            SetContainerId(processes, process, process->_containeridfromhostprocess);
         }
     }
+
+    for (auto& p : processes) {
+        _processes.Set(p.first, p.second);
+    }
 }
 
 void ProcessTree::UpdateFlags() {
     std::unique_lock<std::mutex> process_write_lock(_process_write_mutex);
 
-    for (auto& p : _processes) {
-        ApplyFlags(p.second);
+    for (auto& item : _processes.Items()) {
+        auto process = std::make_shared<ProcessTreeItem>(*item);
+        ApplyFlags(process);
+        _processes.Set(process->_pid, process);
     }
 }
 
 // This utility method gets called only during the initial population of ProcessTree when a containerid shim process is identfied with non-empty value of _containeridfromhostprocess.
 // All of its childrens get assigned with the ContainerId value recursively.
 // ContainerId is not set for the containerid shim process.
-void ProcessTree::SetContainerId(const std::shared_ptr<ProcessTreeItem>& p, const std::string& containerid)
+void ProcessTree::SetContainerId(std::unordered_map<int, std::shared_ptr<ProcessTreeItem>>& processes, const std::shared_ptr<ProcessTreeItem>& p, const InternedString& containerid)
 {
     for (auto c : p->_children) {
-        auto it2 = _processes.find(c);
-        if (it2 != _processes.end()) {
+        auto it2 = processes.find(c);
+        if (it2 != processes.end()) {
             auto cp = it2->second;
             cp->_containerid = containerid;
-            SetContainerId(cp, containerid);
+            SetContainerId(processes, cp, containerid);
         }
     }
 }
@@ -700,21 +914,24 @@ std::shared_ptr<ProcessTreeItem> ProcessTree::ReadProcEntry(int pid)
     process->_uid = pinfo->uid();
     process->_gid = pinfo->gid();
     process->_ppid = pinfo->ppid();
-    process->_exe = pinfo->exe();
-    process->_cgroupContainerId = pinfo->container_id();
-    pinfo->format_cmdline(process->_cmdline);
-    process->_containeridfromhostprocess = ExtractContainerId(process->_exe, process->_cmdline);
+    std::string exe = pinfo->exe();
+    std::string cmdline;
+    pinfo->format_cmdline(cmdline);
+    process->_exe = _strings.Intern(exe);
+    process->_cmdline = _strings.Intern(cmdline);
+    process->_cgroupContainerId = _strings.Intern(pinfo->container_id());
+    process->_containeridfromhostprocess = _strings.Intern(ExtractContainerId(exe, cmdline));
     return process;
 }
 
 
 void ProcessTree::ShowTree()
 {
-    for (auto& p : _processes) {
-        ShowProcess(p.second);
-        for (auto c : p.second->_children) {
-            if (_processes.count(c) > 0) {
-                auto p2 = _processes[c];
+    for (auto& p : _processes.Items()) {
+        ShowProcess(p);
+        for (auto c : p->_children) {
+            auto p2 = _processes.Find(c);
+            if (p2) {
                 printf("    => ");
                 ShowProcess(p2);
             }
@@ -724,17 +941,20 @@ void ProcessTree::ShowTree()
 
 void ProcessTree::ShowProcess(std::shared_ptr<ProcessTreeItem> p)
 {
-    if (_processes.count(p->_ppid) > 0) {
-        printf("%6d (%6d) [%d:%d] exe:'%s' cmdline:'%s' prop:%d (%s)\n", p->_pid, p->_ppid, p->_uid, p->_gid, p->_exe.c_str(), p->_cmdline.c_str(), p->_exec_propagation, _processes[p->_ppid]->_exe.c_str());
+    auto parent = _processes.Find(p->_ppid);
+    if (parent) {
+        printf("%6d (%6d) [%d:%d] exe:'%s' cmdline:'%s' prop:%d (%s)\n", p->_pid, p->_ppid, p->_uid, p->_gid, p->_exe.str().c_str(), p->_cmdline.str().c_str(), p->_exec_propagation, parent->_exe.str().c_str());
     } else {
-        printf("%6d (%6d) [%d:%d] exe:'%s' cmdline:'%s' prop:%d\n", p->_pid, p->_ppid, p->_uid, p->_gid, p->_exe.c_str(), p->_cmdline.c_str(), p->_exec_propagation);
+        printf("%6d (%6d) [%d:%d] exe:'%s' cmdline:'%s' prop:%d\n", p->_pid, p->_ppid, p->_uid, p->_gid, p->_exe.str().c_str(), p->_cmdline.str().c_str(), p->_exec_propagation);
     }
     printf("  -> flags = %s\n", p->_flags.to_string().c_str());
     printf("  -> ");
-    for (auto i : p->_ancestors) {
-        printf("%s(%d), ", i.exe.c_str(), i.pid);
+    std::vector<const Ancestor*> ancestors;
+    for (auto a = p->_ancestors.get(); a != nullptr; a = a->parent.get()) {
+        ancestors.emplace_back(a);
+    }
+    for (auto it = ancestors.rbegin(); it != ancestors.rend(); ++it) {
+        printf("%s(%d), ", (*it)->exe.str().c_str(), (*it)->pid);
     }
-    printf("%s(%d)\n", p->_exe.c_str(), p->_pid);
+    printf("%s(%d)\n", p->_exe.str().c_str(), p->_pid);
 }
-
-
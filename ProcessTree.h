@@ -21,9 +21,14 @@
 #include "UserDB.h"
 #include "ProcessDefines.h"
 #include "FiltersEngine.h"
+#include "InternedString.h"
+#include "Metrics.h"
 
 #include <string>
 #include <unordered_map>
+#include <shared_mutex>
+#include <array>
+#include <atomic>
 #include <queue>
 #include <chrono>
 #include <algorithm>
@@ -124,67 +129,157 @@ enum ProcessTreeSource { ProcessTreeSource_execve, ProcessTreeSource_pnotify, Pr
 
 class FiltersEngine;
 
+class ProcessTree;
+
+/*
+ * An entry in a process's ancestor chain (nearest ancestor first). Only the pid and exe are kept, so a chain that
+ * outlives the ancestors' ProcessTreeItems (e.g. after they exit and are removed from the table) retains just these
+ * small nodes. Nodes are shared by all the descendants that were created under the same parent.
+ */
 struct Ancestor {
+    Ancestor(int pid, const InternedString& exe, std::shared_ptr<const Ancestor> parent):
+        pid(pid), exe(exe), parent(std::move(parent)) {
+        s_count.fetch_add(1, std::memory_order_relaxed);
+    }
+    Ancestor(const Ancestor&) = delete;
+    ~Ancestor() {
+        s_count.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    // The number of Ancestor nodes currently allocated, used for the process tree memory metric
+    static inline long Count() { return s_count.load(std::memory_order_relaxed); }
+
     int pid;
-    std::string exe;
-};
+    InternedString exe;
+    std::shared_ptr<const Ancestor> parent;
 
-class ProcessTree;
+private:
+    static std::atomic<long> s_count;
+};
 
+/*
+ * A ProcessTreeItem is immutable once it has been added to the ProcessTree's process table. Updates to the exe,
+ * cmdline, containerid, uid, gid, ppid or flags are made to a copy of the item which then replaces the original in the
+ * table. This lets the accessors return references without locking, and a caller holding the shared_ptr always sees a
+ * consistent view of the process. The string fields are interned in the ProcessTree's StringInternPool. The
+ * _children, _exec_propagation, _exited and _exit_time fields are not visible outside ProcessTree and are only
+ * modified while holding the ProcessTree write mutex.
+ */
 class ProcessTreeItem {
 public:
     ProcessTreeItem(enum ProcessTreeSource source, int pid, int ppid=0):
-        _source(source), _pid(pid), _ppid(ppid), _uid(-1), _gid(-1), _flags(0), _exec_propagation(0), _exited(false), _containerid("") {}
-    ProcessTreeItem(enum ProcessTreeSource source, int pid, int ppid, int uid, int gid, const std::string& exe, const std::string& cmdline):
-        _source(source), _pid(pid), _ppid(ppid), _uid(uid), _gid(gid), _exe(exe), _cmdline(cmdline), _containerid(""),
+        _source(source), _pid(pid), _ppid(ppid), _uid(-1), _gid(-1), _flags(0), _exec_propagation(0), _exited(false), _containerid() {}
+    ProcessTreeItem(enum ProcessTreeSource source, int pid, int ppid, int uid, int gid, const InternedString& exe, const InternedString& cmdline):
+        _source(source), _pid(pid), _ppid(ppid), _uid(uid), _gid(gid), _exe(exe), _cmdline(cmdline), _containerid(),
         _flags(0), _exec_propagation(0), _exited(false) {}
+    ProcessTreeItem(const ProcessTreeItem&) = default;
 
-    inline int pid() { return _pid; }
-    inline int ppid() { return _ppid; }
-    inline int uid() { return _uid; }
-    inline int gid() { return _gid; }
-
-    inline std::string exe() {
-        std::lock_guard<std::mutex> _lock(_mutex);
-        return _exe;
-    }
-
-    inline std::string cmdline() {
-        std::lock_guard<std::mutex> _lock(_mutex);
-        return _cmdline;
-    }
-
-    inline std::string containerid() {
-        std::lock_guard<std::mutex> _lock(_mutex);
-        return _containerid;
-    }
+    inline int pid() const { return _pid; }
+    inline int ppid() const { return _ppid; }
+    inline int uid() const { return _uid; }
+    inline int gid() const { return _gid; }
 
-    inline std::bitset<FILTER_BITSET_SIZE> flags() {
-        std::lock_guard<std::mutex> _lock(_mutex);
-        return _flags;
-    }
+    inline const std::string& exe() const { return _exe.str(); }
+    inline const std::string& cmdline() const { return _cmdline.str(); }
+    inline const std::string& containerid() const { return _containerid.str(); }
+    inline const std::bitset<FILTER_BITSET_SIZE>& flags() const { return _flags; }
 
 protected:
     friend class ProcessTree;
-    std::mutex _mutex;
     enum ProcessTreeSource _source;
     int _pid;
     int _ppid;
     int _uid;
     int _gid;
     std::vector<int> _children;
-    std::vector<struct Ancestor> _ancestors;
+    std::shared_ptr<const Ancestor> _ancestors;
     unsigned int _exec_propagation;
-    std::string _exe;
-    std::string _containerid;
-    std::string _containeridfromhostprocess;
-    std::string _cgroupContainerId;
-    std::string _cmdline;
+    InternedString _exe;
+    InternedString _containerid;
+    InternedString _containeridfromhostprocess;
+    InternedString _cgroupContainerId;
+    InternedString _cmdline;
     std::bitset<FILTER_BITSET_SIZE> _flags;
     bool _exited;
     std::chrono::system_clock::time_point _exit_time;
 };
 
+/*
+ * pid -> ProcessTreeItem map split into shards, each guarded by its own reader/writer lock, so lookups from the event
+ * processing threads only ever take a shared lock on one shard and never wait on the ProcessTree write mutex.
+ */
+class ProcessTable {
+public:
+    static constexpr size_t NUM_SHARDS = 16;
+
+    std::shared_ptr<ProcessTreeItem> Find(int pid) const {
+        auto& shard = get_shard(pid);
+        std::shared_lock<std::shared_mutex> lock(shard._mutex);
+        auto it = shard._items.find(pid);
+        if (it != shard._items.end()) {
+            return it->second;
+        }
+        return nullptr;
+    }
+
+    void Set(int pid, std::shared_ptr<ProcessTreeItem> item) {
+        auto& shard = get_shard(pid);
+        std::unique_lock<std::shared_mutex> lock(shard._mutex);
+        shard._items[pid] = std::move(item);
+    }
+
+    void Erase(int pid) {
+        auto& shard = get_shard(pid);
+        std::unique_lock<std::shared_mutex> lock(shard._mutex);
+        shard._items.erase(pid);
+    }
+
+    size_t Size() const {
+        size_t size = 0;
+        for (auto& shard : _shards) {
+            std::shared_lock<std::shared_mutex> lock(shard._mutex);
+            size += shard._items.size();
+        }
+        return size;
+    }
+
+    // Return a copy of all the items currently in the table
+    std::vector<std::shared_ptr<ProcessTreeItem>> Items() const {
+        std::vector<std::shared_ptr<ProcessTreeItem>> items;
+        for (auto& shard : _shards) {
+            std::shared_lock<std::shared_mutex> lock(shard._mutex);
+            items.reserve(items.size() + shard._items.size());
+            for (auto& e : shard._items) {
+                items.emplace_back(e.second);
+            }
+        }
+        return items;
+    }
+
+    std::vector<int> Pids() const {
+        std::vector<int> pids;
+        for (auto& shard : _shards) {
+            std::shared_lock<std::shared_mutex> lock(shard._mutex);
+            pids.reserve(pids.size() + shard._items.size());
+            for (auto& e : shard._items) {
+                pids.emplace_back(e.first);
+            }
+        }
+        return pids;
+    }
+
+private:
+    struct alignas(64) Shard {
+        mutable std::shared_mutex _mutex;
+        std::unordered_map<int, std::shared_ptr<ProcessTreeItem>> _items;
+    };
+
+    inline Shard& get_shard(int pid) { return _shards[static_cast<unsigned int>(pid) % NUM_SHARDS]; }
+    inline const Shard& get_shard(int pid) const { return _shards[static_cast<unsigned int>(pid) % NUM_SHARDS]; }
+
+    std::array<Shard, NUM_SHARDS> _shards;
+};
+
 // Class that monitors pnotify events and writes them to ProcessTree queues
 class ProcessNotify: public RunBase {
 public:
@@ -213,7 +308,11 @@ struct ProcessQueueItem {
 // Class that manages the process tree
 class ProcessTree: public RunBase {
 public:
-    ProcessTree(const std::shared_ptr<UserDB>& user_db, std::shared_ptr<FiltersEngine> filtersEngine): _user_db(user_db), _filtersEngine(filtersEngine), _queue_data_ready(false)
+    static constexpr long DEFAULT_RESOLVE_WAIT = 10; // milliseconds
+    static constexpr size_t MAX_RESOLVE_QUEUE = 4096;
+
+    ProcessTree(const std::shared_ptr<UserDB>& user_db, std::shared_ptr<FiltersEngine> filtersEngine): _user_db(user_db), _filtersEngine(filtersEngine), _queue_data_ready(false), _verify_pos(0),
+        _num_resolver_threads(0), _resolve_wait(DEFAULT_RESOLVE_WAIT), _resolve_running(false)
     {
         _last_clean_time = std::chrono::system_clock::now();
     }
@@ -222,6 +321,8 @@ public:
     void AddPnExecQueue(int pid);
     void AddPnExitQueue(int pid);
     std::shared_ptr<ProcessTreeItem> AddProcess(enum ProcessTreeSource source, int pid, int ppid, int uid, int gid, const std::string& exe, const std::string& cmdline);
+    // Remove processes that exited more than CLEAN_PROCESS_TIMEOUT seconds ago, and check the next batch of
+    // pids for processes whose exit was missed.
     void Clean();
     std::shared_ptr<ProcessTreeItem> GetInfoForPid(int pid);
     void PopulateTree();
@@ -230,9 +331,31 @@ public:
     void ShowProcess(std::shared_ptr<ProcessTreeItem> p);
     static std::string ExtractContainerId(const std::string& exe, const std::string& cmdline);
 
+    // Updated (by Clean()) with the estimated memory used by the process tree items and strings, and the
+    // memory saved by interning the strings.
+    void SetMemoryMetrics(const std::shared_ptr<Metric>& memory_metric, const std::shared_ptr<Metric>& saved_metric) {
+        _memory_metric = memory_metric;
+        _memory_saved_metric = saved_metric;
+    }
+
+    /*
+     * Read the /proc entries of pids that GetInfoForPid() doesn't find (or only has pnotify info for) on num_threads
+     * background threads instead of on the caller's thread while holding the write mutex. On a miss the pid is
+     * queued and the caller waits at most max_wait for it to be resolved, then gets whatever is in the table at
+     * that point (the pnotify item, or nullptr). A max_wait of 0 never waits. Misses are resolved inline until the
+     * ProcessTree is started, or if num_threads is 0. Must be called before Start().
+     */
+    void EnableAsyncResolve(int num_threads, std::chrono::milliseconds max_wait);
+
+    // hit_metric and miss_metric are updated with the number of GetInfoForPid() table hits/misses, timeout_metric
+    // with the number of misses that were not resolved within max_wait, and latency_metric with the time
+    // (in microseconds) from a miss to the /proc entry being added to the table.
+    void SetResolveMetrics(const std::shared_ptr<Metric>& hit_metric, const std::shared_ptr<Metric>& miss_metric,
+                           const std::shared_ptr<Metric>& timeout_metric, const std::shared_ptr<Metric>& latency_metric);
 
 protected:
     void on_stopping() override;
+    void on_stop() override;
     void run() override;
 
 private:
@@ -240,18 +363,51 @@ private:
     void AddPid(int pid);
     void RemovePid(int pid);
     std::shared_ptr<ProcessTreeItem> ReadProcEntry(int pid);
+    std::shared_ptr<ProcessTreeItem> install_proc_entry(int pid, const std::shared_ptr<ProcessTreeItem>& process);
+    std::shared_ptr<ProcessTreeItem> resolve_async(int pid, std::shared_ptr<ProcessTreeItem> process);
+    void resolver_task();
     void ApplyFlags(const std::shared_ptr<ProcessTreeItem>& process);
-    void SetContainerId(const std::shared_ptr<ProcessTreeItem>& p, const std::string& containerid);
+    // Set process's ancestor chain to parent followed by parent's ancestors
+    static void set_parent(ProcessTreeItem& process, const ProcessTreeItem& parent);
+    static void SetContainerId(std::unordered_map<int, std::shared_ptr<ProcessTreeItem>>& processes, const std::shared_ptr<ProcessTreeItem>& p, const InternedString& containerid);
+    void expire_exited(std::chrono::system_clock::time_point now);
+    void verify_exited();
+    void update_memory_metrics();
 
     std::shared_ptr<UserDB> _user_db;
     std::shared_ptr<FiltersEngine> _filtersEngine;
-    std::unordered_map<int, std::shared_ptr<ProcessTreeItem>> _processes;
+    ProcessTable _processes;
+    StringInternPool _strings;
+    std::shared_ptr<Metric> _memory_metric;
+    std::shared_ptr<Metric> _memory_saved_metric;
     bool _queue_data_ready;
     std::mutex _queue_mutex;
+    // Serializes all updates to _processes (and the writer-only fields of the items in it).
+    // Lookups that find a usable item do not take this lock.
     std::mutex _process_write_mutex;
     std::condition_variable _queue_data;
     std::queue<struct ProcessQueueItem> _PnQueue;
     std::chrono::system_clock::time_point _last_clean_time;
+    // (exit time, pid) of exited processes, in exit order. Guarded by _process_write_mutex.
+    std::deque<std::pair<std::chrono::system_clock::time_point, int>> _exit_queue;
+    // Pids still to be checked by the current verify_exited() pass. Only used by Clean().
+    std::vector<int> _verify_pids;
+    size_t _verify_pos;
+
+    int _num_resolver_threads;
+    std::chrono::milliseconds _resolve_wait;
+    bool _resolve_running;
+    std::mutex _resolve_mutex;
+    std::condition_variable _resolve_cond;
+    std::condition_variable _resolve_done_cond;
+    std::deque<int> _resolve_queue;
+    // pid -> time of the miss, for pids that are queued or being resolved
+    std::unordered_map<int, std::chrono::steady_clock::time_point> _resolve_pending;
+    std::vector<std::thread> _resolver_threads;
+    std::shared_ptr<Metric> _resolve_hit_metric;
+    std::shared_ptr<Metric> _resolve_miss_metric;
+    std::shared_ptr<Metric> _resolve_timeout_metric;
+    std::shared_ptr<Metric> _resolve_latency_metric;
 };
 
 #endif //AUOMS_PROCESSTREE_H
@@ -20,7 +20,9 @@
 #include "ProcessTree.h"
 #include "Logger.h"
 #include "StringUtils.h"
+#include "Signals.h"
 #include <vector>
+#include <sys/wait.h>
 
 struct testCase {
     std::string exe;
@@ -46,3 +48,110 @@ BOOST_AUTO_TEST_CASE( basic_test ) {
         BOOST_REQUIRE_EQUAL(res, containerid);
     }
 }
+
+BOOST_AUTO_TEST_CASE( update_replaces_item_test ) {
+    auto filtersEngine = std::make_shared<FiltersEngine>();
+    auto processTree = std::make_shared<ProcessTree>(nullptr, filtersEngine);
+
+    auto first = processTree->AddProcess(ProcessTreeSource_execve, 1000, 1, 0, 0, "/usr/bin/first", "first -a");
+    auto second = processTree->AddProcess(ProcessTreeSource_execve, 1000, 1, 0, 0, "/usr/bin/second", "second -b");
+
+    // Items are not modified once added, an earlier reference continues to see the old values
+    BOOST_REQUIRE_EQUAL(first->exe(), "/usr/bin/first");
+    BOOST_REQUIRE_EQUAL(first->cmdline(), "first -a");
+    BOOST_REQUIRE_EQUAL(second->exe(), "/usr/bin/second");
+    BOOST_REQUIRE_EQUAL(second->cmdline(), "second -b");
+
+    auto current = processTree->GetInfoForPid(1000);
+    BOOST_REQUIRE(current == second);
+}
+
+BOOST_AUTO_TEST_CASE( ancestor_chain_test ) {
+    auto base_count = Ancestor::Count();
+    {
+        auto filtersEngine = std::make_shared<FiltersEngine>();
+        auto processTree = std::make_shared<ProcessTree>(nullptr, filtersEngine);
+
+        auto parent = processTree->AddProcess(ProcessTreeSource_execve, 1000, 1, 0, 0, "/usr/bin/parent", "parent");
+        auto child = processTree->AddProcess(ProcessTreeSource_execve, 1001, 1000, 0, 0, "/usr/bin/child", "child");
+        // pid 1 is not in the tree, so only the child has an ancestor
+        BOOST_REQUIRE_EQUAL(Ancestor::Count(), base_count + 1);
+
+        // The child's ancestor chain must not keep the replaced parent item alive
+        std::weak_ptr<ProcessTreeItem> old_parent = parent;
+        parent.reset();
+        processTree->AddProcess(ProcessTreeSource_execve, 1000, 1, 0, 0, "/usr/bin/parent2", "parent2");
+        BOOST_REQUIRE(old_parent.expired());
+    }
+    BOOST_REQUIRE_EQUAL(Ancestor::Count(), base_count);
+}
+
+BOOST_AUTO_TEST_CASE( async_resolve_test ) {
+    // RunBase uses SIGQUIT to interrupt the worker threads
+    Signals::Init();
+
+    auto filtersEngine = std::make_shared<FiltersEngine>();
+    auto processTree = std::make_shared<ProcessTree>(nullptr, filtersEngine);
+    processTree->EnableAsyncResolve(1, std::chrono::milliseconds(5000));
+    processTree->Start();
+
+    auto process = processTree->GetInfoForPid(getpid());
+    BOOST_REQUIRE(process != nullptr);
+    BOOST_REQUIRE_EQUAL(process->pid(), getpid());
+    BOOST_REQUIRE_EQUAL(process->ppid(), getppid());
+
+    // Once resolved the item is returned from the table
+    BOOST_REQUIRE(processTree->GetInfoForPid(getpid()) == process);
+
+    processTree->Stop();
+
+    // Not resolved by a stopped tree, misses are read inline
+    auto other = std::make_shared<ProcessTree>(nullptr, filtersEngine);
+    other->EnableAsyncResolve(1, std::chrono::milliseconds(0));
+    process = other->GetInfoForPid(getpid());
+    BOOST_REQUIRE(process != nullptr);
+    BOOST_REQUIRE_EQUAL(process->pid(), getpid());
+}
+
+BOOST_AUTO_TEST_CASE( clean_missed_exit_test ) {
+    auto filtersEngine = std::make_shared<FiltersEngine>();
+    auto processTree = std::make_shared<ProcessTree>(nullptr, filtersEngine);
+
+    // A pid that no longer exists, and whose exit was never reported
+    auto pid = fork();
+    BOOST_REQUIRE(pid >= 0);
+    if (pid == 0) {
+        _exit(0);
+    }
+    BOOST_REQUIRE_EQUAL(waitpid(pid, nullptr, 0), pid);
+
+    processTree->AddProcess(ProcessTreeSource_execve, pid, getpid(), 0, 0, "/usr/bin/gone", "gone");
+    processTree->AddProcess(ProcessTreeSource_execve, getpid(), getppid(), 0, 0, "/usr/bin/self", "self");
+
+    processTree->Clean();
+
+    BOOST_REQUIRE(processTree->GetInfoForPid(getpid()) != nullptr);
+    BOOST_REQUIRE_EQUAL(processTree->GetInfoForPid(getpid())->exe(), "/usr/bin/self");
+    BOOST_REQUIRE(processTree->GetInfoForPid(pid) == nullptr);
+}
+
+BOOST_AUTO_TEST_CASE( string_intern_pool_test ) {
+    StringInternPool pool;
+
+    auto a = pool.Intern("/usr/bin/bash");
+    auto b = pool.Intern(std::string("/usr/bin/bash"));
+    auto c = pool.Intern("/usr/bin/dash");
+    BOOST_REQUIRE_EQUAL(&a.str(), &b.str());
+    BOOST_REQUIRE(a == b);
+    BOOST_REQUIRE(a != c);
+    BOOST_REQUIRE(pool.Intern("").empty());
+
+    auto stats = pool.Purge();
+    BOOST_REQUIRE_EQUAL(stats.num_strings, 2);
+    BOOST_REQUIRE_EQUAL(stats.referenced_bytes - stats.pooled_bytes, sizeof(std::string) + a.str().capacity());
+
+    c = InternedString();
+    stats = pool.Purge();
+    BOOST_REQUIRE_EQUAL(stats.num_strings, 1);
+    BOOST_REQUIRE_EQUAL(pool.Size(), 1);
+}
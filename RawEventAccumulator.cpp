@@ -19,10 +19,40 @@
 #include "Translate.h"
 #include "Logger.h"
 
+std::unique_ptr<RawEventRecord> RawEventRecordPool::Alloc() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_free.empty()) {
+        return std::make_unique<RawEventRecord>();
+    }
+    auto record = std::move(_free.back());
+    _free.pop_back();
+    return record;
+}
+
+void RawEventRecordPool::Release(std::unique_ptr<RawEventRecord> record) {
+    if (!record) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_free.size() < _max_free) {
+        _free.emplace_back(std::move(record));
+    }
+}
+
+RawEvent::~RawEvent() {
+    for (auto& rec: _records) {
+        _pool->Release(std::move(rec));
+    }
+    for (auto& rec: _execve_records) {
+        _pool->Release(std::move(rec));
+    }
+}
+
 bool RawEvent::AddRecord(std::unique_ptr<RawEventRecord> record) {
     auto rtype = record->GetRecordType();
 
     if (rtype == RecordType::EOE) {
+        _pool->Release(std::move(record));
         return true;
     }
 
@@ -42,6 +72,7 @@ bool RawEvent::AddRecord(std::unique_ptr<RawEventRecord> record) {
                 }
                 _size-=_execve_records[idx]->GetSize();
                 _execve_size-=_execve_records[idx]->GetSize();
+                _pool->Release(std::move(_execve_records[idx]));
                 _execve_records.erase(_execve_records.begin()+idx);
             }
             _size += record->GetSize();
@@ -54,6 +85,7 @@ bool RawEvent::AddRecord(std::unique_ptr<RawEventRecord> record) {
     if (record->GetSize()+_size > MAX_EVENT_SIZE || _num_execve_records > MAX_NUM_EXECVE_RECORDS) {
         _num_dropped_records++;
         _drop_count[rtype]++;
+        _pool->Release(std::move(record));
     } else {
         _size += record->GetSize();
         _records.emplace_back(std::move(record));
@@ -82,7 +114,7 @@ int RawEvent::AddEvent(EventBuilder& builder) {
             builder.CancelEvent();
             return 0;
         }
-        _records[_syscall_rec_idx].reset(nullptr);
+        _pool->Release(std::move(_records[_syscall_rec_idx]));
     }
 
     for (std::unique_ptr<RawEventRecord>& rec: _records) {
@@ -134,11 +166,13 @@ bool RawEventAccumulator::AddRecord(std::unique_ptr<RawEventRecord> record) {
 
     // Drop empty records unless it is the EOE record.
     if (record->IsEmpty() && record->GetRecordType() != RecordType::EOE) {
+        _pool->Release(std::move(record));
         return false;
     }
 
     // Drop all USER_TTY records, these contain raw user tty and we don't want that data.
     if (record->GetRecordType() == RecordType::USER_TTY) {
+        _pool->Release(std::move(record));
         return false;
     }
 
@@ -154,7 +188,7 @@ bool RawEventAccumulator::AddRecord(std::unique_ptr<RawEventRecord> record) {
         }
     });
     if (!found) {
-        auto event = std::make_shared<RawEvent>(record->GetEventId());
+        auto event = std::make_shared<RawEvent>(record->GetEventId(), _pool);
         if (event->AddRecord(std::move(record))) {
             _event_metric->Update(1.0);
             if (event->AddEvent(*_builder) == -1) {
@@ -23,6 +23,23 @@
 
 #include <mutex>
 
+// Keeps a bounded free list of RawEventRecord so that the ~9KB record buffers are reused instead of being
+// allocated and freed for every record.
+class RawEventRecordPool {
+public:
+    static constexpr size_t DEFAULT_MAX_FREE = 256;
+
+    explicit RawEventRecordPool(size_t max_free = DEFAULT_MAX_FREE): _max_free(max_free) {}
+
+    std::unique_ptr<RawEventRecord> Alloc();
+    void Release(std::unique_ptr<RawEventRecord> record);
+
+private:
+    std::mutex _mutex;
+    size_t _max_free;
+    std::vector<std::unique_ptr<RawEventRecord>> _free;
+};
+
 class RawEvent {
 public:
     static constexpr size_t MAX_EVENT_SIZE = 112*1024; // Prevent runaway accumulation of records for an event
@@ -31,7 +48,8 @@ public:
     static constexpr size_t NUM_EXECVE_RH_PRESERVE = 3;
 
     RawEvent() = delete;
-    explicit RawEvent(EventId event_id): _event_id(event_id), _num_execve_records(0), _num_dropped_records(0), _syscall_rec_idx(-1), _size(0), _execve_size(0) {}
+    RawEvent(EventId event_id, const std::shared_ptr<RawEventRecordPool>& pool): _event_id(event_id), _pool(pool), _num_execve_records(0), _num_dropped_records(0), _syscall_rec_idx(-1), _size(0), _execve_size(0) {}
+    ~RawEvent();
 
     inline EventId GetEventId() { return _event_id; }
 
@@ -42,6 +60,7 @@ public:
 
 private:
     EventId _event_id;
+    std::shared_ptr<RawEventRecordPool> _pool;
     std::vector<std::unique_ptr<RawEventRecord>> _records;
     std::vector<std::unique_ptr<RawEventRecord>> _execve_records;
     std::unordered_map<RecordType, int> _drop_count;
@@ -54,13 +73,16 @@ private:
 
 class RawEventAccumulator {
 public:
-    explicit RawEventAccumulator(const std::shared_ptr<EventBuilder>& builder, const std::shared_ptr<Metrics>& metrics): _builder(builder), _metrics(metrics) {
-        _bytes_metric = _metrics->AddMetric(MetricType::METRIC_BY_ACCUMULATION, "raw_data", "bytes", MetricPeriod::SECOND, MetricPeriod::HOUR);
-        _record_metric = _metrics->AddMetric(MetricType::METRIC_BY_ACCUMULATION, "raw_data", "records", MetricPeriod::SECOND, MetricPeriod::HOUR);
-        _event_metric = _metrics->AddMetric(MetricType::METRIC_BY_ACCUMULATION, "raw_data", "events", MetricPeriod::SECOND, MetricPeriod::HOUR);
-        _dropped_event_metric = _metrics->AddMetric(MetricType::METRIC_BY_ACCUMULATION, "raw_data", "dropped_events", MetricPeriod::SECOND, MetricPeriod::HOUR);
+    explicit RawEventAccumulator(const std::shared_ptr<EventBuilder>& builder, const std::shared_ptr<Metrics>& metrics): _builder(builder), _metrics(metrics), _pool(std::make_shared<RawEventRecordPool>()) {
+        _bytes_metric = _metrics->AddMetric(MetricType::METRIC_BY_COUNTER, "raw_data", "bytes", MetricPeriod::SECOND, MetricPeriod::HOUR);
+        _record_metric = _metrics->AddMetric(MetricType::METRIC_BY_COUNTER, "raw_data", "records", MetricPeriod::SECOND, MetricPeriod::HOUR);
+        _event_metric = _metrics->AddMetric(MetricType::METRIC_BY_COUNTER, "raw_data", "events", MetricPeriod::SECOND, MetricPeriod::HOUR);
+        _dropped_event_metric = _metrics->AddMetric(MetricType::METRIC_BY_COUNTER, "raw_data", "dropped_events", MetricPeriod::SECOND, MetricPeriod::HOUR);
     }
 
+    // Returns a (possibly recycled) record. Records passed to AddRecord() are returned to the pool once they are no longer needed.
+    inline std::unique_ptr<RawEventRecord> AllocRecord() { return _pool->Alloc(); }
+
     bool AddRecord(std::unique_ptr<RawEventRecord> record);
     void Flush(long milliseconds);
 
@@ -69,6 +91,7 @@ private:
     std::mutex _mutex;
     std::shared_ptr<EventBuilder> _builder;
     std::shared_ptr<Metrics> _metrics;
+    std::shared_ptr<RawEventRecordPool> _pool;
     std::shared_ptr<Metric> _bytes_metric;
     std::shared_ptr<Metric> _record_metric;
     std::shared_ptr<Metric> _event_metric;
@@ -33,9 +33,18 @@
 // This value mirrors what is defined for AUDIT_KEY_SEPARATOR in libaudit.h
 #define KEY_SEP 0x01
 
-#define PROCESS_INVENTORY_EVENT_INTERVAL 3600
-
 void RawEventProcessor::ProcessData(const void* data, size_t data_len) {
+    auto start = std::chrono::steady_clock::now();
+    try {
+        process_data(data, data_len);
+    } catch (...) {
+        _processing_time_metric->Update(static_cast<double>(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count()));
+        throw;
+    }
+    _processing_time_metric->Update(static_cast<double>(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count()));
+}
+
+void RawEventProcessor::process_data(const void* data, size_t data_len) {
 
     Event event(data, data_len);
 
@@ -100,12 +109,13 @@ void RawEventProcessor::process_event(const Event& event) {
                 throw std::runtime_error("Queue closed");
             }
 
-            std::string containerId = "";
+            std::shared_ptr<ProcessTreeItem> p;
+            std::string_view containerId;
             if (pid_field) {
                 _pid = atoi(pid_field.RawValuePtr());
                 _builder->SetEventPid(_pid);
                 if (_processTree) {
-                    auto p = _processTree->GetInfoForPid(_pid);
+                    p = _processTree->GetInfoForPid(_pid);
                     if (p) {
                         containerId = p->containerid();
                     }
@@ -699,7 +709,7 @@ bool RawEventProcessor::process_syscall_event(const Event& event) {
     std::shared_ptr<ProcessTreeItem> p;
     std::string cmdline;
 
-    std::string containerid;
+    std::string_view containerid;
 
     if (_processTree) {
         if (!_syscall.empty() && starts_with(_syscall, "execve")) {
@@ -931,7 +941,7 @@ bool RawEventProcessor::add_gid_field(const std::string_view& name, int gid, fie
     return true;
 }
 
-bool RawEventProcessor::generate_proc_event(ProcessInfo* pinfo, uint64_t sec, uint32_t msec) {
+bool RawEventProcessor::GenerateProcessInventoryEvent(ProcessInfo* pinfo, uint64_t sec, uint32_t msec) {
     using namespace std::literals::string_view_literals;
 
     if (!_builder->BeginEvent(sec, msec, 0, 1)) {
@@ -1030,27 +1040,3 @@ bool RawEventProcessor::generate_proc_event(ProcessInfo* pinfo, uint64_t sec, ui
     }
     return true;
 }
-
-void RawEventProcessor::DoProcessInventory() {
-    struct timeval tv;
-    gettimeofday(&tv, nullptr);
-
-    uint64_t sec = static_cast<uint64_t>(tv.tv_sec);
-    uint32_t msec = static_cast<uint32_t>(tv.tv_usec)/1000;
-
-    if (_last_proc_event_gen+PROCESS_INVENTORY_EVENT_INTERVAL > sec) {
-        return;
-    }
-
-    auto pinfo = ProcessInfo::Open(64*1024);
-    if (!pinfo) {
-        Logger::Error("Failed to open '/proc': %s", strerror(errno));
-        return;
-    }
-
-    while(pinfo->next()) {
-        generate_proc_event(pinfo.get(), sec, msec);
-    }
-
-    _last_proc_event_gen = sec;
-}
@@ -28,19 +28,23 @@ class RawEventProcessor {
 public:
     RawEventProcessor(const std::shared_ptr<EventBuilder>& builder, const std::shared_ptr<UserDB>& user_db, const std::shared_ptr<CmdlineRedactor>& cmdline_redactor, const std::shared_ptr<ProcessTree>& processTree, const std::shared_ptr<FiltersEngine> filtersEngine, const std::shared_ptr<Metrics>& metrics):
     _builder(builder), _user_db(user_db), _cmdline_redactor(cmdline_redactor), _state_ptr(nullptr), _processTree(processTree), _filtersEngine(filtersEngine), _metrics(metrics),
-        _event_flags(0), _pid(0), _ppid(0), _uid(-1), _last_proc_event_gen(0), _other_tag(0)
+        _event_flags(0), _pid(0), _ppid(0), _uid(-1), _other_tag(0)
     {
-        _bytes_metric = _metrics->AddMetric(MetricType::METRIC_BY_ACCUMULATION, "data", "bytes", MetricPeriod::SECOND, MetricPeriod::HOUR);
-        _record_metric = _metrics->AddMetric(MetricType::METRIC_BY_ACCUMULATION, "data", "records", MetricPeriod::SECOND, MetricPeriod::HOUR);
-        _event_metric = _metrics->AddMetric(MetricType::METRIC_BY_ACCUMULATION, "data", "events", MetricPeriod::SECOND, MetricPeriod::HOUR);
+        _bytes_metric = _metrics->AddMetric(MetricType::METRIC_BY_COUNTER, "data", "bytes", MetricPeriod::SECOND, MetricPeriod::HOUR);
+        _record_metric = _metrics->AddMetric(MetricType::METRIC_BY_COUNTER, "data", "records", MetricPeriod::SECOND, MetricPeriod::HOUR);
+        _event_metric = _metrics->AddMetric(MetricType::METRIC_BY_COUNTER, "data", "events", MetricPeriod::SECOND, MetricPeriod::HOUR);
+        _processing_time_metric = _metrics->AddMetric(MetricType::METRIC_HISTOGRAM, "data", "event_processing_usec", MetricPeriod::SECOND, MetricPeriod::HOUR);
     }
 
     void ProcessData(const void* data, size_t data_len);
-    void DoProcessInventory();
+
+    // Emit an AUOMS_PROCESS_INVENTORY event for the process pinfo is positioned on
+    bool GenerateProcessInventoryEvent(ProcessInfo* pinfo, uint64_t sec, uint32_t msec);
 
 private:
     void end_event();
     void cancel_event();
+    void process_data(const void* data, size_t data_len);
     void process_event(const Event& event);
     bool process_syscall_event(const Event& event);
     void process_user_cmd_record(const Event& event, const EventRecord& record);
@@ -49,7 +53,6 @@ private:
     bool add_uid_field(const std::string_view& name, int uid, field_type_t ft);
     bool add_gid_field(const std::string_view& name, int gid, field_type_t ft);
     bool add_str_field(const std::string_view& name, const std::string_view& val, field_type_t ft);
-    bool generate_proc_event(ProcessInfo* pinfo, uint64_t sec, uint32_t nsec);
 
     std::shared_ptr<EventBuilder> _builder;
     std::shared_ptr<UserDB> _user_db;
@@ -61,6 +64,7 @@ private:
     std::shared_ptr<Metric> _bytes_metric;
     std::shared_ptr<Metric> _record_metric;
     std::shared_ptr<Metric> _event_metric;
+    std::shared_ptr<Metric> _processing_time_metric;
     uint32_t _event_flags;
     pid_t _pid;
     pid_t _ppid;
@@ -78,7 +82,6 @@ private:
     std::string _path_mode;
     std::string _path_ouid;
     std::string _path_ogid;
-    uint64_t _last_proc_event_gen;
     ExecveConverter _execve_converter;
     uint64_t _other_tag;
     std::unordered_map<uint32_t, std::pair<uint64_t,uint32_t>> _other_rtype_counts;
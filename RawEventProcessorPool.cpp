@@ -0,0 +1,129 @@
+/*
+    microsoft-oms-auditd-plugin
+
+    Copyright (c) Microsoft Corporation
+
+    All rights reserved.
+
+    MIT License
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "RawEventProcessorPool.h"
+#include "Logger.h"
+
+#include <algorithm>
+
+RawEventProcessorPool::RawEventProcessorPool(size_t num_workers, size_t queue_depth, const builder_factory_t& builder_factory,
+                                             const std::shared_ptr<UserDB>& user_db, const std::shared_ptr<CmdlineRedactor>& cmdline_redactor,
+                                             const std::shared_ptr<ProcessTree>& processTree, const std::shared_ptr<FiltersEngine>& filtersEngine,
+                                             const std::shared_ptr<Metrics>& metrics): _workers(), _failed(false)
+{
+    num_workers = std::max(num_workers, static_cast<size_t>(1));
+    queue_depth = std::max(queue_depth, static_cast<size_t>(1));
+    for (size_t i = 0; i < num_workers; ++i) {
+        auto processor = std::make_unique<RawEventProcessor>(builder_factory(), user_db, cmdline_redactor, processTree, filtersEngine, metrics);
+        _workers.emplace_back(std::make_unique<Worker>(this, queue_depth, std::move(processor)));
+    }
+}
+
+RawEventProcessorPool::~RawEventProcessorPool() {
+    Stop();
+}
+
+void RawEventProcessorPool::Start() {
+    for (auto& worker : _workers) {
+        worker->Start();
+    }
+}
+
+void RawEventProcessorPool::Stop() {
+    for (auto& worker : _workers) {
+        worker->Stop();
+    }
+}
+
+bool RawEventProcessorPool::ProcessData(const void* data, size_t data_len) {
+    if (_failed.load(std::memory_order_relaxed)) {
+        return false;
+    }
+    auto pid = GetEventPid(data, data_len);
+    return _workers[static_cast<size_t>(pid) % _workers.size()]->Put(data, data_len);
+}
+
+int RawEventProcessorPool::GetEventPid(const void* data, size_t data_len) {
+    Event event(data, data_len);
+    if (event.Validate() != 0 || event.NumRecords() == 0) {
+        return 0;
+    }
+    auto field = event.begin().FieldByName("pid");
+    if (!field) {
+        return 0;
+    }
+    auto pid = atoi(field.RawValuePtr());
+    return pid > 0 ? pid : 0;
+}
+
+RawEventProcessorPool::Worker::Worker(RawEventProcessorPool* pool, size_t queue_depth, std::unique_ptr<RawEventProcessor> processor):
+    _pool(pool), _processor(std::move(processor)), _slots(queue_depth), _head(0), _tail(0), _count(0), _closed(false)
+{}
+
+bool RawEventProcessorPool::Worker::Put(const void* data, size_t data_len) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _cond.wait(lock, [this]() { return _closed || _count < _slots.size(); });
+    if (_closed) {
+        return false;
+    }
+    auto ptr = reinterpret_cast<const uint8_t*>(data);
+    _slots[_head].assign(ptr, ptr + data_len);
+    _head = (_head + 1) % _slots.size();
+    _count++;
+    _cond.notify_all();
+    return true;
+}
+
+void RawEventProcessorPool::Worker::on_stopping() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _closed = true;
+    _cond.notify_all();
+}
+
+void RawEventProcessorPool::Worker::run() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    for (;;) {
+        _cond.wait(lock, [this]() { return _closed || _count > 0; });
+        if (_count == 0) {
+            // Closed, and all queued events have been processed
+            return;
+        }
+
+        // The slot is not reused until _count is decremented, so it is safe to process it unlocked
+        auto& slot = _slots[_tail];
+        lock.unlock();
+        try {
+            _processor->ProcessData(slot.data(), slot.size());
+        } catch (const std::exception& ex) {
+            Logger::Error("Unexpected exception in event processor: %s", ex.what());
+            _pool->_failed = true;
+        } catch (...) {
+            Logger::Error("Unexpected exception in event processor");
+            _pool->_failed = true;
+        }
+        lock.lock();
+
+        _tail = (_tail + 1) % _slots.size();
+        _count--;
+        _cond.notify_all();
+
+        if (_pool->_failed) {
+            _closed = true;
+            _cond.notify_all();
+            return;
+        }
+    }
+}
@@ -0,0 +1,91 @@
+/*
+    microsoft-oms-auditd-plugin
+
+    Copyright (c) Microsoft Corporation
+
+    All rights reserved.
+
+    MIT License
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef AUOMS_RAWEVENTPROCESSORPOOL_H
+#define AUOMS_RAWEVENTPROCESSORPOOL_H
+
+#include "RawEventProcessor.h"
+#include "RunBase.h"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+
+/*
+ * Runs several RawEventProcessor instances, each on its own thread and with its own EventBuilder.
+ * Events are sharded across the workers by pid, so events for the same process are always
+ * processed in order, by the same worker.
+ */
+class RawEventProcessorPool {
+public:
+    static constexpr size_t DEFAULT_QUEUE_DEPTH = 128;
+
+    typedef std::function<std::shared_ptr<EventBuilder>()> builder_factory_t;
+
+    RawEventProcessorPool(size_t num_workers, size_t queue_depth, const builder_factory_t& builder_factory,
+                          const std::shared_ptr<UserDB>& user_db, const std::shared_ptr<CmdlineRedactor>& cmdline_redactor,
+                          const std::shared_ptr<ProcessTree>& processTree, const std::shared_ptr<FiltersEngine>& filtersEngine,
+                          const std::shared_ptr<Metrics>& metrics);
+    ~RawEventProcessorPool();
+
+    void Start();
+
+    // Process all queued events, then stop the workers.
+    void Stop();
+
+    /*
+     * Copy the event data into the queue of the worker responsible for the event's pid.
+     * Blocks while that worker's queue is full.
+     * Returns false if the pool has stopped, or a worker has exited due to an error.
+     */
+    bool ProcessData(const void* data, size_t data_len);
+
+    size_t NumWorkers() const { return _workers.size(); }
+
+    // Return the pid used to shard the event, or 0 if the event has no pid
+    static int GetEventPid(const void* data, size_t data_len);
+
+private:
+    class Worker: public RunBase {
+    public:
+        Worker(RawEventProcessorPool* pool, size_t queue_depth, std::unique_ptr<RawEventProcessor> processor);
+
+        bool Put(const void* data, size_t data_len);
+
+    protected:
+        void on_stopping() override;
+        void run() override;
+
+    private:
+        RawEventProcessorPool* _pool;
+        std::unique_ptr<RawEventProcessor> _processor;
+
+        std::mutex _mutex;
+        std::condition_variable _cond;
+        // A ring of reusable buffers, _head is the next slot to fill, _tail the next slot to process
+        std::vector<std::vector<uint8_t>> _slots;
+        size_t _head;
+        size_t _tail;
+        size_t _count;
+        bool _closed;
+    };
+
+    std::vector<std::unique_ptr<Worker>> _workers;
+    std::atomic<bool> _failed;
+};
+
+#endif //AUOMS_RAWEVENTPROCESSORPOOL_H
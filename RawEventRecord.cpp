@@ -15,6 +15,7 @@
 */
 
 #include <iostream>
+#include <charconv>
 
 #include "RawEventRecord.h"
 #include "Translate.h"
@@ -29,35 +30,28 @@ public:
     // Advance to the next space delimited text
     // _val is set, _key is blank
     bool next_text() {
-        static auto SV_WSP = " \n"sv;
-
         if (_idx == std::string_view::npos || _idx >= _str.size()) {
             return false;
         }
-        auto idx = _str.find_first_of(SV_WSP, _idx);
+        auto idx = find_first_of_chars<' ', '\n'>(_str, _idx);
         if (idx == std::string_view::npos) {
             idx = _str.size();
         }
         _val = _str.substr(_idx, idx-_idx);
-        _idx = _str.find_first_not_of(SV_WSP, idx);
+        _idx = find_first_not_of_chars<' ', '\n'>(_str, idx);
         return true;
     }
 
     // Advance to the next key=value
     bool next_kv() {
         static auto SV_MSG = "msg"sv;
-        static auto SV_WSP = " \n"sv;
-        static auto SV_WSPQ = "' \n"sv;
-        static auto SV_SP = " "sv;
-        static auto SV_EQ = "="sv;
-        static auto SV_DQ = "\""sv;
 
         if (_idx == std::string_view::npos || _idx >= _str.size()) {
             return false;
         }
 
         // Find the '='
-        auto idx = _str.find_first_of(SV_EQ, _idx);
+        auto idx = find_first_of_chars<'='>(_str, _idx);
         if (idx == std::string_view::npos) {
             // No '=' found, assume remainder of text is unparsable
             idx = _str.size();
@@ -77,7 +71,7 @@ public:
         } else {
             if (_str[_idx] == '"') {
                 // Value is double quoted, look for end quote
-                idx = _str.find_first_of(SV_DQ, _idx+1);
+                idx = find_first_of_chars<'"'>(_str, _idx+1);
                 if (idx == std::string_view::npos) {
                     idx = _str.size();
                 } else {
@@ -85,14 +79,14 @@ public:
                 }
             } else {
                 // Value is not double quoted, value ends at first white space or single quote
-                idx = _str.find_first_of(SV_WSPQ, _idx);
+                idx = find_first_of_chars<'\'', ' ', '\n'>(_str, _idx);
                 if (idx == std::string_view::npos) {
                     idx = _str.size();
                 }
             }
             _val = _str.substr(_idx, idx-_idx);
             // Advance _idx to start of next kv (skip past white space and single quote
-            _idx = _str.find_first_not_of(SV_WSPQ, idx);
+            _idx = find_first_not_of_chars<'\'', ' ', '\n'>(_str, idx);
         }
         return true;
     }
@@ -126,6 +120,7 @@ bool RawEventRecord::Parse(RecordType record_type, size_t size) {
     _size = size;
     _record_type = record_type;
     _record_fields.resize(0);
+    _unparsable = false;
     std::string_view str = std::string_view(_data.data(), _size);
     RecordFieldIterator itr(str);
     if (!itr.next_text()) {
@@ -182,18 +177,16 @@ bool RawEventRecord::Parse(RecordType record_type, size_t size) {
         auto sec_str = event_id_str.substr(0, pidx);
         auto msec_str = event_id_str.substr(pidx+1, 3);
         auto ser_str = event_id_str.substr(cidx+1);
-        try {
-            uint64_t sec = static_cast<uint64_t>(std::stoll(std::string(sec_str.data(), sec_str.size()), 0));
-            uint32_t msec = static_cast<uint32_t>(std::stoi(std::string(msec_str.data(), msec_str.size()), 0));
-            uint64_t ser = static_cast<uint64_t>(std::stoll(std::string(ser_str.data(), ser_str.size()), 0));
-            _event_id = EventId(sec, msec, ser);
-        } catch (std::invalid_argument&) {
-            _event_id = EventId();
-            return false;
-        } catch (std::out_of_range&) {
+        uint64_t sec = 0;
+        uint32_t msec = 0;
+        uint64_t ser = 0;
+        if (std::from_chars(sec_str.data(), sec_str.data()+sec_str.size(), sec).ec != std::errc() ||
+            std::from_chars(msec_str.data(), msec_str.data()+msec_str.size(), msec).ec != std::errc() ||
+            std::from_chars(ser_str.data(), ser_str.data()+ser_str.size(), ser).ec != std::errc()) {
             _event_id = EventId();
             return false;
         }
+        _event_id = EventId(sec, msec, ser);
 
         // The IMA code does't follow the proper audit message format so take the whole message
         if (_record_type == RecordType::INTEGRITY_POLICY_RULE) {
@@ -29,7 +29,9 @@ class RawEventRecord {
 public:
     static constexpr size_t MAX_RECORD_SIZE = 9*1024; // MAX_AUDIT_MESSAGE_LENGTH in libaudit.h is 8970
 
-    explicit RawEventRecord(): _record_fields(128), _unparsable(false) {}
+    explicit RawEventRecord(): _record_fields(), _unparsable(false) {
+        _record_fields.reserve(128);
+    }
 
     inline char* Data() { return _data.data(); };
 
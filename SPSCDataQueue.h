@@ -27,24 +27,26 @@
 
 #include <sys/types.h>
 
+#include "IDataQueue.h"
+
 class Segment;
 
-class SPSCDataQueue {
+class SPSCDataQueue: public IDataQueue {
 public:
     SPSCDataQueue(size_t segment_size, size_t num_segments);
 
-    uint8_t* Allocate(size_t size, size_t* loss_bytes);
+    uint8_t* Allocate(size_t size, size_t* loss_bytes) override;
     inline uint8_t* Allocate(size_t size) { return Allocate(size, nullptr); }
 
-    void Commit(size_t size);
+    void Commit(size_t size) override;
 
-    void Close();
+    void Close() override;
 
-    ssize_t Get(uint8_t** ptr);
+    ssize_t Get(uint8_t** ptr) override;
 
-    void Release();
+    void Release() override;
 
-    bool IsClosed() { return _closed; }
+    bool IsClosed() override { return _closed; }
 
 private:
     std::mutex _mutex;
@@ -15,6 +15,7 @@
 */
 
 #include "SPSCDataQueue.h"
+#include "SPSCRingQueue.h"
 //#define BOOST_TEST_DYN_LINK
 #define BOOST_TEST_MODULE "SPSCDataQueueTests"
 #include <boost/test/unit_test.hpp>
@@ -157,3 +158,166 @@ BOOST_AUTO_TEST_CASE( queue_close ) {
     auto ret = queue.Get(&out_ptr);
     BOOST_REQUIRE_EQUAL(ret, -1);
 }
+
+BOOST_AUTO_TEST_CASE( ring_basic ) {
+    SPSCRingQueue queue(1000);
+
+    std::array<uint8_t, 256> data;
+    data.fill(0);
+    for (int i = 0; i < 200; ++i) {
+        data[0] = static_cast<uint8_t>(i);
+        auto in_ptr = queue.Allocate(data.size());
+        BOOST_REQUIRE(in_ptr != nullptr);
+        ::memcpy(in_ptr, data.data(), data.size());
+        queue.Commit(data.size());
+
+        uint8_t* out_ptr;
+        auto ret = queue.Get(&out_ptr);
+        BOOST_REQUIRE_EQUAL(ret, data.size());
+        BOOST_REQUIRE_EQUAL(out_ptr[0], static_cast<uint8_t>(i));
+        queue.Release();
+    }
+}
+
+BOOST_AUTO_TEST_CASE( ring_full ) {
+    SPSCRingQueue queue(1024);
+
+    std::array<uint8_t, 248> data;
+    data.fill(0);
+
+    // Each item uses 256 bytes (248 + header), so only 4 fit
+    for (int i = 0; i < 6; ++i) {
+        data[0] = static_cast<uint8_t>(i);
+        size_t loss_bytes = 0;
+        auto in_ptr = queue.Allocate(data.size(), &loss_bytes);
+        BOOST_REQUIRE(in_ptr != nullptr);
+        BOOST_REQUIRE_EQUAL(loss_bytes, 0);
+        ::memcpy(in_ptr, data.data(), data.size());
+        queue.Commit(data.size());
+    }
+
+    for (int i = 0; i < 4; ++i) {
+        uint8_t* out_ptr;
+        auto ret = queue.Get(&out_ptr);
+        BOOST_REQUIRE_EQUAL(ret, data.size());
+        BOOST_REQUIRE_EQUAL(out_ptr[0], static_cast<uint8_t>(i));
+        queue.Release();
+    }
+
+    size_t loss_bytes = 0;
+    auto in_ptr = queue.Allocate(data.size(), &loss_bytes);
+    BOOST_REQUIRE(in_ptr != nullptr);
+    BOOST_REQUIRE_EQUAL(loss_bytes, data.size()*2);
+}
+
+BOOST_AUTO_TEST_CASE( ring_concurrent ) {
+    SPSCRingQueue queue(1000);
+
+    std::array<uint8_t, 256> data;
+    data.fill(0);
+
+    std::thread _thread([&queue,&data](){
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        for (int i = 0; i < 200; ++i) {
+            data[0] = static_cast<uint8_t>(i);
+            auto in_ptr = queue.Allocate(data.size());
+            BOOST_REQUIRE(in_ptr != nullptr);
+            ::memcpy(in_ptr, data.data(), data.size());
+            queue.Commit(data.size());
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    });
+
+    for (int i = 0; i < 200; ++i) {
+        uint8_t* out_ptr;
+        auto ret = queue.Get(&out_ptr);
+        BOOST_REQUIRE_EQUAL(ret, data.size());
+        BOOST_REQUIRE_EQUAL(out_ptr[0], static_cast<uint8_t>(i));
+        queue.Release();
+    }
+    _thread.join();
+}
+
+BOOST_AUTO_TEST_CASE( ring_stress ) {
+    SPSCRingQueue queue(4096);
+
+    constexpr int DATA_SIZE = 256;
+    constexpr int LOOP_COUNT = 100000;
+
+    std::array<uint8_t, DATA_SIZE> data;
+    data.fill(0);
+
+    std::random_device rd;
+    std::mt19937 gen(rd());
+    std::uniform_int_distribution<> dis(8, DATA_SIZE);
+    uint64_t loss_bytes = 0;
+
+    std::thread _thread([&queue,&data, &gen, &dis, &loss_bytes](){
+        for (int i = 0; i < LOOP_COUNT; ++i) {
+            size_t dsize = dis(gen);
+            reinterpret_cast<uint32_t*>(data.data())[0] = static_cast<uint32_t>(i);
+            reinterpret_cast<uint32_t*>(data.data())[1] = static_cast<uint32_t>(dsize);
+            size_t loss = 0;
+            auto in_ptr = queue.Allocate(dsize, &loss);
+            loss_bytes += loss;
+            ::memcpy(in_ptr, data.data(), dsize);
+            queue.Commit(dsize);
+        }
+        queue.Close();
+    });
+
+    uint64_t loss_count = 0;
+    int64_t last = -1;
+    for (;;) {
+        uint32_t* out_ptr;
+        auto ret = queue.Get(reinterpret_cast<uint8_t**>(&out_ptr));
+        if (ret < 0) {
+            break;
+        }
+        // Items may be dropped, but never reordered or corrupted
+        BOOST_REQUIRE_GT(static_cast<int64_t>(out_ptr[0]), last);
+        if (out_ptr[0] != last+1) {
+            loss_count += 1;
+        }
+        last = out_ptr[0];
+        BOOST_REQUIRE_EQUAL(ret, out_ptr[1]);
+        queue.Release();
+    }
+    _thread.join();
+
+    if (loss_count == 0) {
+        BOOST_REQUIRE_EQUAL(last, LOOP_COUNT-1);
+    }
+}
+
+BOOST_AUTO_TEST_CASE( ring_close ) {
+    SPSCRingQueue queue(4096);
+
+    std::array<uint8_t, 256> data;
+    data.fill(0);
+
+    for (int i = 0; i < 6; ++i) {
+        data[0] = static_cast<uint8_t>(i);
+        auto in_ptr = queue.Allocate(data.size());
+        BOOST_REQUIRE(in_ptr != nullptr);
+        ::memcpy(in_ptr, data.data(), data.size());
+        queue.Commit(data.size());
+    }
+
+    queue.Close();
+
+    auto in_ptr = queue.Allocate(data.size());
+    BOOST_REQUIRE(in_ptr == nullptr);
+
+    for (int i = 0; i < 6; ++i) {
+        uint8_t* out_ptr;
+        auto ret = queue.Get(&out_ptr);
+        BOOST_REQUIRE_EQUAL(ret, data.size());
+        BOOST_REQUIRE_EQUAL(out_ptr[0], static_cast<uint8_t>(i));
+        queue.Release();
+    }
+
+    uint8_t* out_ptr;
+    auto ret = queue.Get(&out_ptr);
+    BOOST_REQUIRE_EQUAL(ret, -1);
+}
@@ -0,0 +1,193 @@
+/*
+    microsoft-oms-auditd-plugin
+
+    Copyright (c) Microsoft Corporation
+
+    All rights reserved.
+
+    MIT License
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "SPSCRingQueue.h"
+
+#include <string>
+#include <stdexcept>
+
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+SPSCRingQueue::SPSCRingQueue(size_t size) {
+    _size = (static_cast<uint64_t>(size) + 7) & ~static_cast<uint64_t>(7);
+    if (_size < HEADER_SIZE*2) {
+        throw std::invalid_argument("SPSCRingQueue: size too small");
+    }
+    _data = new uint8_t[_size];
+    _head.store(0);
+    _cached_tail = 0;
+    _alloc_size = 0;
+    _alloc_pad = 0;
+    _alloc_dropped = false;
+    _lost_bytes = 0;
+    _tail.store(0);
+    _cached_head = 0;
+    _get_size = 0;
+    _consumer_waiting.store(0);
+    _closed.store(false);
+}
+
+SPSCRingQueue::~SPSCRingQueue() {
+    delete[] _data;
+}
+
+uint8_t* SPSCRingQueue::Allocate(size_t size, size_t* loss_bytes) {
+    if (_closed.load(std::memory_order_acquire)) {
+        return nullptr;
+    }
+
+    auto head = _head.load(std::memory_order_relaxed);
+    auto need = entry_size(size);
+    auto pos = head % _size;
+    uint64_t pad = 0;
+    // Items are always contiguous. If the item doesn't fit before the end of the ring, skip to the start.
+    if (pos + need > _size) {
+        pad = _size - pos;
+    }
+
+    if (head + pad + need - _cached_tail > _size) {
+        _cached_tail = _tail.load(std::memory_order_acquire);
+    }
+
+    if (need > _size || head + pad + need - _cached_tail > _size) {
+        // No room, the item will be dropped in Commit()
+        _alloc_size = size;
+        _alloc_pad = 0;
+        _alloc_dropped = true;
+        if (_scratch.size() < size) {
+            _scratch.resize(size);
+        }
+        return _scratch.data();
+    }
+
+    if (loss_bytes != nullptr && _lost_bytes > 0) {
+        *loss_bytes = _lost_bytes;
+        _lost_bytes = 0;
+    }
+
+    _alloc_size = size;
+    _alloc_pad = pad;
+    _alloc_dropped = false;
+    return _data + ((pos + pad) % _size) + HEADER_SIZE;
+}
+
+void SPSCRingQueue::Commit(size_t size) {
+    if (size > _alloc_size) {
+        throw std::runtime_error("SPSCRingQueue: Commit size ("+std::to_string(size)+") greater than allocated size ("+std::to_string(_alloc_size)+")");
+    }
+
+    if (_alloc_dropped) {
+        _lost_bytes += size;
+        return;
+    }
+
+    auto head = _head.load(std::memory_order_relaxed);
+    auto pos = head % _size;
+    if (_alloc_pad > 0) {
+        auto pad_hdr = reinterpret_cast<EntryHeader*>(_data + pos);
+        pad_hdr->size = 0;
+        pad_hdr->flags = PAD_FLAG;
+        pos = 0;
+    }
+    auto hdr = reinterpret_cast<EntryHeader*>(_data + pos);
+    hdr->size = static_cast<uint32_t>(size);
+    hdr->flags = 0;
+
+    _head.store(head + _alloc_pad + entry_size(size), std::memory_order_release);
+    _alloc_size = 0;
+
+    // Pairs with the fence in wait_for_data()
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (_consumer_waiting.load(std::memory_order_relaxed) != 0) {
+        wake_consumer();
+    }
+}
+
+void SPSCRingQueue::Close() {
+    _closed.store(true, std::memory_order_release);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    wake_consumer();
+}
+
+ssize_t SPSCRingQueue::Get(uint8_t** ptr) {
+    auto tail = _tail.load(std::memory_order_relaxed);
+    for (;;) {
+        if (_cached_head == tail) {
+            _cached_head = _head.load(std::memory_order_acquire);
+            if (_cached_head == tail) {
+                if (!wait_for_data()) {
+                    return -1;
+                }
+                continue;
+            }
+        }
+
+        auto pos = tail % _size;
+        auto hdr = reinterpret_cast<EntryHeader*>(_data + pos);
+        if ((hdr->flags & PAD_FLAG) != 0) {
+            tail += _size - pos;
+            _tail.store(tail, std::memory_order_release);
+            continue;
+        }
+
+        _get_size = hdr->size;
+        *ptr = _data + pos + HEADER_SIZE;
+        return static_cast<ssize_t>(_get_size);
+    }
+}
+
+void SPSCRingQueue::Release() {
+    auto tail = _tail.load(std::memory_order_relaxed);
+    _tail.store(tail + entry_size(_get_size), std::memory_order_release);
+}
+
+// Returns false if the queue is closed and empty
+bool SPSCRingQueue::wait_for_data() {
+    auto tail = _tail.load(std::memory_order_relaxed);
+
+    for (int i = 0; i < SPIN_COUNT; ++i) {
+        _cached_head = _head.load(std::memory_order_acquire);
+        if (_cached_head != tail) {
+            return true;
+        }
+    }
+
+    for (;;) {
+        _consumer_waiting.store(1, std::memory_order_relaxed);
+        // Pairs with the fence in Commit()
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        _cached_head = _head.load(std::memory_order_acquire);
+        if (_cached_head != tail) {
+            _consumer_waiting.store(0, std::memory_order_relaxed);
+            return true;
+        }
+        if (_closed.load(std::memory_order_acquire)) {
+            _consumer_waiting.store(0, std::memory_order_relaxed);
+            _cached_head = _head.load(std::memory_order_acquire);
+            return _cached_head != tail;
+        }
+        // If the producer already reset _consumer_waiting, FUTEX_WAIT returns immediately with EAGAIN
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&_consumer_waiting), FUTEX_WAIT_PRIVATE, 1, nullptr, nullptr, 0);
+    }
+}
+
+void SPSCRingQueue::wake_consumer() {
+    _consumer_waiting.store(0, std::memory_order_relaxed);
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&_consumer_waiting), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+}
@@ -0,0 +1,100 @@
+/*
+    microsoft-oms-auditd-plugin
+
+    Copyright (c) Microsoft Corporation
+
+    All rights reserved.
+
+    MIT License
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef AUOMS_SPSCRINGQUEUE_H
+#define AUOMS_SPSCRINGQUEUE_H
+
+#include "IDataQueue.h"
+
+#include <cinttypes>
+#include <atomic>
+#include <vector>
+
+#include <sys/types.h>
+
+/*
+ * Wait-free single producer, single consumer ring buffer of variable sized items.
+ *
+ * Unlike SPSCDataQueue, the producer never discards data that has already been committed.
+ * If there is not enough free space in the ring, Allocate() returns a scratch buffer and the
+ * item is dropped on Commit(). The number of bytes dropped is reported via loss_bytes on the
+ * next successful Allocate().
+ *
+ * The consumer spins briefly when the ring is empty, then sleeps on a futex. The producer
+ * only makes the wake syscall when the consumer has indicated it is (about to be) asleep.
+ */
+class SPSCRingQueue: public IDataQueue {
+public:
+    static constexpr size_t CACHE_LINE_SIZE = 64;
+
+    explicit SPSCRingQueue(size_t size);
+    ~SPSCRingQueue() override;
+
+    uint8_t* Allocate(size_t size, size_t* loss_bytes) override;
+    inline uint8_t* Allocate(size_t size) { return Allocate(size, nullptr); }
+
+    void Commit(size_t size) override;
+
+    void Close() override;
+
+    ssize_t Get(uint8_t** ptr) override;
+
+    void Release() override;
+
+    bool IsClosed() override { return _closed.load(std::memory_order_acquire); }
+
+private:
+    static constexpr uint32_t HEADER_SIZE = 8;
+    static constexpr uint32_t PAD_FLAG = 1;
+    static constexpr int SPIN_COUNT = 100;
+
+    struct EntryHeader {
+        uint32_t size;
+        uint32_t flags;
+    };
+
+    static inline uint64_t entry_size(size_t size) {
+        return (HEADER_SIZE + size + 7) & ~static_cast<uint64_t>(7);
+    }
+
+    bool wait_for_data();
+    void wake_consumer();
+
+    // Read-only after construction
+    alignas(CACHE_LINE_SIZE) uint8_t* _data;
+    uint64_t _size;
+
+    // Producer owned
+    alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> _head;
+    uint64_t _cached_tail;
+    uint64_t _alloc_size;
+    uint64_t _alloc_pad;
+    bool _alloc_dropped;
+    uint64_t _lost_bytes;
+    std::vector<uint8_t> _scratch;
+
+    // Consumer owned
+    alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> _tail;
+    uint64_t _cached_head;
+    uint64_t _get_size;
+
+    // Shared
+    alignas(CACHE_LINE_SIZE) std::atomic<uint32_t> _consumer_waiting;
+    std::atomic<bool> _closed;
+};
+
+#endif //AUOMS_SPSCRINGQUEUE_H
@@ -0,0 +1,118 @@
+/*
+    microsoft-oms-auditd-plugin
+
+    Copyright (c) Microsoft Corporation
+
+    All rights reserved. 
+
+    MIT License
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#ifndef AUOMS_SNAPSHOT_PUBLISHER_H
+#define AUOMS_SNAPSHOT_PUBLISHER_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+/*
+ * Holds the current version of an immutable T. Readers never lock, writers replace the whole T.
+ *
+ * Readers register in _readers[generation & 1] for as long as they hold a ReadRef. Publish() swaps in the new
+ * snapshot, advances the generation, then waits for the readers registered under the previous generation to leave
+ * before deleting the old snapshot. Readers should only hold a ReadRef for the duration of a lookup.
+ */
+template<typename T>
+class SnapshotPublisher {
+public:
+    class ReadRef {
+    public:
+        ReadRef(const ReadRef&) = delete;
+        ReadRef& operator=(const ReadRef&) = delete;
+
+        ReadRef(ReadRef&& other) noexcept: _publisher(other._publisher), _gen(other._gen), _snapshot(other._snapshot) {
+            other._publisher = nullptr;
+        }
+
+        ~ReadRef() {
+            if (_publisher != nullptr) {
+                _publisher->end_read(_gen);
+            }
+        }
+
+        inline const T* get() const { return _snapshot; }
+        inline const T* operator->() const { return _snapshot; }
+        inline const T& operator*() const { return *_snapshot; }
+
+    private:
+        friend class SnapshotPublisher;
+
+        ReadRef(SnapshotPublisher* publisher, uint64_t gen, const T* snapshot): _publisher(publisher), _gen(gen), _snapshot(snapshot) {}
+
+        SnapshotPublisher* _publisher;
+        uint64_t _gen;
+        const T* _snapshot;
+    };
+
+    explicit SnapshotPublisher(const T* snapshot): _snapshot(snapshot), _generation(0), _readers() {}
+
+    SnapshotPublisher(const SnapshotPublisher&) = delete;
+    SnapshotPublisher& operator=(const SnapshotPublisher&) = delete;
+
+    ~SnapshotPublisher() {
+        delete _snapshot.load();
+    }
+
+    inline ReadRef Read() {
+        auto gen = begin_read();
+        return ReadRef(this, gen, _snapshot.load());
+    }
+
+    // Takes ownership of snapshot. Returns once the previous snapshot has been deleted.
+    void Publish(const T* snapshot) {
+        std::lock_guard<std::mutex> lock(_publish_lock);
+
+        auto old = _snapshot.exchange(snapshot);
+        auto gen = _generation.fetch_add(1);
+
+        // Readers only hold a snapshot for the duration of a lookup, so this wait is short
+        while (_readers[gen & 1]._count.load() != 0) {
+            std::this_thread::yield();
+        }
+        delete old;
+    }
+
+private:
+    inline uint64_t begin_read() {
+        for (;;) {
+            auto gen = _generation.load();
+            _readers[gen & 1]._count.fetch_add(1);
+            if (_generation.load() == gen) {
+                return gen;
+            }
+            _readers[gen & 1]._count.fetch_sub(1);
+        }
+    }
+
+    inline void end_read(uint64_t gen) {
+        _readers[gen & 1]._count.fetch_sub(1, std::memory_order_release);
+    }
+
+    struct alignas(64) ReaderCount {
+        std::atomic<long> _count{0};
+    };
+
+    std::mutex _publish_lock;
+    std::atomic<const T*> _snapshot;
+    std::atomic<uint64_t> _generation;
+    std::array<ReaderCount, 2> _readers;
+};
+
+#endif //AUOMS_SNAPSHOT_PUBLISHER_H
@@ -18,58 +18,262 @@
 #define AUOMS_STRINGTABLE_H
 
 #include <string_view>
-#include <vector>
-#include <unordered_map>
-#include <initializer_list>
+#include <array>
+#include <cstdint>
+#include <cstddef>
+#include <iterator>
+#include <type_traits>
 
 template <typename V>
+struct StringTableEntry {
+    std::string_view name;
+    V value;
+};
+
+/*
+ * Two way name <-> value table built at compile time from a static constexpr array of StringTableEntry.
+ *
+ *   static constexpr StringTableEntry<int> s_foo_entries[] = {{"a", 1}, {"b", 2}};
+ *   static constexpr StringTable<s_foo_entries> s_foo_table(-1);
+ *
+ * Names are looked up through a perfect hash (hash and displace): the name hash selects a bucket, the bucket's
+ * displacement selects the slot, and a single string compare confirms the match. Values are looked up in a dense
+ * array indexed by value, or if the values are sparse, through a perfect hash of the value.
+ *
+ * Entries with a negative value are ignored, and if a name or value appears more than once, the last entry wins.
+ * The tables are built entirely at compile time, so there is no static initialization cost or ordering dependency.
+ */
+template <const auto& Entries>
 class StringTable {
-public:
-    explicit StringTable(V unknown_val, std::initializer_list<std::pair<std::string, V>> values): _str(), _itos(), _stoi(values.size()), _unknown_val(unknown_val) {
-        int max  = 0;
-        int str_size = 0;
-        for(auto& e: values) {
-            str_size += e.first.size()+1;
-            if (max < static_cast<int>(e.second)) {
-                max = static_cast<int>(e.second);
+    using entry_type = std::remove_cv_t<std::remove_reference_t<decltype(Entries[0])>>;
+    using value_type = decltype(entry_type::value);
+
+    static constexpr size_t NUM_ENTRIES = std::size(Entries);
+    static_assert(NUM_ENTRIES < 0xFFFF, "StringTable too large");
+
+    static constexpr uint16_t EMPTY_SLOT = 0xFFFF;
+    static constexpr uint32_t MAX_DISPLACEMENT = 0xFFFF;
+    static constexpr uint64_t NUM_SEEDS = 16;
+
+    static constexpr size_t pow2_at_least(size_t n) {
+        size_t p = 1;
+        while (p < n) {
+            p <<= 1;
+        }
+        return p;
+    }
+
+    static constexpr size_t NUM_SLOTS = pow2_at_least(NUM_ENTRIES*2+1);
+    static constexpr size_t NUM_BUCKETS = pow2_at_least(NUM_ENTRIES/4+1);
+
+    static constexpr bool is_valid(value_type v) {
+        return static_cast<int>(v) >= 0;
+    }
+
+    static constexpr uint64_t mix(uint64_t h) {
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ULL;
+        h ^= h >> 33;
+        return h;
+    }
+
+    static constexpr uint64_t hash(std::string_view str, uint64_t seed) {
+        // FNV-1a
+        uint64_t h = 0xcbf29ce484222325ULL ^ seed;
+        for (auto c : str) {
+            h ^= static_cast<unsigned char>(c);
+            h *= 0x100000001b3ULL;
+        }
+        return mix(h);
+    }
+
+    static constexpr uint64_t hash(value_type v, uint64_t seed) {
+        return mix(static_cast<uint64_t>(static_cast<int64_t>(v)) ^ (seed * 0x9e3779b97f4a7c15ULL));
+    }
+
+    static constexpr size_t bucket_of(uint64_t h) {
+        return static_cast<size_t>(h >> 40) & (NUM_BUCKETS-1);
+    }
+
+    static constexpr size_t slot_of(uint64_t h, uint32_t d) {
+        return static_cast<size_t>((h & 0xFFFFFFFF) + d * ((h >> 32) | 1)) & (NUM_SLOTS-1);
+    }
+
+    struct PerfectHash {
+        uint64_t seed;
+        std::array<uint16_t, NUM_BUCKETS> displacements;
+        std::array<uint16_t, NUM_SLOTS> slots;
+    };
+
+    template <bool ByName>
+    static constexpr bool try_build(PerfectHash& ph, uint64_t seed) {
+        std::array<uint64_t, NUM_ENTRIES> hashes{};
+        std::array<bool, NUM_ENTRIES> used{};
+        std::array<size_t, NUM_BUCKETS+1> bucket_start{};
+        std::array<size_t, NUM_ENTRIES> members{};
+        size_t max_bucket_size = 0;
+
+        ph.seed = seed;
+        for (auto& d : ph.displacements) {
+            d = 0;
+        }
+        for (auto& s : ph.slots) {
+            s = EMPTY_SLOT;
+        }
+
+        for (size_t i = 0; i < NUM_ENTRIES; ++i) {
+            used[i] = is_valid(Entries[i].value);
+            if (used[i]) {
+                if constexpr (ByName) {
+                    hashes[i] = hash(Entries[i].name, seed);
+                } else {
+                    hashes[i] = hash(Entries[i].value, seed);
+                }
             }
         }
-        _str.reserve(str_size);
-        _itos.resize(max+1);
-        for(auto& e: values) {
-            auto idx = _str.size();
-            _str.append(e.first);
-            _str.push_back(0);
-            std::string_view sv(&_str[idx], e.first.size());
-            // Ignore values where V < 0
-            if (static_cast<int>(e.second) >= 0) {
-                _itos[static_cast<int>(e.second)] = sv;
-                _stoi[sv] = e.second;
+
+        // An entry is superseded by a later entry with the same key
+        for (size_t i = 0; i < NUM_ENTRIES; ++i) {
+            for (size_t j = i+1; j < NUM_ENTRIES && used[i]; ++j) {
+                if (used[j] && hashes[j] == hashes[i]) {
+                    if constexpr (ByName) {
+                        used[i] = Entries[j].name != Entries[i].name;
+                    } else {
+                        used[i] = Entries[j].value != Entries[i].value;
+                    }
+                }
             }
         }
+
+        // Group the entries by bucket
+        for (size_t i = 0; i < NUM_ENTRIES; ++i) {
+            if (used[i]) {
+                bucket_start[bucket_of(hashes[i])+1]++;
+            }
+        }
+        for (size_t b = 0; b < NUM_BUCKETS; ++b) {
+            if (bucket_start[b+1] > max_bucket_size) {
+                max_bucket_size = bucket_start[b+1];
+            }
+            bucket_start[b+1] += bucket_start[b];
+        }
+        std::array<size_t, NUM_BUCKETS> fill{};
+        for (size_t i = 0; i < NUM_ENTRIES; ++i) {
+            if (used[i]) {
+                auto b = bucket_of(hashes[i]);
+                members[bucket_start[b] + fill[b]++] = i;
+            }
+        }
+
+        // Place the largest buckets first
+        for (size_t size = max_bucket_size; size > 0; --size) {
+            for (size_t b = 0; b < NUM_BUCKETS; ++b) {
+                if (bucket_start[b+1] - bucket_start[b] != size) {
+                    continue;
+                }
+                bool placed = false;
+                // slot_of() repeats every NUM_SLOTS displacements, so a larger displacement can't place the bucket
+                for (uint32_t d = 0; d < NUM_SLOTS && d <= MAX_DISPLACEMENT && !placed; ++d) {
+                    size_t n = 0;
+                    for (; n < size; ++n) {
+                        auto i = members[bucket_start[b] + n];
+                        auto slot = slot_of(hashes[i], d);
+                        if (ph.slots[slot] != EMPTY_SLOT) {
+                            break;
+                        }
+                        ph.slots[slot] = static_cast<uint16_t>(i);
+                    }
+                    placed = n == size;
+                    if (placed) {
+                        ph.displacements[b] = static_cast<uint16_t>(d);
+                    } else {
+                        // Undo the partial placement of this bucket
+                        for (size_t k = 0; k < n; ++k) {
+                            ph.slots[slot_of(hashes[members[bucket_start[b] + k]], d)] = EMPTY_SLOT;
+                        }
+                    }
+                }
+                if (!placed) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    template <bool ByName>
+    static constexpr PerfectHash build_hash() {
+        PerfectHash ph{};
+        for (uint64_t seed = 0; seed < NUM_SEEDS; ++seed) {
+            if (try_build<ByName>(ph, seed)) {
+                return ph;
+            }
+        }
+        throw "StringTable: failed to build perfect hash";
+    }
+
+    static constexpr int max_value() {
+        int max = -1;
+        for (auto& e : Entries) {
+            if (static_cast<int>(e.value) > max) {
+                max = static_cast<int>(e.value);
+            }
+        }
+        return max;
+    }
+
+    // Use a dense value -> name array unless the values are sparse
+    static constexpr bool DENSE_VALUES = max_value() < static_cast<int>(NUM_ENTRIES*4+64);
+    static constexpr size_t NUM_DENSE_VALUES = DENSE_VALUES ? max_value()+1 : 1;
+
+    static constexpr std::array<std::string_view, NUM_DENSE_VALUES> build_dense() {
+        std::array<std::string_view, NUM_DENSE_VALUES> names{};
+        if constexpr (DENSE_VALUES) {
+            for (auto& e : Entries) {
+                if (is_valid(e.value)) {
+                    names[static_cast<int>(e.value)] = e.name;
+                }
+            }
+        }
+        return names;
     }
 
-    std::string_view ToString(V i) const noexcept {
-        if (static_cast<int>(i) < _itos.size()) {
-            return _itos[static_cast<int>(i)];
+    static constexpr PerfectHash NAME_HASH = build_hash<true>();
+    static constexpr std::array<std::string_view, NUM_DENSE_VALUES> VALUE_NAMES = build_dense();
+    static constexpr PerfectHash VALUE_HASH = DENSE_VALUES ? PerfectHash{} : build_hash<false>();
+
+public:
+    explicit constexpr StringTable(value_type unknown_val): _unknown_val(unknown_val) {}
+
+    std::string_view ToString(value_type i) const noexcept {
+        if constexpr (DENSE_VALUES) {
+            if (static_cast<unsigned int>(i) < NUM_DENSE_VALUES) {
+                return VALUE_NAMES[static_cast<int>(i)];
+            }
+            return std::string_view();
         } else {
+            auto h = hash(i, VALUE_HASH.seed);
+            auto idx = VALUE_HASH.slots[slot_of(h, VALUE_HASH.displacements[bucket_of(h)])];
+            if (idx != EMPTY_SLOT && Entries[idx].value == i) {
+                return Entries[idx].name;
+            }
             return std::string_view();
         }
     }
 
-    V ToInt(const std::string_view& str) const noexcept {
-        auto itr = _stoi.find(str);
-        if (itr != _stoi.end()) {
-            return itr->second;
-        } else {
-            return _unknown_val;
+    value_type ToInt(const std::string_view& str) const noexcept {
+        auto h = hash(str, NAME_HASH.seed);
+        auto idx = NAME_HASH.slots[slot_of(h, NAME_HASH.displacements[bucket_of(h)])];
+        if (idx != EMPTY_SLOT && Entries[idx].name == str) {
+            return Entries[idx].value;
         }
+        return _unknown_val;
     }
+
 private:
-    std::string _str;
-    std::vector<std::string_view> _itos;
-    std::unordered_map<std::string_view, V> _stoi;
-    V _unknown_val;
+    value_type _unknown_val;
 };
 
 #endif //AUOMS_STRINGTABLE_H
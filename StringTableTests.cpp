@@ -0,0 +1,158 @@
+/*
+    microsoft-oms-auditd-plugin
+
+    Copyright (c) Microsoft Corporation
+
+    All rights reserved.
+
+    MIT License
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+//#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE "StringTableTests"
+#include <boost/test/unit_test.hpp>
+
+#include "StringTable.h"
+#include "Translate.h"
+#include "StringUtils.h"
+
+#include <string>
+
+// Every number a syscall table has a name for must translate back to that number
+BOOST_AUTO_TEST_CASE( syscall_table_test ) {
+    for (auto mach : {MachineType::X86, MachineType::X86_64, MachineType::ARM, MachineType::ARM64}) {
+        int num_names = 0;
+        for (int num = 0; num < 4096; ++num) {
+            std::string name;
+            if (SyscallToName(mach, num, name)) {
+                num_names++;
+                BOOST_CHECK_MESSAGE(SyscallNameToNumber(mach, name) == num, "SyscallNameToNumber(" << name << ")");
+            } else {
+                BOOST_CHECK_EQUAL(name, "unknown-syscall(" + std::to_string(num) + ")");
+            }
+        }
+        BOOST_CHECK_GT(num_names, 250);
+        BOOST_CHECK_EQUAL(SyscallNameToNumber(mach, "not-a-syscall"), -1);
+        BOOST_CHECK_EQUAL(SyscallNameToNumber(mach, ""), -1);
+    }
+
+    // madvise and madvise1 are both 219 in the i386 table, the last entry (madvise1) is the name for 219
+    BOOST_CHECK_EQUAL(SyscallNameToNumber(MachineType::X86, "madvise"), 219);
+    BOOST_CHECK_EQUAL(SyscallNameToNumber(MachineType::X86, "madvise1"), 219);
+    BOOST_CHECK_EQUAL(SyscallToName(MachineType::X86, 219), "madvise1");
+}
+
+BOOST_AUTO_TEST_CASE( record_type_table_test ) {
+    int num_names = 0;
+    for (int code = 0; code < 0x10000; ++code) {
+        auto name = RecordTypeToName(static_cast<RecordType>(code));
+        if (!starts_with(name, "UNKNOWN[")) {
+            num_names++;
+            BOOST_CHECK_MESSAGE(static_cast<int>(RecordNameToType(name)) == code, "RecordNameToType(" << name << ")");
+        } else {
+            BOOST_CHECK_EQUAL(name, "UNKNOWN[" + std::to_string(code) + "]");
+        }
+    }
+    BOOST_CHECK_GT(num_names, 150);
+    BOOST_CHECK(RecordNameToType("NOT_A_RECORD_TYPE") == RecordType::UNKNOWN);
+    BOOST_CHECK(RecordNameToType("") == RecordType::UNKNOWN);
+    BOOST_CHECK(RecordNameToType("UNKNOWN[65000]") == RecordType::UNKNOWN);
+
+    int num_categories = 0;
+    for (int code = 0; code < 256; ++code) {
+        auto name = RecordTypeCategoryToName(static_cast<RecordTypeCategory>(code));
+        if (name != "UNKNOWN") {
+            num_categories++;
+            BOOST_CHECK_MESSAGE(static_cast<int>(RecordTypeCategoryNameToCategory(name)) == code, "RecordTypeCategoryNameToCategory(" << name << ")");
+        }
+    }
+    BOOST_CHECK_GT(num_categories, 10);
+    BOOST_CHECK(RecordTypeCategoryNameToCategory("NOT_A_CATEGORY") == RecordTypeCategory::UNKNOWN);
+}
+
+BOOST_AUTO_TEST_CASE( field_table_test ) {
+    int num_names = 0;
+    for (int id = 0; id < 1024; ++id) {
+        auto name = FieldIdToName(id);
+        if (name != "f" + std::to_string(id)) {
+            num_names++;
+            BOOST_CHECK_MESSAGE(FieldNameToId(name) == id, "FieldNameToId(" << name << ")");
+        }
+    }
+    BOOST_CHECK_GT(num_names, 30);
+    BOOST_CHECK_EQUAL(FieldNameToId("not_a_field"), -1);
+
+    BOOST_CHECK(FieldNameToType("auid") == field_type_t::UID);
+    BOOST_CHECK(FieldNameToType("uid") == field_type_t::UID);
+    BOOST_CHECK(FieldNameToType("SV_INTEGRITY_HASH") == field_type_t::ESCAPED);
+    BOOST_CHECK(FieldNameToType("not_a_field") == field_type_t::UNCLASSIFIED);
+    BOOST_CHECK(FieldNameToType("") == field_type_t::UNCLASSIFIED);
+}
+
+BOOST_AUTO_TEST_CASE( errno_table_test ) {
+    int num_names = 0;
+    for (int n = 1; n < 1024; ++n) {
+        auto name = ErrnoToName(n);
+        if (name != std::to_string(n)) {
+            num_names++;
+            BOOST_CHECK_MESSAGE(NameToErrno(name) == n, "NameToErrno(" << name << ")");
+            BOOST_CHECK_EQUAL(NameToErrno("-" + name), -n);
+        }
+    }
+    BOOST_CHECK_GT(num_names, 100);
+    BOOST_CHECK_EQUAL(NameToErrno("ENOTANERRNO"), 0);
+}
+
+static constexpr StringTableEntry<int> s_dense_entries[] = {
+    {"a", 1},
+    {"b", 2},
+    {"a", 3},
+    {"c", 2},
+    {"d", -1},
+    {"e", 5},
+};
+static constexpr StringTable<s_dense_entries> s_dense_table(-1);
+
+// Values well beyond 4 times the number of entries use the value perfect hash instead of the dense array
+static constexpr StringTableEntry<int> s_sparse_entries[] = {
+    {"a", 100000},
+    {"b", 200000},
+    {"a", 300000},
+    {"c", 200000},
+    {"d", -1},
+    {"e", 500000},
+};
+static constexpr StringTable<s_sparse_entries> s_sparse_table(-1);
+
+BOOST_AUTO_TEST_CASE( duplicate_entries_test ) {
+    BOOST_CHECK_EQUAL(s_dense_table.ToInt("a"), 3);
+    BOOST_CHECK_EQUAL(s_dense_table.ToInt("b"), 2);
+    BOOST_CHECK_EQUAL(s_dense_table.ToInt("c"), 2);
+    BOOST_CHECK_EQUAL(s_dense_table.ToInt("d"), -1);
+    BOOST_CHECK_EQUAL(s_dense_table.ToInt("e"), 5);
+    BOOST_CHECK_EQUAL(s_dense_table.ToString(1), "a");
+    BOOST_CHECK_EQUAL(s_dense_table.ToString(2), "c");
+    BOOST_CHECK_EQUAL(s_dense_table.ToString(3), "a");
+    BOOST_CHECK_EQUAL(s_dense_table.ToString(5), "e");
+    BOOST_CHECK(s_dense_table.ToString(0).empty());
+    BOOST_CHECK(s_dense_table.ToString(4).empty());
+    BOOST_CHECK(s_dense_table.ToString(-1).empty());
+
+    BOOST_CHECK_EQUAL(s_sparse_table.ToInt("a"), 300000);
+    BOOST_CHECK_EQUAL(s_sparse_table.ToInt("b"), 200000);
+    BOOST_CHECK_EQUAL(s_sparse_table.ToInt("c"), 200000);
+    BOOST_CHECK_EQUAL(s_sparse_table.ToInt("d"), -1);
+    BOOST_CHECK_EQUAL(s_sparse_table.ToInt("e"), 500000);
+    BOOST_CHECK_EQUAL(s_sparse_table.ToString(100000), "a");
+    BOOST_CHECK_EQUAL(s_sparse_table.ToString(200000), "c");
+    BOOST_CHECK_EQUAL(s_sparse_table.ToString(300000), "a");
+    BOOST_CHECK_EQUAL(s_sparse_table.ToString(500000), "e");
+    BOOST_CHECK(s_sparse_table.ToString(0).empty());
+    BOOST_CHECK(s_sparse_table.ToString(400000).empty());
+    BOOST_CHECK(s_sparse_table.ToString(-1).empty());
+}
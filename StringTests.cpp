@@ -280,3 +280,23 @@ BOOST_AUTO_TEST_CASE( time_whitespace ) {
     BOOST_REQUIRE_EQUAL("test", trim_whitespace(" test \t\n "));
     BOOST_REQUIRE_EQUAL("test", trim_whitespace("\t\n test \t\n "));
 }
+
+BOOST_AUTO_TEST_CASE( find_first_of_chars_matches_string_view ) {
+    std::string str = "type=SYSCALL msg=audit(1521757638.392:262332): arch=c000003e syscall=59 success=yes exit=0 comm=\"ls\" exe=\"/bin/ls\" key=(null)\n";
+    // Repeat so that the vectorized loops, not just the scalar tail, are exercised
+    str = str + str + "'  \n";
+    std::string_view sv(str);
+
+    for (size_t pos = 0; pos <= sv.size()+1; ++pos) {
+        BOOST_REQUIRE_EQUAL((find_first_of_chars<'='>(sv, pos)), sv.find_first_of("=", pos));
+        BOOST_REQUIRE_EQUAL((find_first_of_chars<'"'>(sv, pos)), sv.find_first_of("\"", pos));
+        BOOST_REQUIRE_EQUAL((find_first_of_chars<' ', '\n'>(sv, pos)), sv.find_first_of(" \n", pos));
+        BOOST_REQUIRE_EQUAL((find_first_of_chars<'\'', ' ', '\n'>(sv, pos)), sv.find_first_of("' \n", pos));
+        BOOST_REQUIRE_EQUAL((find_first_not_of_chars<' ', '\n'>(sv, pos)), sv.find_first_not_of(" \n", pos));
+        BOOST_REQUIRE_EQUAL((find_first_not_of_chars<'\'', ' ', '\n'>(sv, pos)), sv.find_first_not_of("' \n", pos));
+    }
+
+    std::string spaces(100, ' ');
+    BOOST_REQUIRE_EQUAL((find_first_not_of_chars<' '>(spaces, 0)), std::string_view::npos);
+    BOOST_REQUIRE_EQUAL((find_first_of_chars<'='>(spaces, 0)), std::string_view::npos);
+}
@@ -18,11 +18,16 @@
 #define AUOMS_STRINGUTILS_H
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <algorithm>
 #include <type_traits>
 #include <cstdint>
 
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
 int decode_hex(std::string& out, const char* hex, size_t len);
 
 size_t decode_hex(void* buf, size_t buf_len, const char* hex, size_t len);
@@ -83,6 +88,66 @@ inline bool ends_with(const std::string_view& str, const std::string_view& suffi
     return str.size() >= suffix.size() && str.compare(str.size()-suffix.size(), suffix.size(), suffix) == 0;
 }
 
+template <char... C>
+inline bool is_one_of_chars(char c) {
+    return ((c == C) || ...);
+}
+
+// Returns the index of the first char at or after pos that is (or, if Negate is true, is not) one of C, or npos.
+// Scans 32 (AVX2) or 16 (SSE2) bytes at a time, then falls back to a scalar scan for the tail.
+template <bool Negate, char... C>
+inline size_t scan_chars(std::string_view str, size_t pos) {
+    const char* data = str.data();
+    size_t size = str.size();
+    size_t i = pos;
+#if defined(__AVX2__)
+    for (; i+32 <= size; i += 32) {
+        __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data+i));
+        __m256i match = _mm256_setzero_si256();
+        ((match = _mm256_or_si256(match, _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(C)))), ...);
+        uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(match));
+        if (Negate) {
+            mask = ~mask;
+        }
+        if (mask != 0) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+#endif
+#if defined(__SSE2__)
+    for (; i+16 <= size; i += 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data+i));
+        __m128i match = _mm_setzero_si128();
+        ((match = _mm_or_si128(match, _mm_cmpeq_epi8(chunk, _mm_set1_epi8(C)))), ...);
+        uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(match));
+        if (Negate) {
+            mask = ~mask & 0xFFFF;
+        }
+        if (mask != 0) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+#endif
+    for (; i < size; ++i) {
+        if (is_one_of_chars<C...>(data[i]) != Negate) {
+            return i;
+        }
+    }
+    return std::string_view::npos;
+}
+
+// Same result as str.find_first_of(std::string_view({C...}), pos)
+template <char... C>
+inline size_t find_first_of_chars(std::string_view str, size_t pos) {
+    return scan_chars<false, C...>(str, pos);
+}
+
+// Same result as str.find_first_not_of(std::string_view({C...}), pos)
+template <char... C>
+inline size_t find_first_not_of_chars(std::string_view str, size_t pos) {
+    return scan_chars<true, C...>(str, pos);
+}
+
 std::string trim_whitespace(const std::string& str);
 
 std::vector<std::string> split(const std::string& str, const std::string& sep);
@@ -15,11 +15,12 @@
 */
 
 #include "Translate.h"
-#include "StringTable.h"
 
 #include <linux/audit.h>
 #include <sys/utsname.h>
 #include <mutex>
+#include <string>
+#include <unordered_map>
 
 // These EM_ defines are found in newer versions of /usr/include/linux/elf-em.h
 #ifndef EM_ARM
@@ -21,7 +21,7 @@
 
 #include <errno.h>
 
-static StringTable<int> s_errno_table(0, {
+static constexpr StringTableEntry<int> s_errno_entries[] = {
         {"EPERM", EPERM},
         {"ENOENT", ENOENT},
         {"ESRCH", ESRCH},
@@ -155,7 +155,9 @@ static StringTable<int> s_errno_table(0, {
         {"ENOTRECOVERABLE", ENOTRECOVERABLE},
         {"ERFKILL", ERFKILL},
         {"EHWPOISON", EHWPOISON},
-});
+};
+
+static constexpr StringTable<s_errno_entries> s_errno_table(0);
 
 std::string ErrnoToName(int n) {
     int err = n;
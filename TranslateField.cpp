@@ -19,7 +19,7 @@
 #include "Translate.h"
 #include "StringTable.h"
 
-static StringTable<int> s_field_name_table(-1, {
+static constexpr StringTableEntry<int> s_field_name_entries[] = {
 	{"pid", 0},
 	{"uid", 1},
 	{"euid", 2},
@@ -64,7 +64,9 @@ static StringTable<int> s_field_name_table(-1, {
 	{"a3", 203},
 	{"key", 210},
 	{"exe", 112},
-});
+};
+
+static constexpr StringTable<s_field_name_entries> s_field_name_table(-1);
 
 std::string FieldIdToName(int field) {
     auto str = std::string(s_field_name_table.ToString(field));
@@ -20,7 +20,7 @@
 
 #include <algorithm>
 
-static StringTable<field_type_t> s_field_table(field_type_t::UNCLASSIFIED, {
+static constexpr StringTableEntry<field_type_t> s_field_entries[] = {
         {"auid", field_type_t::UID},
         {"uid", field_type_t::UID},
         {"euid", field_type_t::UID},
@@ -133,7 +133,9 @@ static StringTable<field_type_t> s_field_table(field_type_t::UNCLASSIFIED, {
         {"invalid_context", field_type_t::ESCAPED},
         {"ioctlcmd", field_type_t::IOCTL_REQ},
         {"SV_INTEGRITY_HASH", field_type_t::ESCAPED},
-});
+};
+
+static constexpr StringTable<s_field_entries> s_field_table(field_type_t::UNCLASSIFIED);
 
 field_type_t FieldNameToType(const std::string_view& name) {
     return s_field_table.ToInt(name);
@@ -18,7 +18,7 @@
 #include "StringTable.h"
 #include "StringUtils.h"
 
-static StringTable<RecordType> s_record_type_table(RecordType ::UNKNOWN, {
+static constexpr StringTableEntry<RecordType> s_record_type_entries[] = {
         {"GET",RecordType::GET},
         {"SET",RecordType::SET},
         {"LIST",RecordType::LIST},
@@ -225,9 +225,11 @@ static StringTable<RecordType> s_record_type_table(RecordType ::UNKNOWN, {
         {"AUOMS_METRIC", RecordType::AUOMS_METRIC},
         {"AUOMS_AGGREGATE", RecordType::AUOMS_AGGREGATE},
         {"AUOMS_EXECVE", RecordType::AUOMS_EXECVE},
-});
+};
 
-static StringTable<RecordTypeCategory> s_record_type_category_table(RecordTypeCategory::UNKNOWN, {
+static constexpr StringTable<s_record_type_entries> s_record_type_table(RecordType::UNKNOWN);
+
+static constexpr StringTableEntry<RecordTypeCategory> s_record_type_category_entries[] = {
         {"UNKNOWN", RecordTypeCategory::UNKNOWN},
         {"KERNEL", RecordTypeCategory::KERNEL},
         {"USER_MSG", RecordTypeCategory::USER_MSG},
@@ -245,7 +247,9 @@ static StringTable<RecordTypeCategory> s_record_type_category_table(RecordTypeCa
         {"VIRT_MSG", RecordTypeCategory::VIRT_MSG},
         {"USER_MSG2", RecordTypeCategory::USER_MSG2},
         {"AUOMS_MSG", RecordTypeCategory::AUOMS_MSG},
-});
+};
+
+static constexpr StringTable<s_record_type_category_entries> s_record_type_category_table(RecordTypeCategory::UNKNOWN);
 
 std::string_view RecordTypeToName(RecordType code, std::string& unknown_str) {
     auto str = s_record_type_table.ToString(code);
@@ -18,7 +18,7 @@
 #include "StringTable.h"
 #include <stdexcept>
 
-static StringTable<uint32_t> s_i386_table(-1, {
+static constexpr StringTableEntry<uint32_t> s_i386_entries[] = {
 	{"restart_syscall", 0},
 	{"exit", 1},
 	{"fork", 2},
@@ -400,9 +400,11 @@ static StringTable<uint32_t> s_i386_table(-1, {
 	{"pkey_alloc", 381},
 	{"pkey_free", 382},
 	{"statx", 383},
-});
+};
 
-static StringTable<uint32_t> s_86_64_table(-1, {
+static constexpr StringTable<s_i386_entries> s_i386_table(-1);
+
+static constexpr StringTableEntry<uint32_t> s_86_64_entries[] = {
 	{"read", 0},
 	{"write", 1},
 	{"open", 2},
@@ -736,9 +738,11 @@ static StringTable<uint32_t> s_86_64_table(-1, {
 	{"pkey_alloc", 330},
 	{"pkey_free", 331},
 	{"statx", 332},
-});
+};
+
+static constexpr StringTable<s_86_64_entries> s_86_64_table(-1);
 
-static StringTable<uint32_t> s_arm_table(-1, {
+static constexpr StringTableEntry<uint32_t> s_arm_entries[] = {
     {"restart_syscall", 0},
     {"exit", 1},
     {"fork", 2},
@@ -1100,9 +1104,11 @@ static StringTable<uint32_t> s_arm_table(-1, {
     {"pkey_mprotect", 394},
     {"pkey_alloc", 395},
     {"pkey_free", 396},
-});
+};
 
-static StringTable<uint32_t> s_aarch64_table(-1, {
+static constexpr StringTable<s_arm_entries> s_arm_table(-1);
+
+static constexpr StringTableEntry<uint32_t> s_aarch64_entries[] = {
     {"io_setup", 0},
     {"io_destroy", 1},
     {"io_submit", 2},
@@ -1378,7 +1384,9 @@ static StringTable<uint32_t> s_aarch64_table(-1, {
     {"pkey_mprotect", 288},
     {"pkey_alloc", 289},
     {"pkey_free", 290},
-});
+};
+
+static constexpr StringTable<s_aarch64_entries> s_aarch64_table(-1);
 
 bool SyscallToName(MachineType mtype, int syscall, std::string& str) {
     std::string_view ret;
@@ -17,38 +17,78 @@
 
 #include "Logger.h"
 #include "Signals.h"
+#include "Metrics.h"
 
+#include <algorithm>
 #include <cstring>
 #include <fstream>
+#include <memory>
 
 extern "C" {
 #include <unistd.h>
+#include <pwd.h>
+#include <grp.h>
 #include <sys/inotify.h>
 #include <poll.h>
 }
 
-std::string UserDB::GetUserName(int uid)
+UserDB::IdNameTable::IdNameTable(const std::vector<std::pair<int, std::string>>& entries)
 {
-    std::lock_guard<std::mutex> lock(_lock);
-
-    auto it = _users.find(uid);
-    if (it != _users.end()) {
-        return it->second;
+    int max_dense_id = -1;
+    for (auto& e : entries) {
+        if (e.first >= 0 && e.first < DENSE_ID_LIMIT && e.first > max_dense_id) {
+            max_dense_id = e.first;
+        }
     }
+    _dense.resize(max_dense_id+1);
+    std::vector<bool> seen(max_dense_id+1, false);
+
+    for (auto& e : entries) {
+        // Just in case there are multiple entries, only the first id->name is used
+        if (e.first >= 0 && e.first <= max_dense_id) {
+            if (!seen[e.first]) {
+                seen[e.first] = true;
+                _dense[e.first] = e.second;
+            }
+        } else {
+            _sparse.emplace(e);
+        }
+    }
+}
 
-    return std::string();
+std::string UserDB::GetUserName(int uid)
+{
+    std::string name = _snapshot.Read()->users.Find(uid);
+    if (name.empty() && _nss_enabled) {
+        return nss_lookup(false, uid);
+    }
+    return name;
 }
 
 std::string UserDB::GetGroupName(int gid)
 {
-    std::lock_guard<std::mutex> lock(_lock);
-
-    auto it = _groups.find(gid);
-    if (it != _groups.end()) {
-        return it->second;
+    std::string name = _snapshot.Read()->groups.Find(gid);
+    if (name.empty() && _nss_enabled) {
+        return nss_lookup(true, gid);
     }
+    return name;
+}
 
-    return std::string();
+void UserDB::EnableNssLookup(size_t max_entries, std::chrono::seconds ttl, std::chrono::seconds negative_ttl)
+{
+    std::lock_guard<std::mutex> lock(_nss_lock);
+    _nss_enabled = max_entries > 0;
+    _nss_max_entries = max_entries;
+    _nss_ttl = ttl;
+    _nss_negative_ttl = negative_ttl;
+}
+
+void UserDB::SetNssMetrics(const std::shared_ptr<Metric>& hit_metric, const std::shared_ptr<Metric>& miss_metric, const std::shared_ptr<Metric>& latency_metric)
+{
+    std::lock_guard<std::mutex> lock(_nss_lock);
+    _nss_hit_metric = hit_metric;
+    _nss_miss_metric = miss_metric;
+    _nss_latency_metric = latency_metric;
 }
 
 void UserDB::Start()
@@ -56,6 +96,11 @@ void UserDB::Start()
     std::unique_lock<std::mutex> lock(_lock);
     if (_stop) {
         _stop = false;
+        if (_nss_enabled) {
+            std::lock_guard<std::mutex> nss_lock(_nss_lock);
+            _nss_stop = false;
+            _nss_thread = std::thread([this](){ this->nss_task(); });
+        }
         lock.unlock();
         update();
         lock.lock();
@@ -80,6 +125,164 @@ void UserDB::Stop()
         lock.unlock();
         _inotify_thread.join();
         _update_thread.join();
+
+        if (_nss_thread.joinable()) {
+            {
+                std::lock_guard<std::mutex> nss_lock(_nss_lock);
+                _nss_stop = true;
+                _nss_cond.notify_all();
+            }
+            _nss_thread.join();
+        }
+    }
+}
+
+std::string UserDB::nss_lookup(bool is_group, int id)
+{
+    auto key = nss_key(is_group, id);
+    auto now = std::chrono::steady_clock::now();
+    std::string name;
+    bool found = false;
+
+    {
+        auto table = _nss_table.Read();
+        auto itr = table->find(key);
+        if (itr != table->end()) {
+            auto& entry = *itr->second;
+            entry.last_used.store(now.time_since_epoch().count(), std::memory_order_relaxed);
+            name = entry.name;
+            found = true;
+            // Keep returning the old value while it is refreshed. nss_task() never publishes while holding
+            // _nss_lock, so it is safe to queue the refresh while still holding the table.
+            if (now >= entry.expires && !entry.refresh_queued.load(std::memory_order_relaxed) && !entry.refresh_queued.exchange(true)) {
+                if (!nss_queue(key)) {
+                    entry.refresh_queued.store(false);
+                }
+            }
+        }
+    }
+
+    if (found) {
+        if (_nss_hit_metric) {
+            _nss_hit_metric->Update(1.0);
+        }
+    } else {
+        if (_nss_miss_metric) {
+            _nss_miss_metric->Update(1.0);
+        }
+        nss_queue(key);
+    }
+
+    return name;
+}
+
+// Returns false if the queue is full
+bool UserDB::nss_queue(uint64_t key)
+{
+    std::lock_guard<std::mutex> lock(_nss_lock);
+    if (_nss_pending.count(key) != 0) {
+        return true;
+    }
+    if (_nss_queue.size() >= _nss_max_entries) {
+        return false;
+    }
+    _nss_pending.emplace(key);
+    _nss_queue.emplace_back(key);
+    _nss_cond.notify_one();
+    return true;
+}
+
+// Drop the least recently used entries until the table is no larger than _nss_max_entries
+void UserDB::nss_trim(NssTable& table)
+{
+    if (table.size() <= _nss_max_entries) {
+        return;
+    }
+    std::vector<std::pair<int64_t, uint64_t>> by_use;
+    by_use.reserve(table.size());
+    for (auto& e : table) {
+        by_use.emplace_back(e.second->last_used.load(std::memory_order_relaxed), e.first);
+    }
+    auto num_remove = table.size() - _nss_max_entries;
+    std::nth_element(by_use.begin(), by_use.begin() + num_remove, by_use.end());
+    for (size_t i = 0; i < num_remove; ++i) {
+        table.erase(by_use[i].second);
+    }
+}
+
+constexpr size_t NSS_BUF_SIZE = 16*1024;
+constexpr size_t NSS_MAX_BUF_SIZE = 1024*1024;
+
+void UserDB::nss_task()
+{
+    Signals::InitThread();
+
+    std::vector<char> buf(NSS_BUF_SIZE);
+    std::deque<uint64_t> keys;
+    std::vector<std::pair<uint64_t, std::shared_ptr<const NssEntry>>> results;
+
+    std::unique_lock<std::mutex> lock(_nss_lock);
+    while (!_nss_stop) {
+        _nss_cond.wait(lock, [this]() { return _nss_stop || !_nss_queue.empty(); });
+        if (_nss_stop) {
+            break;
+        }
+
+        // Resolve everything queued so far, then publish the results as a single new table
+        keys.swap(_nss_queue);
+        lock.unlock();
+
+        results.clear();
+        for (auto key : keys) {
+            bool is_group = (key >> 32) != 0;
+            auto id = static_cast<uint32_t>(key);
+            std::string name;
+            int ret;
+            auto start = std::chrono::steady_clock::now();
+            if (is_group) {
+                struct group grp;
+                struct group* result = nullptr;
+                while ((ret = getgrgid_r(id, &grp, buf.data(), buf.size(), &result)) == ERANGE && buf.size() < NSS_MAX_BUF_SIZE) {
+                    buf.resize(buf.size()*2);
+                }
+                if (ret == 0 && result != nullptr) {
+                    name = result->gr_name;
+                }
+            } else {
+                struct passwd pwd;
+                struct passwd* result = nullptr;
+                while ((ret = getpwuid_r(id, &pwd, buf.data(), buf.size(), &result)) == ERANGE && buf.size() < NSS_MAX_BUF_SIZE) {
+                    buf.resize(buf.size()*2);
+                }
+                if (ret == 0 && result != nullptr) {
+                    name = result->pw_name;
+                }
+            }
+            auto end = std::chrono::steady_clock::now();
+
+            if (_nss_latency_metric) {
+                _nss_latency_metric->Update(static_cast<double>(std::chrono::duration_cast<std::chrono::microseconds>(end - start).count()));
+            }
+            auto ttl = name.empty() ? _nss_negative_ttl : _nss_ttl;
+            results.emplace_back(key, std::make_shared<const NssEntry>(name, end, end + ttl));
+        }
+
+        std::unique_ptr<NssTable> table;
+        {
+            auto current = _nss_table.Read();
+            table.reset(new NssTable(*current));
+        }
+        for (auto& r : results) {
+            (*table)[r.first] = r.second;
+        }
+        nss_trim(*table);
+        _nss_table.Publish(table.release());
+
+        lock.lock();
+        for (auto key : keys) {
+            _nss_pending.erase(key);
+        }
+        keys.clear();
     }
 }
 
@@ -240,30 +443,17 @@ std::vector<std::pair<int, std::string>> parse_file(const std::string& path)
 
 void UserDB::update()
 {
-    std::unordered_map<int, std::string> users;
-    std::unordered_map<int, std::string> groups;
+    std::unique_ptr<Snapshot> snapshot(new Snapshot());
 
     try {
-        for (auto& e : parse_file(_dir + "/passwd")) {
-            // Just in case there are multiple entries, only the first id->name is used
-            if (users.count(e.first) == 0) {
-                users.emplace(e);
-            }
-        }
-        for (auto& e : parse_file(_dir + "/group")) {
-            // Just in case there are multiple entries, only the first id->name is used
-            if (groups.count(e.first) == 0) {
-                groups.emplace(e);
-            }
-        }
+        snapshot->users = IdNameTable(parse_file(_dir + "/passwd"));
+        snapshot->groups = IdNameTable(parse_file(_dir + "/group"));
     } catch (const std::exception& ex) {
         Logger::Warn("UserDB: Update failed: %s", ex.what());
         return;
     }
 
-    std::lock_guard<std::mutex> lock(_lock);
-    _users = users;
-    _groups = groups;
+    _snapshot.Publish(snapshot.release());
 }
 
 int UserDB::UserNameToUid(const std::string& name) {
@@ -18,20 +18,54 @@
 
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
+#include <atomic>
+#include <vector>
 #include <mutex>
 #include <condition_variable>
 #include <thread>
+#include <deque>
+#include <chrono>
+#include <memory>
+
+#include "SnapshotPublisher.h"
+
+class Metric;
 
 class UserDB {
 public:
-    UserDB(): _dir("/etc"), _stop(true), _inotify_fd(-1), _need_update(true) {}
+    static constexpr size_t DEFAULT_NSS_CACHE_SIZE = 4096;
+    static constexpr long DEFAULT_NSS_TTL = 600; // seconds
+    static constexpr long DEFAULT_NSS_NEGATIVE_TTL = 60; // seconds
+
+    UserDB(): _dir("/etc"), _stop(true), _inotify_fd(-1), _need_update(true), _snapshot(new Snapshot()),
+              _nss_enabled(false), _nss_stop(true), _nss_max_entries(DEFAULT_NSS_CACHE_SIZE), _nss_ttl(DEFAULT_NSS_TTL), _nss_negative_ttl(DEFAULT_NSS_NEGATIVE_TTL),
+              _nss_table(new NssTable()) {}
 
     // This constructor exists solely to enable testing.
-    UserDB(const std::string& dir): _dir(dir), _stop(true), _inotify_fd(-1), _need_update(true) {}
+    UserDB(const std::string& dir): _dir(dir), _stop(true), _inotify_fd(-1), _need_update(true), _snapshot(new Snapshot()),
+              _nss_enabled(false), _nss_stop(true), _nss_max_entries(DEFAULT_NSS_CACHE_SIZE), _nss_ttl(DEFAULT_NSS_TTL), _nss_negative_ttl(DEFAULT_NSS_NEGATIVE_TTL),
+              _nss_table(new NssTable()) {}
 
+    // These do not lock, they read from the most recently published snapshot.
+    // If NSS lookup is enabled, ids not found in the local files are looked up in the NSS cache, which is also
+    // published as an immutable snapshot. Only ids missing from (or expired in) the NSS cache take a lock.
     std::string GetUserName(int uid);
     std::string GetGroupName(int gid);
 
+    /*
+     * Resolve ids that are not in the local passwd/group files (e.g. LDAP or SSSD users) via getpwuid_r/getgrgid_r.
+     * The NSS calls are made on a background thread: a cache miss returns an empty name and queues the id, later
+     * lookups get the result once it is in the cache. Entries expire after ttl (negative_ttl if the id could not be
+     * resolved), an expired entry continues to be returned while it is refreshed. At most max_entries are cached.
+     * Must be called before Start().
+     */
+    void EnableNssLookup(size_t max_entries, std::chrono::seconds ttl, std::chrono::seconds negative_ttl);
+
+    // hit_metric and miss_metric are updated with the number of NSS cache hits/misses, latency_metric with the
+    // time (in microseconds) taken by each NSS call. Must be called before Start().
+    void SetNssMetrics(const std::shared_ptr<Metric>& hit_metric, const std::shared_ptr<Metric>& miss_metric, const std::shared_ptr<Metric>& latency_metric);
+
     void Start();
     void Stop();
 
@@ -41,8 +75,63 @@ public:
     static int GroupNameToGid(const std::string& name);
 
 private:
+    // Immutable id -> name table. Ids below DENSE_ID_LIMIT are stored in a vector indexed by id,
+    // the (rare) larger ids in a hash map.
+    class IdNameTable {
+    public:
+        static constexpr int DENSE_ID_LIMIT = 32768;
+
+        IdNameTable() = default;
+        explicit IdNameTable(const std::vector<std::pair<int, std::string>>& entries);
+
+        inline const std::string& Find(int id) const {
+            if (id >= 0 && id < static_cast<int>(_dense.size())) {
+                return _dense[id];
+            }
+            auto it = _sparse.find(id);
+            if (it != _sparse.end()) {
+                return it->second;
+            }
+            return _empty;
+        }
+
+    private:
+        std::vector<std::string> _dense;
+        std::unordered_map<int, std::string> _sparse;
+        std::string _empty;
+    };
+
+    struct Snapshot {
+        IdNameTable users;
+        IdNameTable groups;
+    };
+
     void inotify_task();
 
+    struct NssEntry {
+        NssEntry(const std::string& name, std::chrono::steady_clock::time_point now, std::chrono::steady_clock::time_point expires):
+                name(name), expires(expires), last_used(now.time_since_epoch().count()), refresh_queued(false) {}
+
+        std::string name;
+        std::chrono::steady_clock::time_point expires;
+        // Updated by lookups without locking. nss_task() drops the least recently used entries when the table is full.
+        mutable std::atomic<int64_t> last_used;
+        // Set by the first lookup that finds the entry expired, so the refresh is only queued once
+        mutable std::atomic<bool> refresh_queued;
+    };
+
+    // Immutable, keyed by nss_key(). Entries are shared between successive tables.
+    typedef std::unordered_map<uint64_t, std::shared_ptr<const NssEntry>> NssTable;
+
+    static inline uint64_t nss_key(bool is_group, int id) {
+        return (static_cast<uint64_t>(is_group) << 32) | static_cast<uint32_t>(id);
+    }
+
+    std::string nss_lookup(bool is_group, int id);
+    bool nss_queue(uint64_t key);
+    void nss_trim(NssTable& table);
+    void nss_task();
+
     void update_task();
 
     std::mutex _lock;
@@ -51,8 +140,6 @@ private:
     std::string _dir;
     bool _stop;
 
-    std::unordered_map<int, std::string> _users;
-    std::unordered_map<int, std::string> _groups;
 
     std::chrono::time_point<std::chrono::steady_clock> _last_update;
     std::chrono::time_point<std::chrono::steady_clock> _need_update_ts;
@@ -62,6 +149,24 @@ private:
 
     std::thread _inotify_thread;
     std::thread _update_thread;
+
+    SnapshotPublisher<Snapshot> _snapshot;
+
+    bool _nss_enabled;
+    bool _nss_stop;
+    size_t _nss_max_entries;
+    std::chrono::seconds _nss_ttl;
+    std::chrono::seconds _nss_negative_ttl;
+    SnapshotPublisher<NssTable> _nss_table;
+    // _nss_lock is only taken to queue an id that is missing (or expired) in _nss_table
+    std::mutex _nss_lock;
+    std::condition_variable _nss_cond;
+    std::unordered_set<uint64_t> _nss_pending;
+    std::deque<uint64_t> _nss_queue;
+    std::thread _nss_thread;
+    std::shared_ptr<Metric> _nss_hit_metric;
+    std::shared_ptr<Metric> _nss_miss_metric;
+    std::shared_ptr<Metric> _nss_latency_metric;
 };
 
 
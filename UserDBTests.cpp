@@ -113,3 +113,96 @@ BOOST_AUTO_TEST_CASE( basic_test ) {
 
     user_db.Stop();
 }
+
+BOOST_AUTO_TEST_CASE( concurrent_update_test ) {
+    TempDir dir("/tmp/UserDBTests");
+
+    write_file(dir.Path()+"/passwd", passwd);
+    write_file(dir.Path()+"/group", group);
+
+    UserDB user_db(dir.Path());
+    user_db.update();
+
+    std::atomic<bool> stop(false);
+    std::atomic<long> bad(0);
+    std::vector<std::thread> readers;
+    for (int i = 0; i < 2; ++i) {
+        readers.emplace_back([&]() {
+            while (!stop) {
+                if (user_db.GetUserName(1000) != "user" || user_db.GetGroupName(65534) != "nogroup") {
+                    bad++;
+                }
+                auto name = user_db.GetUserName(1001);
+                if (!name.empty() && name != "test") {
+                    bad++;
+                }
+            }
+        });
+    }
+
+    for (int i = 0; i < 50; ++i) {
+        write_file(dir.Path()+"/passwd", (i & 1) ? passwd : passwd2);
+        user_db.update();
+    }
+
+    stop = true;
+    for (auto& t : readers) {
+        t.join();
+    }
+
+    BOOST_CHECK_EQUAL(bad.load(), 0);
+}
+
+BOOST_AUTO_TEST_CASE( nss_lookup_test ) {
+    TempDir dir("/tmp/UserDBTests");
+
+    // uid/gid 0 are not in the local files, so they must be resolved through NSS
+    write_file(dir.Path()+"/passwd", "user:x:1000:1000:User,,,:/home/user:/bin/bash\n");
+    write_file(dir.Path()+"/group", "user:x:1000:\n");
+
+    UserDB user_db(dir.Path());
+    user_db.EnableNssLookup(16, std::chrono::seconds(600), std::chrono::seconds(60));
+    user_db.Start();
+
+    // The first lookup is a miss, the result only becomes available once the background lookup completes
+    BOOST_CHECK_EQUAL(user_db.GetUserName(0), "");
+    std::string user;
+    std::string group;
+    for (int i = 0; i < 100 && (user.empty() || group.empty()); ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        user = user_db.GetUserName(0);
+        group = user_db.GetGroupName(0);
+    }
+    BOOST_CHECK_EQUAL(user, "root");
+    BOOST_CHECK_EQUAL(group, "root");
+    BOOST_CHECK_EQUAL(user_db.GetUserName(1000), "user");
+
+    user_db.Stop();
+}
+
+BOOST_AUTO_TEST_CASE( nss_refresh_test ) {
+    TempDir dir("/tmp/UserDBTests");
+
+    write_file(dir.Path()+"/passwd", "user:x:1000:1000:User,,,:/home/user:/bin/bash\n");
+    write_file(dir.Path()+"/group", "user:x:1000:\n");
+
+    // Entries expire immediately, so every hit also queues a refresh
+    UserDB user_db(dir.Path());
+    user_db.EnableNssLookup(16, std::chrono::seconds(0), std::chrono::seconds(0));
+    user_db.Start();
+
+    std::string user;
+    for (int i = 0; i < 100 && user.empty(); ++i) {
+        user = user_db.GetUserName(0);
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    BOOST_REQUIRE_EQUAL(user, "root");
+
+    // The expired entry keeps being returned while it is refreshed
+    for (int i = 0; i < 50; ++i) {
+        BOOST_CHECK_EQUAL(user_db.GetUserName(0), "root");
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    user_db.Stop();
+}
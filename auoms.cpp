@@ -14,6 +14,7 @@
     THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 */
 #include "RawEventProcessor.h"
+#include "RawEventProcessorPool.h"
 #include "StdoutWriter.h"
 #include "StdinReader.h"
 #include "UnixDomainWriter.h"
@@ -37,6 +38,7 @@
 #include "SyscallMetrics.h"
 #include "SystemMetrics.h"
 #include "ProcMetrics.h"
+#include "ProcessInventory.h"
 #include "FileUtils.h"
 #include "CPULimits.h"
 
@@ -283,7 +285,10 @@ int main(int argc, char**argv) {
     });
     proc_metrics->Start();
 
-    Inputs inputs(config.GetInputSocketPath(), operational_status);
+    Inputs inputs(config.GetInputSocketPath(), operational_status, config.GetInputBufferSlots());
+    inputs.SetBufferMetrics(
+            metrics->AddMetric(MetricType::METRIC_BY_FILL, "input", "buffer_slots_used", MetricPeriod::SECOND, MetricPeriod::HOUR),
+            metrics->AddMetric(MetricType::METRIC_BY_ACCUMULATION, "input", "stall_usec", MetricPeriod::SECOND, MetricPeriod::HOUR));
     if (!inputs.Initialize()) {
         Logger::Error("Failed to initialize inputs");
         exit(1);
@@ -319,6 +324,15 @@ int main(int argc, char**argv) {
     rules_monitor.Start();
 
     auto user_db = std::make_shared<UserDB>();
+    if (config.GetUserDbNssCacheSize() > 0) {
+        user_db->EnableNssLookup(config.GetUserDbNssCacheSize(),
+                                 std::chrono::seconds(config.GetUserDbNssTTL()),
+                                 std::chrono::seconds(config.GetUserDbNssNegativeTTL()));
+        user_db->SetNssMetrics(
+                metrics->AddMetric(MetricType::METRIC_BY_COUNTER, "user_db", "nss_cache_hits", MetricPeriod::SECOND, MetricPeriod::HOUR),
+                metrics->AddMetric(MetricType::METRIC_BY_COUNTER, "user_db", "nss_cache_misses", MetricPeriod::SECOND, MetricPeriod::HOUR),
+                metrics->AddMetric(MetricType::METRIC_HISTOGRAM, "user_db", "nss_lookup_usec", MetricPeriod::SECOND, MetricPeriod::HOUR));
+    }
     try {
         user_db->Start();
     } catch (const std::exception& ex) {
@@ -337,6 +351,15 @@ int main(int argc, char**argv) {
         filtersEngine = std::make_shared<FiltersEngine>();
 
         processTree = std::make_shared<ProcessTree>(user_db, filtersEngine);
+        processTree->SetMemoryMetrics(
+                metrics->AddMetric(MetricType::METRIC_BY_FILL, "process_tree", "memory_bytes", MetricPeriod::SECOND, MetricPeriod::HOUR),
+                metrics->AddMetric(MetricType::METRIC_BY_FILL, "process_tree", "interned_saved_bytes", MetricPeriod::SECOND, MetricPeriod::HOUR));
+        processTree->EnableAsyncResolve(config.GetProcessTreeResolverThreads(), std::chrono::milliseconds(config.GetProcessTreeResolveWait()));
+        processTree->SetResolveMetrics(
+                metrics->AddMetric(MetricType::METRIC_BY_COUNTER, "process_tree", "lookup_hits", MetricPeriod::SECOND, MetricPeriod::HOUR),
+                metrics->AddMetric(MetricType::METRIC_BY_COUNTER, "process_tree", "lookup_misses", MetricPeriod::SECOND, MetricPeriod::HOUR),
+                metrics->AddMetric(MetricType::METRIC_BY_COUNTER, "process_tree", "resolve_timeouts", MetricPeriod::SECOND, MetricPeriod::HOUR),
+                metrics->AddMetric(MetricType::METRIC_HISTOGRAM, "process_tree", "resolve_usec", MetricPeriod::SECOND, MetricPeriod::HOUR));
         processTree->PopulateTree(); // Pre-populate tree
 
         outputsFilterFactory = std::shared_ptr<IEventFilterFactory>(
@@ -354,7 +377,8 @@ int main(int argc, char**argv) {
                 queue,
                 config.GetOutconfDir(),
                 save_dir,
-                outputsFilterFactory);
+                outputsFilterFactory,
+                metrics);
 
     std::thread autosave_thread([&]() {
         Signals::InitThread();
@@ -400,10 +424,37 @@ int main(int argc, char**argv) {
         processNotify->Start();
     }
 
-    auto event_queue = std::make_shared<EventQueue>(queue);
-    auto builder = std::make_shared<EventBuilder>(event_queue, event_prioritizer);
+    // With more than one event processor thread, events are sharded by pid across a pool of RawEventProcessor,
+    // otherwise they are processed directly on the input loop thread.
+    auto num_processor_threads = config.GetEventProcessorThreads();
+    std::unique_ptr<RawEventProcessor> rep;
+    std::unique_ptr<RawEventProcessorPool> rep_pool;
+    if (num_processor_threads > 1) {
+        Logger::Info("Using %ld event processor threads", num_processor_threads);
+        rep_pool = std::make_unique<RawEventProcessorPool>(
+                num_processor_threads,
+                RawEventProcessorPool::DEFAULT_QUEUE_DEPTH,
+                [&queue, &event_prioritizer]() {
+                    return std::make_shared<EventBuilder>(std::make_shared<EventQueue>(queue), event_prioritizer);
+                },
+                user_db, cmdline_redactor, processTree, filtersEngine, metrics);
+        rep_pool->Start();
+    } else {
+        auto event_queue = std::make_shared<EventQueue>(queue);
+        auto builder = std::make_shared<EventBuilder>(event_queue, event_prioritizer);
+        rep = std::make_unique<RawEventProcessor>(builder, user_db, cmdline_redactor, processTree, filtersEngine, metrics);
+    }
 
-    RawEventProcessor rep(builder, user_db, cmdline_redactor, processTree, filtersEngine, metrics);
+    // The process inventory is generated on its own thread, with its own EventBuilder
+    std::shared_ptr<ProcessInventory> process_inventory;
+    if (config.GetProcessInventoryInterval() > 0) {
+        auto builder = std::make_shared<EventBuilder>(std::make_shared<EventQueue>(queue), event_prioritizer);
+        process_inventory = std::make_shared<ProcessInventory>(
+                std::make_unique<RawEventProcessor>(builder, user_db, cmdline_redactor, processTree, filtersEngine, metrics),
+                std::chrono::seconds(config.GetProcessInventoryInterval()),
+                config.GetProcessInventoryRate());
+        process_inventory->Start();
+    }
     inputs.Start();
 
     Signals::SetExitHandler([&inputs]() {
@@ -412,17 +463,25 @@ int main(int argc, char**argv) {
     });
 
     bool remove_lock = true;
+    bool pool_ok = true;
+    auto handle_data = [&rep, &rep_pool, &pool_ok](void* ptr, size_t size) {
+        if (rep_pool) {
+            pool_ok = rep_pool->ProcessData(ptr, size);
+        } else {
+            rep->ProcessData(reinterpret_cast<char*>(ptr), size);
+        }
+    };
     try {
         Logger::Info("Starting input loop");
-        while (!Signals::IsExit()) {
-            if (!inputs.HandleData([&rep](void* ptr, size_t size) {
-                rep.ProcessData(reinterpret_cast<char*>(ptr), size);
-                rep.DoProcessInventory();
-            })) {
+        while (!Signals::IsExit() && pool_ok) {
+            if (!inputs.HandleData(handle_data)) {
                 break;
             };
         }
         Logger::Info("Input loop stopped");
+        // Events still in the input buffer have already been acked, so process them before exiting
+        inputs.Stop();
+        while (pool_ok && inputs.HandleData(handle_data)) {}
     } catch (const std::exception& ex) {
         Logger::Error("Unexpected exception in input loop: %s", ex.what());
         remove_lock = false;
@@ -433,7 +492,18 @@ int main(int argc, char**argv) {
 
     Logger::Info("Exiting");
 
+    if (rep_pool) {
+        // Process any events still queued in the pool before the queue is closed
+        rep_pool->Stop();
+        if (!pool_ok) {
+            remove_lock = false;
+        }
+    }
+
     try {
+        if (process_inventory) {
+            process_inventory->Stop();
+        }
         collection_monitor->Stop();
         if (!config.DisableEventFiltering()) {
             processNotify->Stop();
@@ -0,0 +1 @@
+#define AUOMS_VERSION "2.7.0.0"
\ No newline at end of file
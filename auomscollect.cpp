@@ -18,6 +18,7 @@
 #include "UnixDomainWriter.h"
 #include "Signals.h"
 #include "SPSCDataQueue.h"
+#include "SPSCRingQueue.h"
 #include "PriorityQueue.h"
 #include "Config.h"
 #include "Logger.h"
@@ -54,6 +55,9 @@
 #include "EventPrioritizer.h"
 #include "CPULimits.h"
 
+// Each batch slot uses a 16KB receive buffer
+constexpr size_t MAX_NETLINK_BATCH = 1024;
+
 void usage()
 {
     std::cerr <<
@@ -90,7 +94,7 @@ bool parsePath(std::vector<std::string>& dirs, const std::string& path_str) {
 }
 
 
-void DoStdinCollection(SPSCDataQueue& raw_queue, std::shared_ptr<Metric>& bytes_metric, std::shared_ptr<Metric>& records_metric, std::shared_ptr<Metric>& lost_bytes_metric, std::shared_ptr<Metric>& lost_segments_metric) {
+void DoStdinCollection(IDataQueue& raw_queue, std::shared_ptr<Metric>& bytes_metric, std::shared_ptr<Metric>& records_metric, std::shared_ptr<Metric>& lost_bytes_metric, std::shared_ptr<Metric>& lost_segments_metric) {
     StdinReader reader;
 
     try {
@@ -145,7 +149,7 @@ void DoStdinCollection(SPSCDataQueue& raw_queue, std::shared_ptr<Metric>& bytes_
     }
 }
 
-bool DoNetlinkCollection(SPSCDataQueue& raw_queue, std::shared_ptr<Metric>& bytes_metric, std::shared_ptr<Metric>& records_metric, std::shared_ptr<Metric>& lost_bytes_metric, std::shared_ptr<Metric>& lost_segments_metric) {
+bool DoNetlinkCollection(IDataQueue& raw_queue, std::shared_ptr<Metric>& bytes_metric, std::shared_ptr<Metric>& records_metric, std::shared_ptr<Metric>& lost_bytes_metric, std::shared_ptr<Metric>& lost_segments_metric, size_t max_batch, std::shared_ptr<Metric>& batches_metric, std::shared_ptr<Metric>& full_batches_metric) {
     // Request that that this process receive a SIGTERM if the parent process (thread in parent) dies/exits.
     auto ret = prctl(PR_SET_PDEATHSIG, SIGTERM);
     if (ret != 0) {
@@ -190,6 +194,16 @@ bool DoNetlinkCollection(SPSCDataQueue& raw_queue, std::shared_ptr<Metric>& byte
         return false;
     };
 
+    if (max_batch > 1) {
+        Logger::Info("Receiving up to %ld AUDIT NETLINK messages per batch", max_batch);
+    }
+    data_netlink.SetBatchMode(max_batch, [&batches_metric, &full_batches_metric, max_batch](size_t num_msgs) {
+        batches_metric->Update(1.0);
+        if (num_msgs >= max_batch) {
+            full_batches_metric->Update(1.0);
+        }
+    });
+
     Logger::Info("Connecting to AUDIT NETLINK socket");
     ret = data_netlink.Open(std::move(handler));
     if (ret != 0) {
@@ -391,6 +405,7 @@ int main(int argc, char**argv) {
         exit(1);
     }
 
+    std::string raw_queue_type = "segment";
     size_t raw_queue_segment_size = 1024*1024;
     size_t num_raw_queue_segments = 10;
 
@@ -410,6 +425,31 @@ int main(int argc, char**argv) {
         num_raw_queue_segments = config.GetUint64("num_raw_queue_segments");
     }
 
+    size_t netlink_max_batch = 1;
+    if (config.HasKey("netlink_max_batch")) {
+        netlink_max_batch = config.GetUint64("netlink_max_batch");
+        if (netlink_max_batch < 1) {
+            netlink_max_batch = 1;
+        } else if (netlink_max_batch > MAX_NETLINK_BATCH) {
+            netlink_max_batch = MAX_NETLINK_BATCH;
+        }
+    }
+
+    if (config.HasKey("raw_queue_type")) {
+        raw_queue_type = config.GetString("raw_queue_type");
+    }
+
+    // Default to the same total memory as the segmented queue
+    size_t raw_queue_ring_size = raw_queue_segment_size*num_raw_queue_segments;
+    if (config.HasKey("raw_queue_ring_size")) {
+        raw_queue_ring_size = config.GetUint64("raw_queue_ring_size");
+    }
+
+    if (raw_queue_type != "segment" && raw_queue_type != "ring") {
+        Logger::Error("Invalid 'raw_queue_type' value: %s", raw_queue_type.c_str());
+        exit(1);
+    }
+
     if (config.HasKey("queue_num_priorities")) {
         num_priorities = config.GetUint64("queue_num_priorities");
     }
@@ -578,7 +618,14 @@ int main(int argc, char**argv) {
     // They will be handled once Signals::Start() is called.
     Signals::Init();
 
-    SPSCDataQueue raw_queue(raw_queue_segment_size, num_raw_queue_segments);
+    std::unique_ptr<IDataQueue> raw_queue_ptr;
+    if (raw_queue_type == "ring") {
+        Logger::Info("Using ring raw queue (%ld bytes)", raw_queue_ring_size);
+        raw_queue_ptr = std::make_unique<SPSCRingQueue>(raw_queue_ring_size);
+    } else {
+        raw_queue_ptr = std::make_unique<SPSCDataQueue>(raw_queue_segment_size, num_raw_queue_segments);
+    }
+    IDataQueue& raw_queue = *raw_queue_ptr;
 
     Logger::Info("Opening queue: %s", queue_dir.c_str());
     auto queue = PriorityQueue::Open(queue_dir, num_priorities, max_file_data_size, max_unsaved_files, max_fs_bytes, max_fs_pct, min_fs_free_pct);
@@ -625,9 +672,11 @@ int main(int argc, char**argv) {
     auto ingest_records_metric = metrics->AddMetric(MetricType::METRIC_BY_ACCUMULATION, "ingest", "records", MetricPeriod::SECOND, MetricPeriod::HOUR);
     auto lost_bytes_metric = metrics->AddMetric(MetricType::METRIC_BY_ACCUMULATION, "ingest", "lost_bytes", MetricPeriod::SECOND, MetricPeriod::HOUR);
     auto lost_segments_metric = metrics->AddMetric(MetricType::METRIC_BY_ACCUMULATION, "ingest", "lost_segments", MetricPeriod::SECOND, MetricPeriod::HOUR);
+    auto netlink_batches_metric = metrics->AddMetric(MetricType::METRIC_BY_ACCUMULATION, "ingest", "netlink_batches", MetricPeriod::SECOND, MetricPeriod::HOUR);
+    auto netlink_full_batches_metric = metrics->AddMetric(MetricType::METRIC_BY_ACCUMULATION, "ingest", "netlink_full_batches", MetricPeriod::SECOND, MetricPeriod::HOUR);
 
     std::thread proc_thread([&]() {
-        std::unique_ptr<RawEventRecord> record = std::make_unique<RawEventRecord>();
+        std::unique_ptr<RawEventRecord> record = accumulator.AllocRecord();
         uint8_t* ptr;
         ssize_t size;
 
@@ -638,7 +687,7 @@ int main(int argc, char**argv) {
                 memcpy(record->Data(), data_ptr, data_size);
                 if (record->Parse(*reinterpret_cast<RecordType*>(ptr), data_size)) {
                     accumulator.AddRecord(std::move(record));
-                    record = std::make_unique<RawEventRecord>();
+                    record = accumulator.AllocRecord();
                 } else {
                     Logger::Warn("Received unparsable event data: '%s'", std::string(record->Data(), size).c_str());
                 }
@@ -663,7 +712,8 @@ int main(int argc, char**argv) {
             bool restart;
             do {
                 restart = DoNetlinkCollection(raw_queue, ingest_bytes_metric, ingest_records_metric, lost_bytes_metric,
-                                              lost_segments_metric);
+                                              lost_segments_metric, netlink_max_batch, netlink_batches_metric,
+                                              netlink_full_batches_metric);
             } while (restart);
         } else {
             DoStdinCollection(raw_queue, ingest_bytes_metric, ingest_records_metric, lost_bytes_metric,
@@ -0,0 +1,86 @@
+/*
+    microsoft-oms-auditd-plugin
+
+    Copyright (c) Microsoft Corporation
+
+    All rights reserved.
+
+    MIT License
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "FiltersEngine.h"
+#include "ProcessTree.h"
+#include "BenchUtils.h"
+
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/*
+ * Times FiltersEngine::IsEventFiltered for a process matched by 1, 10 and 100 filters.
+ *
+ * Every filter matches the process (by exe), and lists a different set of syscalls, a third of them with "!" entries.
+ * Each pass calls IsEventFiltered once for every syscall in a mix of filtered and unfiltered names, and the average
+ * time per call is reported.
+ */
+
+static const std::vector<std::string> s_syscalls = {
+        "execve", "open", "openat", "connect", "accept", "bind", "read", "write", "unlink", "rename",
+        "chmod", "chown", "setuid", "ptrace", "kill", "mmap", "socketcall", "unknown-syscall(999)",
+};
+
+void run_bench(size_t num_filters, long iterations) {
+    auto filtersEngine = std::make_shared<FiltersEngine>();
+    auto processTree = std::make_shared<ProcessTree>(nullptr, filtersEngine);
+
+    std::vector<ProcFilterSpec> filters;
+    for (size_t i = 0; i < num_filters; ++i) {
+        std::vector<std::string> syscalls;
+        if (i % 3 == 2) {
+            syscalls = {"!execve", "!" + s_syscalls[i % s_syscalls.size()], s_syscalls[(i + 7) % s_syscalls.size()]};
+        } else {
+            syscalls = {s_syscalls[i % s_syscalls.size()], s_syscalls[(i + 5) % s_syscalls.size()], "syscall" + std::to_string(i)};
+        }
+        filters.emplace_back(PFS_MATCH_EXE_EQUALS, -1, 0, 0, syscalls, "/usr/bin/filterbench", std::vector<cmdlineFilter>());
+    }
+    auto mask = filtersEngine->AddFilterList(filters, "bench");
+    auto process = processTree->AddProcess(ProcessTreeSource_execve, 1000, 1, 0, 0, "/usr/bin/filterbench", "filterbench");
+
+    uint64_t sum = 0;
+    auto start = now_ns();
+    for (long i = 0; i < iterations; ++i) {
+        for (auto& syscall : s_syscalls) {
+            sum += filtersEngine->IsEventFiltered(syscall, process, mask) ? 1 : 0;
+        }
+    }
+    auto elapsed = now_ns() - start;
+    bench_sink(sum);
+
+    auto calls = static_cast<double>(s_syscalls.size()) * static_cast<double>(iterations);
+    std::cout << std::right << std::setw(4) << num_filters << " filters "
+              << std::fixed << std::setprecision(2) << std::setw(10) << (static_cast<double>(elapsed) / calls) << " ns/event"
+              << std::setw(8) << std::setprecision(1) << (100.0 * static_cast<double>(sum) / calls) << "% filtered"
+              << std::endl;
+}
+
+int main(int argc, char** argv) {
+    long iterations = 100000;
+
+    bench_parse_args(argc, argv, "filterbench", {
+        {'n', "iterations", "The number of passes over the syscall names. Default is 100000.", bench_int_arg(iterations, 1L)},
+    });
+
+    for (size_t num_filters : {1, 10, 100}) {
+        run_bench(num_filters, iterations);
+    }
+
+    return 0;
+}
@@ -0,0 +1,102 @@
+/*
+    microsoft-oms-auditd-plugin
+
+    Copyright (c) Microsoft Corporation
+
+    All rights reserved.
+
+    MIT License
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "EventMatcher.h"
+#include "Event.h"
+#include "RecordType.h"
+#include "BenchUtils.h"
+
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+/*
+ * Times EventMatcher::Match for rules made of plain EQ/IN literals (hash lookup) and for the equivalent regex rules
+ * (RE2::Set).
+ *
+ * Each rule matches the syscall and a distinct exe and key. The event matches the last rule, and the average time
+ * per Match() call is reported.
+ */
+
+int main(int argc, char** argv) {
+    long iterations = 100000;
+    int num_rules = 20;
+
+    bench_parse_args(argc, argv, "matcherbench", {
+        {'n', "iterations", "The number of Match() calls. Default is 100000.", bench_int_arg(iterations, 1L)},
+        {'r', "rules", "The number of rules. Default is 20.", bench_int_arg(num_rules, 1)},
+    });
+
+    auto last = std::to_string(num_rules-1);
+    auto exe = "/usr/bin/prog" + last;
+    auto key = "key" + last;
+
+    auto allocator = std::make_shared<BasicEventBuilderAllocator>();
+    auto prioritizer = DefaultPrioritizer::Create(0);
+    auto builder = std::make_shared<EventBuilder>(std::dynamic_pointer_cast<IEventBuilderAllocator>(allocator), prioritizer);
+
+    builder->BeginEvent(0, 0, 0, 1);
+    builder->BeginRecord(static_cast<uint32_t>(RecordType::AUOMS_EXECVE), "", "", 3);
+    builder->AddField("syscall", "59", "execve", field_type_t::SYSCALL);
+    builder->AddField("exe", exe.c_str(), nullptr, field_type_t::UNESCAPED);
+    builder->AddField("key", key.c_str(), nullptr, field_type_t::UNESCAPED);
+    builder->EndRecord();
+    if (builder->EndEvent() != 1) {
+        std::cerr << "Failed to build event" << std::endl;
+        return 1;
+    }
+    auto event = allocator->GetEvent();
+
+    for (bool literal : {true, false}) {
+        // A trailing "()" keeps the pattern from being treated as a literal without changing what it matches
+        std::string suffix = literal ? "" : "()";
+        std::vector<std::shared_ptr<EventMatchRule>> rules;
+        for (int i = 0; i < num_rules; i++) {
+            auto n = std::to_string(i);
+            rules.emplace_back(std::make_shared<EventMatchRule>(std::unordered_set<RecordType>({RecordType::AUOMS_EXECVE}), std::vector<std::shared_ptr<FieldMatchRule>>({
+                std::make_shared<FieldMatchRule>("syscall", FIELD_OP_IN, std::vector<std::string>({"execve" + suffix, "execveat" + suffix})),
+                std::make_shared<FieldMatchRule>("exe", FIELD_OP_EQ, "/usr/bin/prog" + n + suffix),
+                std::make_shared<FieldMatchRule>("key", FIELD_OP_EQ, "key" + n + suffix),
+            })));
+        }
+
+        EventMatcher matcher;
+        if (!matcher.Compile(rules)) {
+            std::cerr << "Failed to compile rules" << std::endl;
+            return 1;
+        }
+
+        auto start = now_ns();
+        for (long i = 0; i < iterations; i++) {
+            if (matcher.Match(event) != num_rules-1) {
+                std::cerr << "Unexpected match result" << std::endl;
+                return 1;
+            }
+        }
+        auto elapsed = now_ns() - start;
+
+        std::cout << std::left << std::setw(28) << (literal ? "EventMatcher (literal)" : "EventMatcher (regex)")
+                  << std::right << std::setw(8) << num_rules << " rules "
+                  << std::fixed << std::setprecision(2) << std::setw(10) << (static_cast<double>(elapsed) / static_cast<double>(iterations)) << " ns/event"
+                  << std::endl;
+    }
+
+    return 0;
+}
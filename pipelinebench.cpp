@@ -0,0 +1,523 @@
+/*
+    microsoft-oms-auditd-plugin
+
+    Copyright (c) Microsoft Corporation
+
+    All rights reserved.
+
+    MIT License
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "Logger.h"
+#include "Signals.h"
+#include "TempDir.h"
+#include "TestEventData.h"
+#include "TestEventQueue.h"
+#include "RawEventRecord.h"
+#include "RawEventAccumulator.h"
+#include "RawEventProcessor.h"
+#include "PriorityQueue.h"
+#include "EventQueue.h"
+#include "Output.h"
+#include "UnixDomainListener.h"
+#include "StringUtils.h"
+#include "BenchUtils.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <thread>
+#include <unordered_map>
+
+extern "C" {
+#include <unistd.h>
+#include <stdlib.h>
+}
+
+/*
+ * Replays an audit stream through RawEventAccumulator -> RawEventProcessor -> PriorityQueue -> Output -> a null
+ * IEventWriter and reports per-stage throughput, allocations, and the end-to-end latency distribution.
+ *
+ * The stream is either the raw_test_events from TestEventData.cpp or a file with one raw audit record per line
+ * (e.g. /var/log/audit/audit.log). It is replayed -n times, with each event given a new unique serial so that
+ * every replayed event can be tracked through the pipeline. The replayed records are then parsed again on their own to
+ * report RawEventRecord::Parse throughput without the per-record timing overhead.
+ */
+
+/****************************************************************************
+ * Allocation counting
+ ****************************************************************************/
+
+static thread_local uint64_t t_num_allocs = 0;
+
+void* operator new(size_t size) {
+    t_num_allocs++;
+    void* ptr = malloc(size > 0 ? size : 1);
+    if (ptr == nullptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void operator delete(void* ptr) noexcept {
+    free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+    free(ptr);
+}
+
+/****************************************************************************
+ * Stage instrumentation
+ ****************************************************************************/
+
+struct StageStats {
+    uint64_t ns = 0;
+    uint64_t allocs = 0;
+    uint64_t count = 0;
+};
+
+// Wraps an IEventBuilderAllocator and records the time and allocations spent in Commit()
+class TimedAllocator: public IEventBuilderAllocator {
+public:
+    TimedAllocator(std::shared_ptr<IEventBuilderAllocator> allocator, StageStats& stats): _allocator(std::move(allocator)), _stats(stats) {}
+
+    bool Allocate(void** data, size_t size) override {
+        return _allocator->Allocate(data, size);
+    }
+
+    int Commit() override {
+        auto start_allocs = t_num_allocs;
+        auto start = now_ns();
+        auto ret = _allocator->Commit();
+        _stats.ns += now_ns() - start;
+        _stats.allocs += t_num_allocs - start_allocs;
+        if (ret == 1) {
+            _stats.count++;
+        }
+        return ret;
+    }
+
+    bool Rollback() override {
+        return _allocator->Rollback();
+    }
+
+private:
+    std::shared_ptr<IEventBuilderAllocator> _allocator;
+    StageStats& _stats;
+};
+
+// Hands each raw event built by RawEventAccumulator directly to RawEventProcessor (as Inputs does in auoms)
+class RawEventProcessorAllocator: public IEventBuilderAllocator {
+public:
+    explicit RawEventProcessorAllocator(std::shared_ptr<RawEventProcessor> proc): _buffer(), _size(0), _proc(std::move(proc)) {}
+
+    bool Allocate(void** data, size_t size) override {
+        _size = size;
+        if (_buffer.size() < _size) {
+            _buffer.resize(_size);
+        }
+        *data = _buffer.data();
+        return true;
+    }
+
+    int Commit() override {
+        _proc->ProcessData(_buffer.data(), _size);
+        _size = 0;
+        return 1;
+    }
+
+    bool Rollback() override {
+        _size = 0;
+        return true;
+    }
+
+private:
+    std::vector<uint8_t> _buffer;
+    size_t _size;
+    std::shared_ptr<RawEventProcessor> _proc;
+};
+
+// Discards all events, but records the latency (from first record ingest) of each event
+class NullEventWriter: public IEventWriter {
+public:
+    NullEventWriter(const std::vector<uint64_t>& ingest_ns, std::vector<uint64_t>& latency_ns, uint64_t first_serial)
+        : _ingest_ns(ingest_ns), _latency_ns(latency_ns), _first_serial(first_serial), _count(0), _first_ns(0), _last_ns(0), _first_allocs(0), _last_allocs(0) {}
+
+    bool SupportsAckMode() override { return false; }
+
+    ssize_t WriteEvent(const Event& event, IWriter* writer) override {
+        auto now = now_ns();
+        auto serial = event.Serial();
+        if (serial >= _first_serial && serial-_first_serial < _ingest_ns.size()) {
+            auto ingest = _ingest_ns[serial-_first_serial];
+            if (ingest > 0 && _latency_ns.size() < _latency_ns.capacity()) {
+                _latency_ns.push_back(now - ingest);
+            }
+        }
+        if (_count.load(std::memory_order_relaxed) == 0) {
+            _first_ns = now;
+            _first_allocs = t_num_allocs;
+        }
+        _last_ns = now;
+        _last_allocs = t_num_allocs;
+        _count.fetch_add(1, std::memory_order_release);
+        return IWriter::OK;
+    }
+
+    ssize_t ReadAck(EventId& event_id, IReader* reader) override {
+        return IO::FAILED;
+    }
+
+    uint64_t Count() { return _count.load(std::memory_order_acquire); }
+
+    // Only valid once Count() has reached the expected value
+    uint64_t FirstNs() { return _first_ns; }
+    uint64_t LastNs() { return _last_ns; }
+    uint64_t Allocs() { return _last_allocs - _first_allocs; }
+
+private:
+    const std::vector<uint64_t>& _ingest_ns;
+    std::vector<uint64_t>& _latency_ns;
+    uint64_t _first_serial;
+    std::atomic<uint64_t> _count;
+    uint64_t _first_ns;
+    uint64_t _last_ns;
+    uint64_t _first_allocs;
+    uint64_t _last_allocs;
+};
+
+class NullEventWriterFactory: public IEventWriterFactory {
+public:
+    explicit NullEventWriterFactory(std::shared_ptr<NullEventWriter> writer): _writer(std::move(writer)) {}
+
+    std::shared_ptr<IEventWriter> CreateEventWriter(const std::string& name, const Config& config) override {
+        return _writer;
+    }
+
+private:
+    std::shared_ptr<NullEventWriter> _writer;
+};
+
+/****************************************************************************
+ * Input stream
+ ****************************************************************************/
+
+struct StreamRecord {
+    std::string text;
+    size_t id_start; // Offset of the event id (<sec>.<msec>:<serial>) in text
+    size_t id_size;
+    bool flush_after;
+};
+
+std::vector<StreamRecord> load_stream(const std::string& input_file) {
+    std::vector<std::pair<std::string, bool>> lines;
+    if (input_file.empty()) {
+        for (size_t i = 0; i < raw_test_events.size(); ++i) {
+            auto event_lines = split(std::string(raw_test_events[i]), '\n');
+            for (size_t l = 0; l < event_lines.size(); ++l) {
+                lines.emplace_back(event_lines[l], raw_events_do_flush[i] && l+1 == event_lines.size());
+            }
+        }
+    } else {
+        std::ifstream in(input_file);
+        if (!in.is_open()) {
+            throw std::runtime_error("Failed to open input file: " + input_file);
+        }
+        std::string line;
+        while (std::getline(in, line)) {
+            lines.emplace_back(line, false);
+        }
+        // Flush any incomplete events at the end of each replay
+        if (!lines.empty()) {
+            lines.back().second = true;
+        }
+    }
+
+    std::vector<StreamRecord> records;
+    for (auto& line : lines) {
+        auto start = line.first.find("audit(");
+        if (start == std::string::npos || line.first.size() > RawEventRecord::MAX_RECORD_SIZE) {
+            continue;
+        }
+        start += 6;
+        auto end = line.first.find("):", start);
+        if (end == std::string::npos) {
+            continue;
+        }
+        records.emplace_back(StreamRecord({line.first, start, end-start, line.second}));
+    }
+    return records;
+}
+
+/****************************************************************************
+ * Parse only
+ ****************************************************************************/
+
+// Times RawEventRecord::Parse on its own, with a pooled record and without the per-record timing of the replay
+StageStats run_parse_bench(const std::vector<std::string>& lines) {
+    RawEventRecordPool pool;
+    StageStats stats;
+    auto start_allocs = t_num_allocs;
+    auto start = now_ns();
+    for (auto& line : lines) {
+        auto record = pool.Alloc();
+        std::memcpy(record->Data(), line.data(), line.size());
+        if (record->Parse(RecordType::UNKNOWN, line.size())) {
+            stats.count++;
+        }
+        pool.Release(std::move(record));
+    }
+    stats.ns = now_ns() - start;
+    stats.allocs = t_num_allocs - start_allocs;
+    return stats;
+}
+
+/****************************************************************************
+ * Report
+ ****************************************************************************/
+
+void print_stage(const char* name, const StageStats& stats, uint64_t num_events) {
+    double secs = static_cast<double>(std::max<uint64_t>(stats.ns, 1))/1e9;
+    printf("%-12s %12.3f %14.0f %14.0f %12.2f\n", name, static_cast<double>(stats.ns)/1e6,
+           static_cast<double>(stats.count)/secs, static_cast<double>(num_events)/secs,
+           num_events > 0 ? static_cast<double>(stats.allocs)/static_cast<double>(num_events) : 0.0);
+}
+
+uint64_t percentile(const std::vector<uint64_t>& sorted, double pct) {
+    if (sorted.empty()) {
+        return 0;
+    }
+    auto idx = static_cast<size_t>(pct/100.0 * static_cast<double>(sorted.size()-1));
+    return sorted[idx];
+}
+
+int main(int argc, char**argv) {
+    std::string input_file;
+    int num_iterations = 1000;
+    bool batch_mode = false;
+
+    bench_parse_args(argc, argv, "pipelinebench", {
+        {'i', "input file", "File with one raw audit record per line. Default is the TestEventData raw events.", bench_str_arg(input_file)},
+        {'n', "iterations", "The number of times to replay the input. Default is 1000.", bench_int_arg(num_iterations, 1)},
+        {'b', nullptr, "Enable output batch mode.", bench_flag(batch_mode)},
+    });
+
+    Signals::Init();
+    Signals::Start();
+
+    std::vector<StreamRecord> stream;
+    try {
+        stream = load_stream(input_file);
+    } catch (std::exception& ex) {
+        std::cerr << ex.what() << std::endl;
+        exit(1);
+    }
+    if (stream.empty()) {
+        std::cerr << "No audit records found in input" << std::endl;
+        exit(1);
+    }
+
+    // Build the replayed stream up front, with a unique serial for each (iteration, original event id)
+    constexpr uint64_t FIRST_SERIAL = 1000000000;
+    std::vector<std::string> lines;
+    std::vector<uint64_t> line_serials;
+    std::vector<bool> line_flush;
+    lines.reserve(stream.size()*num_iterations);
+    line_serials.reserve(stream.size()*num_iterations);
+    line_flush.reserve(stream.size()*num_iterations);
+    uint64_t next_serial = FIRST_SERIAL;
+    size_t num_bytes = 0;
+    for (int i = 0; i < num_iterations; ++i) {
+        std::unordered_map<std::string, uint64_t> serials;
+        for (auto& rec : stream) {
+            auto id = rec.text.substr(rec.id_start, rec.id_size);
+            auto it = serials.find(id);
+            if (it == serials.end()) {
+                it = serials.emplace(id, next_serial++).first;
+            }
+            auto colon = id.find(':');
+            std::string new_id = id.substr(0, colon == std::string::npos ? id.size() : colon) + ":" + std::to_string(it->second);
+            std::string line = rec.text.substr(0, rec.id_start) + new_id + rec.text.substr(rec.id_start + rec.id_size);
+            num_bytes += line.size();
+            lines.emplace_back(std::move(line));
+            line_serials.emplace_back(it->second);
+            line_flush.emplace_back(rec.flush_after);
+        }
+    }
+    uint64_t num_input_events = next_serial - FIRST_SERIAL;
+
+    TempDir dir("/tmp/pipelinebench");
+
+    std::ofstream(dir.Path() + "/passwd") << passwd_file_text;
+    std::ofstream(dir.Path() + "/group") << group_file_text;
+    auto user_db = std::make_shared<UserDB>(dir.Path());
+    user_db->update();
+
+    std::vector<uint64_t> ingest_ns(num_input_events, 0);
+    std::vector<uint64_t> latency_ns;
+    latency_ns.reserve(num_input_events);
+
+    auto queue = PriorityQueue::Open(dir.Path() + "/queue", 8, 1024*1024, 8, 0, 100, 0);
+    if (!queue) {
+        std::cerr << "Failed to open queue" << std::endl;
+        exit(1);
+    }
+
+    auto prioritizer = DefaultPrioritizer::Create(0);
+    auto metrics_builder = std::make_shared<EventBuilder>(std::make_shared<TestEventQueue>(), prioritizer);
+    auto metrics = std::make_shared<Metrics>("pipelinebench", metrics_builder);
+
+    StageStats parse_stats;
+    StageStats accumulate_stats;
+    StageStats process_stats;
+    StageStats queue_stats;
+
+    auto queue_allocator = std::make_shared<TimedAllocator>(std::make_shared<EventQueue>(queue), queue_stats);
+    auto builder = std::make_shared<EventBuilder>(queue_allocator, prioritizer);
+    auto cmdline_redactor = std::make_shared<CmdlineRedactor>();
+    auto raw_proc = std::make_shared<RawEventProcessor>(builder, user_db, cmdline_redactor, nullptr, nullptr, metrics);
+    auto proc_allocator = std::make_shared<TimedAllocator>(std::make_shared<RawEventProcessorAllocator>(raw_proc), process_stats);
+    auto raw_builder = std::make_shared<EventBuilder>(proc_allocator, prioritizer);
+    RawEventAccumulator accumulator(raw_builder, metrics);
+
+    // Output needs a connected socket, even though the null writer never writes to it
+    std::string socket_path = dir.Path() + "/output.socket";
+    UnixDomainListener listener(socket_path);
+    if (!listener.Open()) {
+        std::cerr << "Failed to open output socket" << std::endl;
+        exit(1);
+    }
+    std::thread drain_thread([&listener]() {
+        int fd = listener.Accept();
+        if (fd > 0) {
+            std::array<char, 4096> buf;
+            while (read(fd, buf.data(), buf.size()) > 0) {}
+            close(fd);
+        }
+    });
+
+    auto null_writer = std::make_shared<NullEventWriter>(ingest_ns, latency_ns, FIRST_SERIAL);
+    auto output_config = std::make_unique<Config>(std::unordered_map<std::string, std::string>({
+        {"output_format", "raw"},
+        {"output_socket", socket_path},
+        {"enable_ack_mode", "false"},
+        {"enable_batch_mode", batch_mode ? "true" : "false"},
+    }));
+    Output output("output", "", queue, std::make_shared<NullEventWriterFactory>(null_writer), nullptr);
+    if (!output.Load(output_config)) {
+        std::cerr << "Failed to load output config" << std::endl;
+        exit(1);
+    }
+    output.Start();
+
+    auto start_allocs = t_num_allocs;
+    auto start = now_ns();
+    for (size_t i = 0; i < lines.size(); ++i) {
+        auto& line = lines[i];
+        auto idx = line_serials[i] - FIRST_SERIAL;
+        if (ingest_ns[idx] == 0) {
+            ingest_ns[idx] = now_ns();
+        }
+
+        auto t0 = now_ns();
+        auto a0 = t_num_allocs;
+        auto record = accumulator.AllocRecord();
+        std::memcpy(record->Data(), line.data(), line.size());
+        bool parsed = record->Parse(RecordType::UNKNOWN, line.size());
+        auto t1 = now_ns();
+        auto a1 = t_num_allocs;
+        parse_stats.ns += t1 - t0;
+        parse_stats.allocs += a1 - a0;
+        parse_stats.count++;
+        if (!parsed) {
+            continue;
+        }
+        accumulator.AddRecord(std::move(record));
+        if (line_flush[i]) {
+            accumulator.Flush(0);
+        }
+        accumulate_stats.ns += now_ns() - t1;
+        accumulate_stats.allocs += t_num_allocs - a1;
+    }
+    accumulator.Flush(0);
+    auto feed_end = now_ns();
+    auto feed_allocs = t_num_allocs - start_allocs;
+
+    // The accumulate time includes the nested process and queue time, and process includes queue
+    accumulate_stats.ns -= std::min(accumulate_stats.ns, process_stats.ns);
+    accumulate_stats.allocs -= std::min(accumulate_stats.allocs, process_stats.allocs);
+    accumulate_stats.count = process_stats.count;
+    process_stats.ns -= std::min(process_stats.ns, queue_stats.ns);
+    process_stats.allocs -= std::min(process_stats.allocs, queue_stats.allocs);
+    process_stats.count = queue_stats.count;
+
+    // Wait for output to drain the queue
+    uint64_t expected = queue_stats.count;
+    auto wait_start = std::chrono::steady_clock::now();
+    while (null_writer->Count() < expected && std::chrono::steady_clock::now() - wait_start < std::chrono::seconds(60)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    auto output_count = null_writer->Count();
+
+    output.Stop();
+    queue->Close();
+    listener.Close();
+    drain_thread.join();
+
+    StageStats output_stats;
+    output_stats.ns = null_writer->LastNs() - null_writer->FirstNs();
+    output_stats.allocs = null_writer->Allocs();
+    output_stats.count = output_count;
+
+    double feed_secs = static_cast<double>(feed_end - start)/1e9;
+    double total_secs = static_cast<double>(null_writer->LastNs() - start)/1e9;
+
+    printf("Input: %ld records, %ld events, %ld bytes (%d iterations)\n", lines.size(), num_input_events, num_bytes, num_iterations);
+    printf("Output: %ld of %ld queued events written\n", output_count, expected);
+    if (output_count < expected) {
+        printf("WARNING: timed out waiting for output\n");
+    }
+    printf("\n");
+    printf("%-12s %12s %14s %14s %12s\n", "stage", "time (ms)", "items/sec", "events/sec", "allocs/event");
+    print_stage("parse", parse_stats, num_input_events);
+    print_stage("accumulate", accumulate_stats, num_input_events);
+    print_stage("process", process_stats, num_input_events);
+    print_stage("queue", queue_stats, num_input_events);
+    print_stage("output", output_stats, num_input_events);
+    printf("\n");
+    printf("Ingest: %.0f events/sec, %.1f MB/sec, %.2f allocs/event\n",
+           static_cast<double>(num_input_events)/feed_secs, static_cast<double>(num_bytes)/feed_secs/(1024.0*1024.0),
+           static_cast<double>(feed_allocs)/static_cast<double>(num_input_events));
+    printf("End-to-end: %.0f events/sec\n", static_cast<double>(output_count)/total_secs);
+
+    auto parse_only = run_parse_bench(lines);
+    double parse_secs = static_cast<double>(std::max<uint64_t>(parse_only.ns, 1))/1e9;
+    printf("Parse only: %ld of %ld records parsed, %.0f records/sec, %.1f MB/sec, %.2f allocs/record\n",
+           parse_only.count, lines.size(), static_cast<double>(lines.size())/parse_secs,
+           static_cast<double>(num_bytes)/parse_secs/(1024.0*1024.0),
+           static_cast<double>(parse_only.allocs)/static_cast<double>(lines.size()));
+
+    std::sort(latency_ns.begin(), latency_ns.end());
+    printf("Latency (usec): p50 %.1f, p90 %.1f, p99 %.1f, p99.9 %.1f, max %.1f (%ld samples)\n",
+           static_cast<double>(percentile(latency_ns, 50))/1e3,
+           static_cast<double>(percentile(latency_ns, 90))/1e3,
+           static_cast<double>(percentile(latency_ns, 99))/1e3,
+           static_cast<double>(percentile(latency_ns, 99.9))/1e3,
+           static_cast<double>(percentile(latency_ns, 100))/1e3,
+           latency_ns.size());
+
+    exit(output_count < expected ? 1 : 0);
+}
@@ -0,0 +1,173 @@
+/*
+    microsoft-oms-auditd-plugin
+
+    Copyright (c) Microsoft Corporation
+
+    All rights reserved.
+
+    MIT License
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "SPSCDataQueue.h"
+#include "SPSCRingQueue.h"
+#include "PriorityQueue.h"
+#include "TempDir.h"
+#include "BenchUtils.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+ * Measures the throughput of the auomscollect raw ingest queues and of the in-memory PriorityQueue path.
+ *
+ * For the SPSC queues, one thread writes items as fast as possible while the main thread reads them. The number of
+ * items received (the queues drop items when they are full) and the items per second are reported.
+ *
+ * For PriorityQueue, all items are Put() (spread over 8 priorities) then read back with Get(). No saver is started.
+ * Items per second and heap allocations per item are reported for each.
+ */
+
+// Count heap allocations so that the PriorityQueue benchmark can report allocations per item
+static std::atomic<uint64_t> s_num_allocs(0);
+
+void* operator new(size_t size) {
+    s_num_allocs.fetch_add(1, std::memory_order_relaxed);
+    void* ptr = malloc(size);
+    if (ptr == nullptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void operator delete(void* ptr) noexcept {
+    free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+    free(ptr);
+}
+
+void report(const std::string& name, long count, long num_items, uint64_t elapsed_ns) {
+    std::cout << std::left << std::setw(28) << name
+              << std::right << std::setw(10) << count << "/" << num_items << " items received "
+              << std::fixed << std::setprecision(0) << std::setw(12) << (static_cast<double>(count) * 1000000000.0 / static_cast<double>(std::max<uint64_t>(elapsed_ns, 1))) << " items/sec"
+              << std::endl;
+}
+
+void run_spsc_bench(const std::string& name, IDataQueue& queue, long num_items, size_t item_size) {
+    auto start = now_ns();
+
+    std::thread _thread([&queue, num_items, item_size](){
+        for (long i = 0; i < num_items; ++i) {
+            auto in_ptr = queue.Allocate(item_size);
+            reinterpret_cast<uint32_t*>(in_ptr)[0] = static_cast<uint32_t>(i);
+            queue.Commit(item_size);
+        }
+        queue.Close();
+    });
+
+    long count = 0;
+    uint8_t* out_ptr;
+    while (queue.Get(&out_ptr) > 0) {
+        count += 1;
+        queue.Release();
+    }
+    _thread.join();
+
+    auto elapsed = now_ns() - start;
+    report(name, count, num_items, elapsed);
+}
+
+void report_allocs(const std::string& name, long num_items, uint64_t elapsed_ns, uint64_t allocs) {
+    std::cout << std::left << std::setw(28) << name
+              << std::right << std::fixed << std::setprecision(0) << std::setw(12) << (static_cast<double>(num_items) * 1000000000.0 / static_cast<double>(std::max<uint64_t>(elapsed_ns, 1))) << " items/sec "
+              << std::setprecision(2) << std::setw(8) << (static_cast<double>(allocs) / static_cast<double>(num_items)) << " allocations/item"
+              << std::endl;
+}
+
+bool run_priority_queue_bench(long num_items, size_t item_size) {
+    TempDir dir("/tmp/queuebench");
+
+    auto queue = PriorityQueue::Open(dir.Path(), 8, 1024*1024, 1024, 0, 0, 0);
+    if (!queue) {
+        std::cerr << "Failed to open PriorityQueue" << std::endl;
+        return false;
+    }
+
+    auto cursor_handle = queue->OpenCursor("bench");
+
+    std::vector<uint8_t> data(item_size, 0);
+
+    auto start_allocs = s_num_allocs.load();
+    auto start = now_ns();
+    for (long i = 0; i < num_items; i++) {
+        reinterpret_cast<uint32_t*>(data.data())[0] = static_cast<uint32_t>(i);
+        if (queue->Put(i % 8, data.data(), data.size()) != 1) {
+            std::cerr << "PriorityQueue::Put() failed" << std::endl;
+            return false;
+        }
+    }
+    auto put_elapsed = now_ns() - start;
+    auto put_allocs = s_num_allocs.load() - start_allocs;
+
+    start_allocs = s_num_allocs.load();
+    start = now_ns();
+    long count = 0;
+    for (;;) {
+        auto val = queue->Get(cursor_handle, 0);
+        if (!val.first) {
+            break;
+        }
+        count += 1;
+    }
+    auto get_elapsed = now_ns() - start;
+    auto get_allocs = s_num_allocs.load() - start_allocs;
+
+    queue->Close();
+
+    if (count != num_items) {
+        std::cerr << "PriorityQueue::Get() returned " << count << " of " << num_items << " items" << std::endl;
+        return false;
+    }
+
+    report_allocs("PriorityQueue::Put", num_items, put_elapsed, put_allocs);
+    report_allocs("PriorityQueue::Get", num_items, get_elapsed, get_allocs);
+    return true;
+}
+
+int main(int argc, char** argv) {
+    long num_items = 2000000;
+    long item_size = 128;
+
+    bench_parse_args(argc, argv, "queuebench", {
+        {'n', "items", "The number of items pushed through each queue. Default is 2000000.", bench_int_arg(num_items, 1L)},
+        {'s', "item size", "The size (in bytes) of each item. Default is 128.", bench_int_arg(item_size, static_cast<long>(sizeof(uint32_t)))},
+    });
+
+    SPSCDataQueue segment_queue(1024*1024, 10);
+    run_spsc_bench("SPSCDataQueue", segment_queue, num_items, static_cast<size_t>(item_size));
+
+    SPSCRingQueue ring_queue(1024*1024*10);
+    run_spsc_bench("SPSCRingQueue", ring_queue, num_items, static_cast<size_t>(item_size));
+
+    if (!run_priority_queue_bench(num_items, static_cast<size_t>(item_size))) {
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,121 @@
+/*
+    microsoft-oms-auditd-plugin
+
+    Copyright (c) Microsoft Corporation
+
+    All rights reserved.
+
+    MIT License
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "Translate.h"
+#include "BenchUtils.h"
+
+#include <cstdint>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/*
+ * Times the syscall, record type and field name translation functions used on the event processing path.
+ *
+ * Each function is called with every known name (or value) in turn, followed by a few names that are not in the
+ * table so the miss path is also exercised, and the average time per call is reported.
+ */
+
+void run_bench(const std::string& name, size_t num_inputs, long iterations, const std::function<uint64_t(size_t)>& fn) {
+    uint64_t sum = 0;
+    auto start = now_ns();
+    for (long i = 0; i < iterations; ++i) {
+        for (size_t idx = 0; idx < num_inputs; ++idx) {
+            sum += fn(idx);
+        }
+    }
+    auto elapsed = now_ns() - start;
+    bench_sink(sum);
+
+    auto calls = static_cast<double>(num_inputs) * static_cast<double>(iterations);
+    std::cout << std::left << std::setw(28) << name
+              << std::right << std::setw(8) << num_inputs << " inputs "
+              << std::fixed << std::setprecision(2) << std::setw(10) << (static_cast<double>(elapsed) / calls) << " ns/call"
+              << std::endl;
+}
+
+int main(int argc, char** argv) {
+    long iterations = 10000;
+
+    bench_parse_args(argc, argv, "translatebench", {
+        {'n', "iterations", "The number of passes over each set of inputs. Default is 10000.", bench_int_arg(iterations, 1L)},
+    });
+
+    std::vector<std::string> misses = {"not_a_name", "x", "open_by_handle_atx", "SYSCAL", ""};
+
+    std::vector<int> syscall_nums;
+    std::vector<std::string> syscall_names;
+    std::string str;
+    for (int i = 0; i < 1024; ++i) {
+        if (SyscallToName(MachineType::X86_64, i, str)) {
+            syscall_nums.push_back(i);
+            syscall_names.push_back(str);
+        }
+    }
+    syscall_names.insert(syscall_names.end(), misses.begin(), misses.end());
+
+    std::vector<RecordType> record_types;
+    std::vector<std::string> record_names;
+    for (int i = 0; i < 3000; ++i) {
+        auto name = RecordTypeToName(static_cast<RecordType>(i));
+        if (name.compare(0, 8, "UNKNOWN[") != 0) {
+            record_types.push_back(static_cast<RecordType>(i));
+            record_names.push_back(name);
+        }
+    }
+    record_names.insert(record_names.end(), misses.begin(), misses.end());
+
+    std::vector<std::string> field_names = {
+            "type", "arch", "syscall", "success", "exit", "a0", "a1", "a2", "a3", "items", "ppid", "pid", "auid",
+            "uid", "gid", "euid", "suid", "fsuid", "egid", "sgid", "fsgid", "tty", "ses", "comm", "exe", "key",
+            "cwd", "name", "inode", "dev", "mode", "ouid", "ogid", "rdev", "nametype", "cap_fp", "cap_fi", "cap_fe",
+            "cap_fver", "proctitle", "argc", "saddr", "subj", "obj", "res", "op", "acct", "hostname", "addr", "terminal",
+    };
+    field_names.insert(field_names.end(), misses.begin(), misses.end());
+
+    std::vector<std::string> field_id_names;
+    for (int i = 0; i < 256; ++i) {
+        auto name = FieldIdToName(i);
+        if (name != "f" + std::to_string(i)) {
+            field_id_names.push_back(name);
+        }
+    }
+    field_id_names.insert(field_id_names.end(), misses.begin(), misses.end());
+
+    run_bench("SyscallToName", syscall_nums.size(), iterations, [&](size_t idx) -> uint64_t {
+        SyscallToName(MachineType::X86_64, syscall_nums[idx], str);
+        return str.size();
+    });
+    run_bench("SyscallNameToNumber", syscall_names.size(), iterations, [&](size_t idx) -> uint64_t {
+        return static_cast<uint64_t>(SyscallNameToNumber(MachineType::X86_64, syscall_names[idx]));
+    });
+    run_bench("RecordTypeToName", record_types.size(), iterations, [&](size_t idx) -> uint64_t {
+        return RecordTypeToName(record_types[idx], str).size();
+    });
+    run_bench("RecordNameToType", record_names.size(), iterations, [&](size_t idx) -> uint64_t {
+        return static_cast<uint64_t>(RecordNameToType(record_names[idx]));
+    });
+    run_bench("FieldNameToType", field_names.size(), iterations, [&](size_t idx) -> uint64_t {
+        return static_cast<uint64_t>(FieldNameToType(field_names[idx]));
+    });
+    run_bench("FieldNameToId", field_id_names.size(), iterations, [&](size_t idx) -> uint64_t {
+        return static_cast<uint64_t>(FieldNameToId(field_id_names[idx]));
+    });
+
+    return 0;
+}